@@ -0,0 +1,37 @@
+#version 330
+
+// Same shading as the spheres drawn through Wireframe.frag, with the color
+// coming from the instance instead of u_color
+uniform vec3 u_light_pos;
+uniform vec3 u_light_intensity;
+
+uniform bool u_balls;
+
+in vec4 v_position;
+in vec4 v_normal;
+in vec4 v_color;
+
+out vec4 out_color;
+
+void main() {
+  if (u_balls == true) {
+    vec4 light_vector = normalize(vec4(u_light_pos, v_position.a) - v_position);
+
+    float r2 = pow(distance(vec4(u_light_pos, 0), v_position), 2);
+
+    float max_temp = max(0, dot(normalize(v_normal), light_vector));
+
+    out_color = v_color * (vec4(u_light_intensity, 0) / r2) * max_temp;
+    out_color.a = 1;
+  }
+  else {
+    if (gl_FrontFacing == false) {
+      out_color = (vec4(1, 1, 1, 0) - v_normal) / 2 * 0.3;
+      out_color.a = 1;
+    }
+    else {
+      out_color = (vec4(1, 1, 1, 0) + v_normal) / 2;
+      out_color.a = 1;
+    }
+  }
+}
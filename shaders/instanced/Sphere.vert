@@ -0,0 +1,27 @@
+#version 330
+
+// Instanced spheres: every instance scales and moves the shared unit sphere
+uniform mat4 u_model;
+uniform mat4 u_view_projection;
+
+// Per-vertex unit sphere, position and normal are the same point
+in vec4 in_position;
+in vec4 in_normal;
+
+// Per-instance center (xyz) and radius (w), and color
+in vec4 in_center;
+in vec4 in_color;
+
+out vec4 v_position;
+out vec4 v_normal;
+out vec4 v_color;
+
+void main() {
+  vec4 world = vec4(in_center.xyz + in_center.w * in_position.xyz, 1.0);
+
+  v_position = u_model * world;
+  v_normal = normalize(u_model * in_normal);
+  v_color = in_color;
+
+  gl_Position = u_view_projection * u_model * world;
+}
@@ -83,6 +83,15 @@ void GUI::load_shaders()
 		shaders_combobox_names.push_back(shader_name);
 	}
 
+	// Instanced spheres live in their own folder so they don't show up as a user shader
+	std::string sphere_vert_shader = m_project_root + "/shaders/instanced/Sphere.vert";
+	std::string sphere_frag_shader = m_project_root + "/shaders/instanced/Sphere.frag";
+	if (FileUtils::file_exists(sphere_vert_shader) && FileUtils::file_exists(sphere_frag_shader))
+	{
+		sphere_shader = make_shared<GLShader>();
+		sphere_shader->initFromFiles("Sphere", sphere_vert_shader, sphere_frag_shader);
+	}
+
 	// Assuming that it's there, use "Wireframe" by default
 	for (size_t i = 0; i < shaders_combobox_names.size(); ++i)
 	{
@@ -111,6 +120,10 @@ GUI::~GUI()
 	{
 		shader.nanogui_shader->free();
 	}
+	if (sphere_shader)
+	{
+		sphere_shader->free();
+	}
 }
 
 void GUI::init()
@@ -122,7 +135,12 @@ void GUI::init()
 		initGUI(screen);
 		gui_init = true;
 	}
+	// A fresh BMesh restarts its geometry versions, so nothing cached is valid
+	renderer.free_buffers();
+	renderer.sphere_shader = sphere_shader.get();
+	selected = nullptr;
 	bmesh = new Balle::BMesh(logger);
+	drop_mesh();
 
 	// Initialize camera
 
@@ -170,6 +188,21 @@ void GUI::init()
 
 void GUI::drawContents()
 {
+	// Time between frames, and the time spent in this one
+	std::chrono::steady_clock::time_point frame_start = std::chrono::steady_clock::now();
+	if (last_frame_time != std::chrono::steady_clock::time_point())
+	{
+		std::chrono::duration<double, std::milli> frame_time = frame_start - last_frame_time;
+		CGL::Misc::Profiler::global().record("frame", frame_time.count());
+	}
+	last_frame_time = frame_start;
+	update_profiler_panel();
+
+	CGL::Misc::ScopedTimer timer("draw_contents");
+
+	// Show whatever the worker finished since the last frame
+	adopt_mesh();
+
 	glEnable(GL_DEPTH_TEST);
 
 	// Bind the active shader
@@ -193,6 +226,17 @@ void GUI::drawContents()
 	shader.setUniform("u_view_projection", viewProjection);
 	Vector3D cam_pos;
 
+	// The instanced spheres share the camera and the light
+	if (sphere_shader)
+	{
+		sphere_shader->bind();
+		sphere_shader->setUniform("u_model", model);
+		sphere_shader->setUniform("u_view_projection", viewProjection);
+		sphere_shader->setUniform("u_light_pos", Vector3f(0.5, 2, 2), false);
+		sphere_shader->setUniform("u_light_intensity", Vector3f(10, 10, 10), false);
+		shader.bind();
+	}
+
 	// Update shader method label
 	switch (bmesh->shader_method)
 	{
@@ -212,6 +256,14 @@ void GUI::drawContents()
 		shader_method_label->setCaption("Polygon wireframe");
 		file_menu_export_obj_button->setEnabled(false);
 		break;
+	case Balle::Method::mesh_faces_indices:
+		shader_method_label->setCaption("HalfedgeMesh faces (indexed)");
+		file_menu_export_obj_button->setEnabled(true);
+		break;
+	case Balle::Method::polygons_indices:
+		shader_method_label->setCaption("Polygon faces (indexed)");
+		file_menu_export_obj_button->setEnabled(false);
+		break;
 	case Balle::Method::not_ready:
 		shader_method_label->setCaption("Skeleton");
 		file_menu_export_obj_button->setEnabled(false);
@@ -364,26 +416,45 @@ void GUI::drawGrid(GLShader &shader)
 void GUI::drawWireframe(GLShader &shader)
 {
 	drawGrid(shader);
-	bmesh->shake_nodes_position();
-	if (bmesh->shader_method == Balle::Method::not_ready)
+	if (bmesh->shake_nodes_position())
 	{
-		bmesh->draw_skeleton(shader);
+		interpolate_spheres();
+		update_mesh();
 	}
-	else if (bmesh->shader_method == Balle::Method::polygons_no_indices)
+	if (bmesh->shader_method == Balle::Method::not_ready || shown_mesh == nullptr)
+	{
+		renderer.draw_skeleton(shader, bmesh->get_skeleton_order(), bmesh->get_geometry_version());
+		return;
+	}
+
+	// The geometry is counted by the worker, the bones by the edited skeleton
+	const Balle::GeneratedMesh &shown = *shown_mesh;
+	Balle::GeometryVersion version = shown.version;
+	version.skeleton = bmesh->get_geometry_version().skeleton;
+
+	if (bmesh->shader_method == Balle::Method::polygons_no_indices)
 	{ // METHOD 1: Draw the polygons not using indices (WORKING)
-		bmesh->draw_polygon_faces(shader);
+		renderer.draw_polygon_faces(shader, shown.quadrangles, shown.triangles, shown.polygons, shown.vertices, version);
 	}
 	else if (bmesh->shader_method == Balle::Method::mesh_faces_no_indices)
 	{ // METHOD 2: Draw the mesh faces not using indices (WORKING)
-		bmesh->draw_mesh_faces(shader);
+		renderer.draw_mesh_faces(shader, shown.mesh.get(), version);
 	}
 	else if (bmesh->shader_method == Balle::Method::polygons_wirefame_no_indices)
 	{ // METHOD 3: Draw the polygons wireframe without indices (WORKING)
-		bmesh->draw_polygon_wireframe(shader);
+		renderer.draw_polygon_wireframe(shader, shown.quadrangles, shown.triangles, bmesh->get_skeleton_order(), shown.vertices, version);
 	}
 	else if (bmesh->shader_method == Balle::Method::mesh_wireframe_no_indices)
 	{ // METHOD 4: Draw the Wireframe not using indices (WORKING)
-		bmesh->draw_mesh_wireframe(shader);
+		renderer.draw_mesh_wireframe(shader, shown.mesh.get(), bmesh->get_skeleton_order(), version);
+	}
+	else if (bmesh->shader_method == Balle::Method::polygons_indices)
+	{ // METHOD 5: Draw the polygons with shared vertices and indices
+		renderer.draw_polygon_faces_indexed(shader, shown.polygons, shown.vertices, version, smooth_normals);
+	}
+	else if (bmesh->shader_method == Balle::Method::mesh_faces_indices)
+	{ // METHOD 6: Draw the mesh faces with shared vertices and indices
+		renderer.draw_mesh_faces_indexed(shader, shown.mesh.get(), version, smooth_normals);
 	}
 }
 
@@ -511,8 +582,10 @@ void GUI::scale_node_action()
 			selected->radius = 0.01;
 		}
 	}
+	selected->dirty = true;
 
 	interpolate_spheres();
+	update_mesh();
 }
 
 bool GUI::mouseButtonCallbackEvent(int button, int action,
@@ -582,12 +655,16 @@ void GUI::reset_grab_scale()
 	{
 		selected->pos = original_pos;
 		selected->equilibrium = original_pos;
+		selected->dirty = true;
+		bmesh->skeleton_changed();
 		cout << "Reset. Cant move it anymore" << endl;
 		gui_state = GUI_STATES::IDLE;
 	}
 	else if (gui_state == GUI_STATES::SCALING)
 	{
 		selected->radius = original_rad;
+		selected->dirty = true;
+		bmesh->skeleton_changed();
 		cout << "Reset. Cant scale it anymore" << endl;
 		gui_state = GUI_STATES::IDLE;
 	}
@@ -630,8 +707,10 @@ void GUI::grab_node_action()
 	Vector3D sphere_pos_world_v3d(new_sphere_pos_world[0], new_sphere_pos_world[1], new_sphere_pos_world[2]);
 	selected->pos = sphere_pos_world_v3d;
 	selected->equilibrium = sphere_pos_world_v3d;
+	selected->dirty = true;
 
 	interpolate_spheres();
+	update_mesh();
 }
 
 void GUI::mouseRightDragged(double x, double y)
@@ -674,16 +753,16 @@ bool GUI::keyCallbackEvent(int key, int scancode, int action,
 			break;
 
 		case '2':
-			bmesh->remesh_split();
+			add_mesh_operation(Balle::MeshOperation::remesh_split);
 			break;
 		case '4':
-			bmesh->remesh_collapse();
+			add_mesh_operation(Balle::MeshOperation::remesh_collapse);
 			break;
 		case '6':
-			bmesh->remesh_flip();
+			add_mesh_operation(Balle::MeshOperation::remesh_flip);
 			break;
 		case '8':
-			bmesh->remesh_average();
+			add_mesh_operation(Balle::MeshOperation::remesh_average);
 			break;
 
 		case 'x':
@@ -736,28 +815,20 @@ bool GUI::keyCallbackEvent(int key, int scancode, int action,
 		case ' ':
 			interpolate_spheres();
 
-			if (bmesh->shader_method == Balle::Method::not_ready)
-			{
-				bmesh->generate_bmesh();
-			}
-			else
-			{
-				bmesh->clear_mesh();
-			}
-
-			if (bmesh->shader_method == Balle::Method::mesh_faces_no_indices || bmesh->shader_method == Balle::Method::mesh_wireframe_no_indices)
+			// The export button follows once the mesh is shown
+			if (!mesh_wanted)
 			{
-				file_menu_export_obj_button->setEnabled(true);
+				mesh_wanted = true;
+				request_mesh();
 			}
 			else
 			{
-				file_menu_export_obj_button->setEnabled(false);
+				drop_mesh();
 			}
-
 			break;
 		case 'W':
 		case 'w':
-			if (bmesh->shader_method == Balle::Method::mesh_faces_no_indices)
+			if (bmesh->shader_method == Balle::Method::mesh_faces_no_indices || bmesh->shader_method == Balle::Method::mesh_faces_indices)
 			{
 				bmesh->shader_method = Balle::Method::mesh_wireframe_no_indices;
 			}
@@ -765,7 +836,7 @@ bool GUI::keyCallbackEvent(int key, int scancode, int action,
 			{
 				bmesh->shader_method = Balle::Method::mesh_faces_no_indices;
 			}
-			else if (bmesh->shader_method == Balle::Method::polygons_no_indices)
+			else if (bmesh->shader_method == Balle::Method::polygons_no_indices || bmesh->shader_method == Balle::Method::polygons_indices)
 			{
 				bmesh->shader_method = Balle::Method::polygons_wirefame_no_indices;
 			}
@@ -777,14 +848,16 @@ bool GUI::keyCallbackEvent(int key, int scancode, int action,
 
 		case 'D': // subdivision
 		case 'd':
-			bmesh->subdivision();
-			subdiv_level++;
+			if (add_mesh_operation(Balle::MeshOperation::subdivide))
+			{
+				subdiv_level++;
+			}
 			break;
 		case 'R':
 		case 'r':
 			if (ctrl_down)
 			{
-				bmesh->remesh();
+				add_mesh_operation(Balle::MeshOperation::remesh);
 				break;
 			}
 
@@ -808,7 +881,9 @@ bool GUI::keyCallbackEvent(int key, int scancode, int action,
 void GUI::export_bmesh()
 {
 	if (!((bmesh->shader_method == Balle::Method::mesh_faces_no_indices) ||
-		  (bmesh->shader_method == Balle::Method::mesh_wireframe_no_indices)))
+		  (bmesh->shader_method == Balle::Method::mesh_wireframe_no_indices) ||
+		  (bmesh->shader_method == Balle::Method::mesh_faces_indices)) ||
+		shown_mesh == nullptr || shown_mesh->mesh == nullptr)
 	{
 		logger->error("Export Failed - No mesh to export.");
 		return;
@@ -828,14 +903,19 @@ void GUI::export_bmesh()
 		filename += ".obj";
 	}
 
-	bmesh->export_to_file(filename);
+	// What is on screen, even if the worker is already on the next one
+	logger->info("Saving as: " + filename);
+	if (!Balle::write_obj(*shown_mesh->mesh, filename, bmesh->get_weld_epsilon()))
+	{
+		logger->error("Could not write " + filename);
+	}
 }
 
 void GUI::save_bmesh_to_file()
 {
 	std::string filename;
 
-	filename = nanogui::file_dialog({{"balle", "balle"}}, true);
+	filename = nanogui::file_dialog({{"balle", "balle"}, {"balleb", "balleb (binary)"}}, true);
 	if (filename.length() == 0)
 	{
 		return;
@@ -866,9 +946,23 @@ void GUI::save_bmesh_to_file()
 
 void GUI::load_bmesh_from_file()
 {
-	std::string filename = nanogui::file_dialog({{"balle", "balle"}}, false);
-	bmesh->load_from_file(filename);
-	bmesh->clear_mesh();
+	std::string filename = nanogui::file_dialog({{"balle", "balle"}, {"balleb", "balleb (binary)"}}, false);
+	if (filename.length() == 0)
+	{
+		return;
+	}
+	load_bmesh_from_file(filename);
+}
+
+bool GUI::load_bmesh_from_file(const std::string &filename)
+{
+	if (!bmesh->load_from_file(filename))
+	{
+		logger->error("Could not read " + filename);
+		return false;
+	}
+	drop_mesh();
+	return true;
 }
 
 void GUI::select_next()
@@ -930,6 +1024,18 @@ void GUI::extrude_node()
 
 	if (gui_state == GUI_STATES::IDLE)
 	{
+		// Pointing at the skin places the new node there
+		CGL::Vector3D origin, direction, on_surface;
+		cursorRay(mouse_x, mouse_y, origin, direction);
+		bool over_surface = false;
+		if (selected != nullptr && shown_mesh != nullptr)
+		{
+			CGL::Misc::Ray ray(origin, direction);
+			double t;
+			over_surface = shown_mesh->surface.intersect(ray, t) != CGL::Misc::TriangleBVH::npos;
+			on_surface = ray.at(t);
+		}
+
 		Balle::SkeletalNode *temp = bmesh->create_skeletal_node_after(selected);
 		if (selected != nullptr)
 		{
@@ -938,7 +1044,7 @@ void GUI::extrude_node()
 			{
 				offset = (temp->parent->pos - temp->parent->parent->pos).unit() * 0.08;
 			}
-			temp->pos = selected->pos + offset;
+			temp->pos = over_surface ? on_surface : selected->pos + offset;
 			selected->selected = false;
 		}
 		logger->info("Created a new node");
@@ -977,61 +1083,132 @@ void GUI::interpolate_spheres()
 	bmesh->interpolate_spheres();
 }
 
-void GUI::shake_it()
+void GUI::update_mesh()
 {
-	bmesh->shake();
+	// Keep a displayed mesh in sync while editing; the worker only sweeps
+	// the patches around moved nodes again
+	if (!mesh_wanted)
+	{
+		return;
+	}
+
+	// Shaking and dragging edit every frame: a running job is left to
+	// finish rather than superseded each time, or nothing would ever show
+	if (mesh_worker.busy())
+	{
+		mesh_outdated = true;
+		return;
+	}
+	request_mesh();
 }
 
-void GUI::sceneIntersect(double x, double y)
+void GUI::request_mesh()
 {
-	// Go over each sphere, and check if it intersects
-	// TODO: NO support for layered spheres, NO support for random radius
-	// cout << "x/screen_w: " << x << "/" << screen_w << " y/screen_h: " << y << "/" << screen_h << endl;
+	mesh_outdated = false;
 
-	if (gui_state == GUI_STATES::GRABBING || gui_state == GUI_STATES::SCALING)
+	// The worker interpolates on its own copy, it only needs the spheres the
+	// user placed
+	Balle::SkeletonSnapshot skeleton;
+	bmesh->snapshot_skeleton(skeleton);
+	if (skeleton.size() == 0)
 	{
-		gui_state = GUI_STATES::IDLE;
-		logger->info("Done grabbing. Cant move it anymore");
+		logger->error("No spheres to build a mesh from");
+		drop_mesh();
 		return;
 	}
-	bool found = false;
+	mesh_worker.submit(skeleton, mesh_operations, mesh_threads);
+}
 
-	for (Balle::SkeletalNode *node : bmesh->get_all_node())
+void GUI::adopt_mesh()
+{
+	if (mesh_outdated && !mesh_worker.busy())
 	{
-		Matrix4f view = getViewMatrix();
-		Matrix4f projection = getProjectionMatrix();
-		Matrix4f viewProjection = projection * view; // World to screen
+		request_mesh();
+	}
 
-		// Get the original position of the sphere
-		Vector4f node_worldpos(node->pos.x, node->pos.y, node->pos.z, 1.);
-		Vector4f node_clippos = viewProjection * node_worldpos;
+	std::shared_ptr<const Balle::GeneratedMesh> latest = mesh_worker.latest();
+	if (!mesh_wanted || latest == nullptr || latest == shown_mesh)
+	{
+		return;
+	}
 
-		// Convert to NDC
-		node_clippos /= node_clippos[3];
+	if (!latest->error.empty())
+	{
+		logger->error("Mesh generation failed: " + latest->error);
+		drop_mesh();
+		return;
+	}
 
-		Vector3D screenCoords;
-		screenCoords.x = (node_clippos[0] + 1.) * screen_w * 0.5;
-		screenCoords.y = (1. - node_clippos[1]) * screen_h * 0.5;
+	if (latest->mesh == nullptr && (shown_mesh == nullptr || shown_mesh->mesh != nullptr))
+	{
+		logger->warn("HalfedgeMesh building failed, using polygons instead.");
+	}
+	shown_mesh = latest;
+	bmesh->show_generated(shown_mesh->mesh != nullptr);
+}
 
-		if (pow(screenCoords.x - x, 2) + pow(screenCoords.y - y, 2) <= 400)
-		{
-			if (selected != nullptr)
-			{
-				selected->selected = false;
-			}
+bool GUI::add_mesh_operation(Balle::MeshOperation operation)
+{
+	if (!mesh_wanted)
+	{
+		logger->error("No mesh to operate on, press space first");
+		return false;
+	}
+	mesh_operations.push_back(operation);
+	request_mesh();
+	return true;
+}
 
-			selected = node; // remove this
-			selected->selected = true;
+void GUI::drop_mesh()
+{
+	mesh_worker.cancel();
+	shown_mesh.reset();
+	mesh_operations.clear();
+	subdiv_level = 0;
+	mesh_wanted = false;
+	mesh_outdated = false;
+	bmesh->clear_mesh();
+}
 
-			found = true;
-			break;
-		}
+void GUI::shake_it()
+{
+	bmesh->shake();
+}
+
+void GUI::cursorRay(double x, double y, CGL::Vector3D &origin, CGL::Vector3D &direction)
+{
+	// Unproject the pixel on the near plane (in double, the far plane is far
+	// away) and aim at it from the camera
+	Eigen::Matrix4d screenToWorld = (getProjectionMatrix() * getViewMatrix()).cast<double>().inverse();
+	Eigen::Vector4d ndc(2. * x / screen_w - 1., 1. - 2. * y / screen_h, -1., 1.);
+	Eigen::Vector4d world = screenToWorld * ndc;
+	world /= world[3];
+
+	origin = camera.position();
+	direction = CGL::Vector3D(world[0], world[1], world[2]) - origin;
+}
+
+void GUI::sceneIntersect(double x, double y)
+{
+	if (gui_state == GUI_STATES::GRABBING || gui_state == GUI_STATES::SCALING)
+	{
+		gui_state = GUI_STATES::IDLE;
+		logger->info("Done grabbing. Cant move it anymore");
+		return;
 	}
 
-	if ((found == false) && (selected != nullptr))
+	CGL::Vector3D origin, direction;
+	cursorRay(x, y, origin, direction);
+	Balle::SkeletalNode *node = bmesh->pick(origin, direction);
+
+	if (selected != nullptr)
 	{
 		selected->selected = false;
-		selected = nullptr;
+	}
+	selected = node;
+	if (selected != nullptr)
+	{
+		selected->selected = true;
 	}
 }
 
@@ -1148,21 +1325,38 @@ void GUI::initGUI(Screen *screen)
 		cb->setCallback([this](int id)
 						{
 
+			bool showing_mesh = bmesh->shader_method == Balle::Method::mesh_faces_no_indices ||
+				bmesh->shader_method == Balle::Method::mesh_wireframe_no_indices ||
+				bmesh->shader_method == Balle::Method::mesh_faces_indices;
+			bool showing_polygons = bmesh->shader_method == Balle::Method::polygons_no_indices ||
+				bmesh->shader_method == Balle::Method::polygons_wirefame_no_indices ||
+				bmesh->shader_method == Balle::Method::polygons_indices;
+
 			if (id == 0) {
-				if (bmesh->shader_method == Balle::Method::mesh_wireframe_no_indices) {
+				if (showing_mesh) {
 					bmesh->shader_method = Balle::Method::mesh_faces_no_indices;
 				}
-				else if (bmesh->shader_method == Balle::Method::polygons_wirefame_no_indices) {
+				else if (showing_polygons) {
 					bmesh->shader_method = Balle::Method::polygons_no_indices;
 				}
 			}
 			else if (id == 1) {
-				if (bmesh->shader_method == Balle::Method::mesh_faces_no_indices) {
+				if (showing_mesh) {
 					bmesh->shader_method = Balle::Method::mesh_wireframe_no_indices;
 				}
-				else if (bmesh->shader_method == Balle::Method::polygons_no_indices) {
+				else if (showing_polygons) {
 					bmesh->shader_method = Balle::Method::polygons_wirefame_no_indices;
 				}
+			}
+			else {
+				// Indexed faces, smooth shaded for the last entry
+				smooth_normals = (id == 3);
+				if (showing_mesh) {
+					bmesh->shader_method = Balle::Method::mesh_faces_indices;
+				}
+				else if (showing_polygons) {
+					bmesh->shader_method = Balle::Method::polygons_indices;
+				}
 			} });
 		animation_menu_shake_it_button = new Button(window, "Shake it! But pls not break it!");
 		animation_menu_shake_it_button->setCallback([this]()
@@ -1183,32 +1377,162 @@ void GUI::initGUI(Screen *screen)
 		textBox->setValue("0");
 		slider->setCallback([this, textBox](float value)
 							{
-			if (bmesh->shader_method == Balle::Method::mesh_faces_no_indices && !bmesh->shaking){
+			if ((bmesh->shader_method == Balle::Method::mesh_faces_no_indices || bmesh->shader_method == Balle::Method::mesh_faces_indices) && !bmesh->shaking){
 			
             textBox->setValue(std::to_string((int) (value * 100/20)));
 			if ((int) (value * 100/20) >= subdiv_level ){
 				for(int i = 0 ; i < (int) (value * 100/20) -  subdiv_level; i++){
-					bmesh->subdivision();
-					subdiv_level++;
+					mesh_operations.push_back(Balle::MeshOperation::subdivide);
 				}
 			}else{
-				bmesh->rebuild();
-				subdiv_level = 0;
-				for(int i = 0; i < (int) (value * 100/20); i++){
-					bmesh->subdivision();
-					subdiv_level++;
-				}
+				// Fewer levels start over from the stitched mesh
+				mesh_operations.assign((int) (value * 100/20), Balle::MeshOperation::subdivide);
 			}
+			subdiv_level = (int) (value * 100/20);
+			update_mesh();
 
 			} });
 	}
+	{
+		Widget *panel = new Widget(window);
+		panel->setLayout(new BoxLayout(Orientation::Horizontal,
+									   Alignment::Middle, 0, 20));
+
+		new Label(panel, "Threads");
+
+		// The mesh worker starts with the same default
+		IntBox<int> *threads_box = new IntBox<int>(panel);
+		threads_box->setEditable(true);
+		threads_box->setFixedSize(Vector2i(60, 25));
+		threads_box->setFontSize(14);
+		threads_box->setValue((int)std::max(1u, std::thread::hardware_concurrency()));
+		threads_box->setMinValue(1);
+		threads_box->setSpinnable(true);
+		threads_box->setCallback([this](int value)
+								 { mesh_threads = value;
+								   update_mesh(); });
+	}
 	new Label(window, "Terminal OUTPUT", "sans-bold");
 	{
 		TextBox *tb = new TextBox(window);
 		tb->setValue("");
 		tb->setHeight(200);
 		tb->setFontSize(10);
-		logger = new Logger{tb};
+		logger = new Logger([tb](const string &s)
+							{ tb->setValue(s); });
+	}
+	new Label(window, "Profiler (ms: last, min, avg, p99)", "sans-bold");
+	{
+		profiler_panel = new Widget(window);
+		profiler_panel->setLayout(new GridLayout(Orientation::Horizontal, 5, Alignment::Minimum, 0, 4));
+
+		Button *csv_button = new Button(window, "Save profile .csv");
+		csv_button->setCallback([this]()
+								{ this->save_profile_to_file(); });
+		csv_button->setFontSize(14);
+
+		Button *trace_button = new Button(window, "Save trace .json");
+		trace_button->setCallback([this]()
+								  { this->save_trace_to_file(); });
+		trace_button->setFontSize(14);
+	}
+}
+
+void GUI::update_profiler_panel()
+{
+	// Twice a second is plenty to read the numbers
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now - last_profiler_update < std::chrono::milliseconds(500))
+	{
+		return;
+	}
+	last_profiler_update = now;
+
+	vector<CGL::Misc::Profiler::Stats> stats = CGL::Misc::Profiler::global().stats();
+
+	bool added = false;
+	while (profiler_rows.size() < stats.size())
+	{
+		vector<Label*> row;
+		for (int i = 0; i < 5; i++)
+		{
+			Label *label = new Label(profiler_panel, "", "sans");
+			label->setFontSize(12);
+			row.push_back(label);
+		}
+		profiler_rows.push_back(row);
+		added = true;
+	}
+
+	for (size_t i = 0; i < stats.size(); i++)
+	{
+		const CGL::Misc::Profiler::Stats &s = stats[i];
+		double values[4] = {s.last, s.min, s.avg, s.p99};
+		profiler_rows[i][0]->setCaption(s.stage);
+		for (int j = 0; j < 4; j++)
+		{
+			char buf[32];
+			snprintf(buf, sizeof(buf), "%.2f", values[j]);
+			profiler_rows[i][j + 1]->setCaption(buf);
+		}
+	}
+
+	if (added)
+	{
+		screen->performLayout();
+	}
+}
+
+void GUI::save_profile_to_file()
+{
+	std::string filename;
+
+	filename = nanogui::file_dialog({{"csv", "csv"}}, true);
+	if (filename.length() == 0)
+	{
+		return;
+	}
+
+	size_t pos = filename.rfind('.', filename.length());
+	if (pos == -1)
+	{
+		filename += ".csv";
+	}
+
+	if (CGL::Misc::Profiler::global().write_csv(filename))
+	{
+		logger->info("Saved profile to " + filename);
+	}
+	else
+	{
+		logger->error("Could not write " + filename);
+	}
+}
+
+void GUI::save_trace_to_file()
+{
+	// Chrome trace_event JSON, open it in chrome://tracing or Perfetto
+	std::string filename;
+
+	filename = nanogui::file_dialog({{"json", "json"}}, true);
+	if (filename.length() == 0)
+	{
+		return;
+	}
+
+	size_t pos = filename.rfind('.', filename.length());
+	if (pos == -1)
+	{
+		filename += ".json";
+	}
+
+	if (CGL::Misc::TraceRecorder::global().write_json(filename))
+	{
+		logger->info("Saved trace to " + filename);
+	}
+	else
+	{
+		logger->error("Could not write " + filename);
 	}
 }
 
@@ -3,9 +3,12 @@
 
 #include <nanogui/nanogui.h>
 #include <memory>
+#include <chrono>
 
 #include "camera.h"
 #include "bmesh/bmesh.h"
+#include "bmesh/renderer.h"
+#include "bmesh/mesh_worker.h"
 #include "logger.h"
 
 using namespace nanogui;
@@ -35,6 +38,9 @@ public:
 	void init();
 	virtual void drawContents();
 
+	// Replace the skeleton with the one in `filename` (a .balle file)
+	bool load_bmesh_from_file(const std::string& filename);
+
 	// Screen events
 
 	virtual bool cursorPosCallbackEvent(double x, double y);
@@ -70,6 +76,20 @@ private:
 	nanogui::Color color = nanogui::Color(1.0f, 1.0f, 1.0f, 1.0f);
 
 	Balle::BMesh* bmesh;
+	// Keeps the shown geometry on the GPU between frames
+	Balle::Renderer renderer;
+	// Builds the mesh off the UI thread from snapshots of bmesh's skeleton;
+	// frames draw whatever it published last
+	Balle::MeshWorker mesh_worker;
+	std::shared_ptr<const Balle::GeneratedMesh> shown_mesh;
+	// Subdivisions and remeshing applied to the stitched mesh, in order
+	vector<Balle::MeshOperation> mesh_operations;
+	bool mesh_wanted = false;
+	// Edited while the worker was busy, submitted once it is done
+	bool mesh_outdated = false;
+	size_t mesh_threads = std::max(1u, std::thread::hardware_concurrency());
+	// Indexed display modes: average the normals over adjacent faces
+	bool smooth_normals = false;
 
 	// OpenGL attributes
 
@@ -78,9 +98,10 @@ private:
 	int active_display_idx = 0;
 
 	vector<UserShader> shaders;
+	std::shared_ptr<GLShader> sphere_shader; // instanced spheres, shared by every user shader
 	vector<std::string> shaders_combobox_names;
 	vector<std::string> cameraview_names{"Front View","Side View", "Top View"};
-	vector<std::string> display_names{"Halfedge Mesh","Wireframe"};
+	vector<std::string> display_names{"Halfedge Mesh","Wireframe","Indexed Mesh","Smooth Mesh"};
 
 
 
@@ -110,6 +131,8 @@ private:
 	void mouseRightDragged(double x, double y);
 	void mouseMoved(double x, double y);
 	void sceneIntersect(double x, double y);
+	// Ray from the camera through the pixel (x, y), origin + t * direction
+	void cursorRay(double x, double y, CGL::Vector3D& origin, CGL::Vector3D& direction);
 
 	bool grab_state;
 
@@ -141,6 +164,9 @@ private:
 	void export_bmesh();
 	void save_bmesh_to_file();
 	void load_bmesh_from_file();
+	void save_profile_to_file();
+	void save_trace_to_file();
+	void update_profiler_panel();
 	void reset_grab_scale();
 	void finish_grab_scale();
 	void delete_node();
@@ -153,6 +179,11 @@ private:
 	void select_parent();
 	void select_child();
 	void interpolate_spheres();
+	void update_mesh();
+	void request_mesh();
+	void adopt_mesh();
+	bool add_mesh_operation(Balle::MeshOperation operation);
+	void drop_mesh();
 	void shake_it();
 
 	// Store scaling stuff
@@ -180,6 +211,12 @@ private:
 	Window* shader_method_window;
 	Label* shader_method_label;
 
+	// Profiler panel, one row of labels per stage
+	Widget* profiler_panel;
+	vector<vector<Label*>> profiler_rows;
+	std::chrono::steady_clock::time_point last_frame_time;
+	std::chrono::steady_clock::time_point last_profiler_update;
+
 	// save frame
 	string get_frame_name(int index);
 	void write_screen_shot(int index);
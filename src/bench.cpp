@@ -0,0 +1,553 @@
+// Benchmark of the B-Mesh pipeline: every stage timed on the shipped samples
+// and on generated skeletons, reported as JSON. Headless, like balle_cli.
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include "misc/getopt.h" // getopt for windows
+#else
+#include <getopt.h>
+#include <unistd.h>
+#endif
+
+#include "CGL/timer.h"
+#include "bmesh/bmesh.h"
+#include "bmesh/buffer_fill.h"
+#include "misc/file_utils.h"
+#include "misc/profiler.h"
+#include "json.hpp"
+#include "logger.h"
+
+using namespace std;
+using json = nlohmann::json;
+
+struct Options
+{
+	int subdivision_levels = 3;
+	int remesh_passes = 1;
+	int repeats = 5;
+	int nodes = 64;
+	unsigned int seed = 1;
+	int num_threads = 0;
+};
+
+struct Skeleton
+{
+	string name;
+	json balle;
+};
+
+void usageError(const char* binaryName)
+{
+	printf("Usage: %s [options]\n", binaryName);
+	printf("Optional program options:\n");
+	printf("  -s     <INT>       Subdivision levels to time (default 3).\n");
+	printf("  -m     <INT>       Remesh passes to time (default 1).\n");
+	printf("  -r     <INT>       Repetitions per skeleton (default 5).\n");
+	printf("  -n     <INT>       Nodes per generated skeleton (default 64).\n");
+	printf("  -S     <INT>       Seed of the random creature (default 1).\n");
+	printf("  -t     <INT>       Worker threads, 0 for one per core (default 0).\n");
+	printf("  -p     <STRING>    Project root, should contain \"samples/\".\n");
+	printf("  -o     <STRING>    Write the JSON here instead of to stdout.\n");
+	printf("\n");
+	exit(-1);
+}
+
+/******************************
+ * Synthetic skeletons        *
+ ******************************/
+
+// Appends a sphere to a .balle document, returns its index
+int add_sphere(json& balle, int parent, const Vector3D& pos, double radius)
+{
+	int index = (int)balle["spheres"].size();
+	json sphere;
+	sphere["index"] = index;
+	sphere["parent"] = parent;
+	sphere["radius"] = radius;
+	sphere["pos"] = {pos.x, pos.y, pos.z};
+	sphere["children"] = json::array();
+	balle["spheres"].push_back(sphere);
+	balle["count"] = index + 1;
+	if (parent >= 0)
+	{
+		balle["spheres"][parent]["children"].push_back(index);
+	}
+	return index;
+}
+
+json empty_skeleton()
+{
+	json balle;
+	balle["count"] = 0;
+	balle["spheres"] = json::array();
+	return balle;
+}
+
+// A single limb, gently waving
+json make_chain(int n)
+{
+	json balle = empty_skeleton();
+	int parent = -1;
+	for (int i = 0; i < n; i++)
+	{
+		Vector3D pos(i * 0.1, 0.02 * sin(i * 0.7), 0.02 * cos(i * 0.4));
+		parent = add_sphere(balle, parent, pos, 0.03 + 0.008 * sin(i * 0.5));
+	}
+	return balle;
+}
+
+// One joint with up to eight limbs spread over the sphere
+json make_star(int n)
+{
+	json balle = empty_skeleton();
+	int root = add_sphere(balle, -1, Vector3D(0, 0, 0), 0.06);
+
+	int arms = max(1, min(8, (n - 1) / 4));
+	const double golden_angle = M_PI * (3. - sqrt(5.));
+	vector<int> tips(arms, root);
+	vector<Vector3D> directions(arms);
+	for (int k = 0; k < arms; k++)
+	{
+		double y = 1 - 2 * (k + 0.5) / arms;
+		double r = sqrt(1 - y * y);
+		directions[k] = Vector3D(r * cos(golden_angle * k), y, r * sin(golden_angle * k));
+	}
+
+	for (int i = 1; i < n; i++)
+	{
+		int k = (i - 1) % arms;
+		int step = (i - 1) / arms + 1;
+		Vector3D pos = directions[k] * (0.08 + 0.1 * step);
+		tips[k] = add_sphere(balle, tips[k], pos, max(0.012, 0.04 - 0.002 * step));
+	}
+	return balle;
+}
+
+// Complete binary tree in breadth-first order. The two children of a node
+// leave 120 degrees apart around its direction, so no joint is flat.
+json make_binary_tree(int n)
+{
+	json balle = empty_skeleton();
+	vector<Vector3D> directions;
+	vector<Vector3D> sides; // unit, perpendicular to the direction
+	vector<Vector3D> positions;
+
+	add_sphere(balle, -1, Vector3D(0, 0, 0), 0.05);
+	directions.push_back(Vector3D(0, 1, 0));
+	sides.push_back(Vector3D(1, 0, 0));
+	positions.push_back(Vector3D(0, 0, 0));
+
+	const double spread = 50. * M_PI / 180.;
+	for (int i = 1; i < n; i++)
+	{
+		int parent = (i - 1) / 2;
+		int depth = (int)floor(log2(i + 1.));
+		double azimuth = ((i - 1) % 2 == 0 ? 1. : -1.) * M_PI / 3.;
+
+		Vector3D d = directions[parent];
+		Vector3D s = sides[parent];
+		Vector3D around = s * cos(azimuth) + cross(d, s) * sin(azimuth);
+		Vector3D direction = d * cos(spread) + around * sin(spread);
+
+		Vector3D pos = positions[parent] + direction * (0.3 * pow(0.8, depth));
+		add_sphere(balle, parent, pos, 0.05 * pow(0.8, depth));
+		directions.push_back(direction);
+		sides.push_back(cross(direction, around).unit());
+		positions.push_back(pos);
+	}
+	return balle;
+}
+
+// Random tree with at most three children per node. Every limb keeps at
+// least 60 degrees from the other limbs at its node, since the sweep cannot
+// stitch limbs that run into each other. The same seed always gives the same
+// creature.
+json make_random_creature(int n, unsigned int seed)
+{
+	mt19937 rng(seed);
+	auto uniform = [&rng](double lo, double hi)
+	{ return lo + (hi - lo) * (rng() / 4294967296.0); };
+	auto random_unit = [&uniform]()
+	{
+		double z = uniform(-1, 1);
+		double phi = uniform(0, 2 * M_PI);
+		double r = sqrt(1 - z * z);
+		return Vector3D(r * cos(phi), r * sin(phi), z);
+	};
+
+	json balle = empty_skeleton();
+	vector<Vector3D> positions;
+	vector<double> radii;
+	vector<vector<Vector3D>> limbs; // directions of the limbs at every node
+	vector<int> open;               // nodes that may still take a child
+
+	add_sphere(balle, -1, Vector3D(0, 0, 0), 0.05);
+	positions.push_back(Vector3D(0, 0, 0));
+	radii.push_back(0.05);
+	limbs.push_back(vector<Vector3D>());
+	open.push_back(0);
+
+	const double min_cos = cos(M_PI / 3.);
+	for (int i = 1; i < n && !open.empty(); i++)
+	{
+		// The body takes the first three limbs: the sweep has to start at a
+		// joint, a leaf root next to a joint does not stitch
+		size_t slot = i <= 3 ? 0 : min((size_t)uniform(0, (double)open.size()), open.size() - 1);
+		int parent = open[slot];
+
+		// Limbs mostly carry on away from the parent
+		Vector3D heading = limbs[parent].empty() ? random_unit() : -limbs[parent][0];
+		Vector3D direction;
+		bool found = false;
+		for (int attempt = 0; attempt < 32 && !found; attempt++)
+		{
+			direction = (heading + random_unit() * 0.9).unit();
+			found = true;
+			for (const Vector3D &limb : limbs[parent])
+			{
+				found = found && dot(direction, limb) < min_cos;
+			}
+		}
+		if (!found)
+		{
+			// No room left around this node
+			open.erase(open.begin() + slot);
+			i--;
+			continue;
+		}
+
+		double radius = max(0.015, radii[parent] * uniform(0.8, 0.95));
+		Vector3D pos = positions[parent] + direction * uniform(0.15, 0.25);
+		add_sphere(balle, parent, pos, radius);
+		positions.push_back(pos);
+		radii.push_back(radius);
+		limbs[parent].push_back(direction);
+		limbs.push_back(vector<Vector3D>(1, -direction));
+		open.push_back(i);
+
+		if (balle["spheres"][parent]["children"].size() >= 3)
+		{
+			open.erase(find(open.begin(), open.end(), parent));
+		}
+	}
+	return balle;
+}
+
+/******************************
+ * Measurements               *
+ ******************************/
+
+json summarize(vector<double> samples)
+{
+	json j;
+	if (samples.empty())
+	{
+		return j;
+	}
+	sort(samples.begin(), samples.end());
+	j["min"] = samples.front();
+	j["median"] = samples[samples.size() / 2];
+	j["max"] = samples.back();
+	return j;
+}
+
+// Total time recorded under `stage` since the profiler was last cleared
+double stage_ms(const vector<CGL::Misc::Profiler::Stats>& stats, const string& stage)
+{
+	for (const CGL::Misc::Profiler::Stats& s : stats)
+	{
+		if (s.stage == stage)
+		{
+			return s.avg * s.calls;
+		}
+	}
+	return 0;
+}
+
+double elapsed_ms(CGL::Timer& timer)
+{
+	timer.stop();
+	double ms = timer.duration() * 1000.;
+	timer.start();
+	return ms;
+}
+
+json run_skeleton(const Skeleton& skeleton, const Options& options)
+{
+	// Generation stages as recorded by the pipeline's own timers
+	const vector<string> stages = {"interpolate_spheres", "joint_iterate", "joint_hulls", "stitch_faces",
+								   "halfedge_build", "catmull_clark", "stencil_eval"};
+
+	CGL::Misc::Profiler& profiler = CGL::Misc::Profiler::global();
+	map<string, vector<double>> samples;
+	vector<vector<double>> subdivision_samples(options.subdivision_levels);
+	vector<vector<double>> remesh_samples(options.remesh_passes);
+	vector<size_t> level_faces(options.subdivision_levels, 0);
+	vector<size_t> remesh_faces(options.remesh_passes, 0);
+	size_t generated_faces = 0;
+	bool built = true;
+
+	for (int r = 0; r < options.repeats && built; r++)
+	{
+		Logger logger;
+		logger.verbose = false;
+		Balle::BMesh bmesh(&logger, options.num_threads);
+
+		CGL::Timer total;
+		CGL::Timer timer;
+		total.start();
+		timer.start();
+
+		bmesh.load_from_json(skeleton.balle);
+		samples["load"].push_back(elapsed_ms(timer));
+
+		profiler.clear();
+		bmesh.generate_bmesh();
+		samples["generate"].push_back(elapsed_ms(timer));
+		vector<CGL::Misc::Profiler::Stats> stats = profiler.stats();
+		for (const string& stage : stages)
+		{
+			samples[stage].push_back(stage_ms(stats, stage));
+		}
+
+		if (bmesh.get_mesh() == nullptr ||
+			bmesh.shader_method == Balle::Method::polygons_no_indices ||
+			bmesh.shader_method == Balle::Method::polygons_indices)
+		{
+			built = false;
+			break;
+		}
+		generated_faces = bmesh.get_mesh()->nFaces();
+
+		// Edit: nudge every leaf and regenerate, which only re-sweeps around
+		// the leaves and re-evaluates the stencils when the faces still match
+		for (Balle::SkeletalNode* node : bmesh.get_all_node())
+		{
+			if (!node->interpolated && node->children.empty())
+			{
+				node->pos.x += 0.001;
+				node->dirty = true;
+			}
+		}
+		timer.start();
+		bmesh.interpolate_spheres();
+		bmesh.update_bmesh();
+		samples["update"].push_back(elapsed_ms(timer));
+		if (bmesh.get_mesh() == nullptr)
+		{
+			// The nudged leaves no longer stitch
+			built = false;
+			break;
+		}
+
+		for (int level = 0; level < options.subdivision_levels; level++)
+		{
+			bmesh.subdivision();
+			subdivision_samples[level].push_back(elapsed_ms(timer));
+			level_faces[level] = bmesh.get_mesh()->nFaces();
+		}
+		for (int pass = 0; pass < options.remesh_passes; pass++)
+		{
+			bmesh.remesh();
+			remesh_samples[pass].push_back(elapsed_ms(timer));
+			remesh_faces[pass] = bmesh.get_mesh()->nFaces();
+		}
+
+		// What the renderer computes before uploading the final mesh
+		Eigen::MatrixXf positions, normals;
+		vector<uint32_t> indices;
+		Balle::fill_mesh_faces(bmesh.get_mesh(), positions, normals);
+		samples["buffer_fill_faces"].push_back(elapsed_ms(timer));
+		Balle::fill_mesh_vertices(bmesh.get_mesh(), true, positions, normals);
+		Balle::fill_mesh_face_indices(bmesh.get_mesh(), indices);
+		samples["buffer_fill_indexed"].push_back(elapsed_ms(timer));
+		Balle::fill_mesh_edge_indices(bmesh.get_mesh(), indices);
+		samples["buffer_fill_edges"].push_back(elapsed_ms(timer));
+
+		// Surface queries on the final mesh: the first one builds the tree,
+		// then rays from around the model at its nodes and closest points
+		// near them. Milliseconds per thousand are microseconds per query
+		const int queries = 1000;
+		mt19937 rng(options.seed);
+		auto uniform = [&rng](double lo, double hi)
+		{ return lo + (hi - lo) * (rng() / 4294967296.0); };
+		const vector<Balle::SkeletalNode*>& order = bmesh.get_skeleton_order();
+		Vector3D on_surface;
+		bmesh.closest_surface_point(order.front()->pos, on_surface);
+		samples["surface_bvh_build"].push_back(elapsed_ms(timer));
+		for (int q = 0; q < queries; q++)
+		{
+			Vector3D target = order[q % order.size()]->pos;
+			Vector3D origin = target + Vector3D(uniform(-1, 1), uniform(-1, 1), uniform(-1, 1)) * 4.;
+			bmesh.pick_surface(origin, target - origin, on_surface);
+		}
+		samples["surface_rays_1k"].push_back(elapsed_ms(timer));
+		for (int q = 0; q < queries; q++)
+		{
+			Vector3D target = order[q % order.size()]->pos;
+			bmesh.closest_surface_point(target + Vector3D(uniform(-1, 1), uniform(-1, 1), uniform(-1, 1)) * .5, on_surface);
+		}
+		samples["surface_closest_1k"].push_back(elapsed_ms(timer));
+
+		samples["end_to_end"].push_back(elapsed_ms(total));
+	}
+
+	json j;
+	j["name"] = skeleton.name;
+	j["nodes"] = skeleton.balle["count"];
+	j["mesh"] = built;
+
+	// A skeleton that does not stitch still reports how long trying took
+	json& ms = j["ms"];
+	for (const auto& entry : samples)
+	{
+		ms[entry.first] = summarize(entry.second);
+	}
+	if (!built)
+	{
+		return j;
+	}
+
+	j["faces"]["generated"] = generated_faces;
+	j["faces"]["subdivision"] = level_faces;
+	j["faces"]["remesh"] = remesh_faces;
+
+	ms["subdivision"] = json::array();
+	for (const vector<double>& level : subdivision_samples)
+	{
+		ms["subdivision"].push_back(summarize(level));
+	}
+	ms["remesh"] = json::array();
+	for (const vector<double>& pass : remesh_samples)
+	{
+		ms["remesh"].push_back(summarize(pass));
+	}
+	return j;
+}
+
+bool find_samples(const string& project_root, string& samples_dir)
+{
+	vector<string> search_paths = {".", "..", "../..", "../../.."};
+	if (!project_root.empty())
+	{
+		search_paths = {project_root};
+	}
+	for (const string& path : search_paths)
+	{
+		if (FileUtils::file_exists(path + "/samples/trex.balle"))
+		{
+			samples_dir = path + "/samples";
+			return true;
+		}
+	}
+	return false;
+}
+
+int main(int argc, char** argv)
+{
+	int c;
+
+	Options options;
+	string project_root;
+	string output;
+
+	while ((c = getopt(argc, argv, "s:m:r:n:S:t:p:o:")) != -1)
+	{
+		switch (c)
+		{
+		case 's':
+			options.subdivision_levels = atoi(optarg);
+			break;
+		case 'm':
+			options.remesh_passes = atoi(optarg);
+			break;
+		case 'r':
+			options.repeats = atoi(optarg);
+			break;
+		case 'n':
+			options.nodes = atoi(optarg);
+			break;
+		case 'S':
+			options.seed = (unsigned int)atoi(optarg);
+			break;
+		case 't':
+			options.num_threads = atoi(optarg);
+			break;
+		case 'p':
+			project_root = optarg;
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		default:
+			usageError(argv[0]);
+			break;
+		}
+	}
+
+	if (options.subdivision_levels < 0 || options.remesh_passes < 0 || options.repeats < 1 ||
+		options.nodes < 2 || options.num_threads < 0)
+	{
+		usageError(argv[0]);
+	}
+
+	vector<Skeleton> skeletons;
+	string samples_dir;
+	if (find_samples(project_root, samples_dir))
+	{
+		for (const char* name : {"trex", "seastar", "stick_fig"})
+		{
+			ifstream file(samples_dir + "/" + name + ".balle");
+			Skeleton skeleton;
+			skeleton.name = name;
+			file >> skeleton.balle;
+			skeletons.push_back(skeleton);
+		}
+	}
+	else
+	{
+		cerr << "Could not find samples/trex.balle, timing generated skeletons only" << endl;
+	}
+
+	string n = to_string(options.nodes);
+	skeletons.push_back({"chain_" + n, make_chain(options.nodes)});
+	skeletons.push_back({"star_" + n, make_star(options.nodes)});
+	skeletons.push_back({"binary_tree_" + n, make_binary_tree(options.nodes)});
+	skeletons.push_back({"random_" + n + "_seed_" + to_string(options.seed), make_random_creature(options.nodes, options.seed)});
+
+	json report;
+	report["config"]["subdivision_levels"] = options.subdivision_levels;
+	report["config"]["remesh_passes"] = options.remesh_passes;
+	report["config"]["repeats"] = options.repeats;
+	report["config"]["nodes"] = options.nodes;
+	report["config"]["seed"] = options.seed;
+	report["config"]["threads"] = options.num_threads;
+	report["skeletons"] = json::array();
+	for (const Skeleton& skeleton : skeletons)
+	{
+		cerr << "Timing " << skeleton.name << endl;
+		report["skeletons"].push_back(run_skeleton(skeleton, options));
+	}
+
+	if (output.empty())
+	{
+		cout << report.dump(2) << endl;
+		return 0;
+	}
+	ofstream file(output);
+	file << report.dump(2) << endl;
+	if (!file)
+	{
+		cerr << "Could not write " << output << endl;
+		return 1;
+	}
+	return 0;
+}
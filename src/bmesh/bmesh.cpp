@@ -1,6 +1,5 @@
 #include <unordered_map>
 #include <unordered_set>
-#include "renderer.h"
 #include "../logger.h"
 #include "bmesh.h"
 #define QUICKHULL_IMPLEMENTATION 1
@@ -8,9 +7,10 @@
 #include "../json.hpp"
 #include <iostream>
 #include <fstream>
+#include <cmath>
+#include <algorithm>
 
 using namespace std;
-using namespace nanogui;
 using nlohmann::json;
 
 namespace Balle
@@ -19,42 +19,48 @@ namespace Balle
 	 * PUBLIC                      *
 	 ******************************/
 
-	BMesh::BMesh(Logger *logger):logger(logger)
+	BMesh::BMesh(Logger *logger, size_t num_threads):thread_pool(num_threads), logger(logger)
 	{
-		root = new SkeletalNode(Vector3D(0, 0, 0), 0.05, nullptr); // root has no parent
-
-		// SkeletalNode *chest = new SkeletalNode(Vector3D(0, 1, 0) / 3., 0.03, root);
-		// SkeletalNode *arml = new SkeletalNode(Vector3D(-1.5, 0.5, 0) / 3., 0.021, chest);
-		// SkeletalNode *armr = new SkeletalNode(Vector3D(1.5, 0.5, 0) / 3., 0.022, chest);
-		// SkeletalNode *head = new SkeletalNode(Vector3D(0, 1.6, 0) / 3., 0.03, chest);
-		SkeletalNode *footL = new SkeletalNode(Vector3D(-0.9, -1, 0) / 3., 0.011, root);
-		SkeletalNode *footR = new SkeletalNode(Vector3D(0.9, -1, 0) / 3., 0.012, root);
-
-		// root->children->push_back(chest);
-		root->children->push_back(footL);
-		root->children->push_back(footR);
-
-		// chest->children->push_back(arml);
-		// chest->children->push_back(armr);
-		// chest->children->push_back(head);
-
-		all_nodes.emplace(root);
-		// all_nodes.emplace(chest);
-		// all_nodes.emplace(arml);
-		// all_nodes.emplace(armr);
-		// all_nodes.emplace(head);
-		all_nodes.emplace(footL);
-		all_nodes.emplace(footR);
+		root = all_nodes.create(Vector3D(0, 0, 0), 0.05, nullptr); // root has no parent
+
+		// SkeletalNode *chest = all_nodes.create(Vector3D(0, 1, 0) / 3., 0.03, root);
+		// SkeletalNode *arml = all_nodes.create(Vector3D(-1.5, 0.5, 0) / 3., 0.021, chest);
+		// SkeletalNode *armr = all_nodes.create(Vector3D(1.5, 0.5, 0) / 3., 0.022, chest);
+		// SkeletalNode *head = all_nodes.create(Vector3D(0, 1.6, 0) / 3., 0.03, chest);
+		SkeletalNode *footL = all_nodes.create(Vector3D(-0.9, -1, 0) / 3., 0.011, root);
+		SkeletalNode *footR = all_nodes.create(Vector3D(0.9, -1, 0) / 3., 0.012, root);
+
+		// root->children.push_back(chest);
+		root->children.push_back(footL);
+		root->children.push_back(footR);
+
+		// chest->children.push_back(arml);
+		// chest->children.push_back(armr);
+		// chest->children.push_back(head);
 		
 	};
+
+	BMesh::~BMesh()
+	{
+		__clear_patches();
+		for (qh_arena_t &arena : hull_arenas)
+		{
+			qh_arena_free(&arena);
+		}
+	}
 	void BMesh::rebuild(){
 		if(mesh != nullptr){
 			delete mesh;
 		}
 		mesh = nullptr;
 		mesh = new HalfedgeMesh();
-		mesh->build(polygons, vertices);
+		{
+			Misc::ScopedTimer build_timer("halfedge_build");
+			mesh->buildFast(polygons, vertices);
+		}
+		__reset_stencils();
 		__catmull_clark(*mesh);
+		geometry_version.topology++;
 	}
 	void BMesh::clear_mesh()
 	{
@@ -63,6 +69,14 @@ namespace Balle
 			delete mesh;
 		}
 		mesh = nullptr;
+		stencils.clear();
+		stencil_polygons.clear();
+		__clear_sweep();
+		geometry_version.topology++;
+	}
+	void BMesh::__clear_sweep()
+	{
+		// Everything the next sweep regenerates, but not the mesh itself
 		triangles.clear();
 		quadrangles.clear();
 		polygons.clear();
@@ -74,35 +88,12 @@ namespace Balle
 		previous_shader_method = shader_method;
 		shader_method = Balle::Method::not_ready;
 	}
-	/******************************
-	 * Render                     *
-	 ******************************/
-
-	void BMesh::draw_skeleton(GLShader &shader)
-	{
-		Balle::Renderer renderer;
-		renderer.draw_skeleton(shader, root);
-	}
-	void BMesh::draw_polygon_faces(GLShader &shader)
-	{
-		Balle::Renderer renderer;
-		renderer.draw_polygon_faces(shader, quadrangles, triangles, polygons, vertices);
-	}
-
-	void BMesh::draw_mesh_faces(GLShader &shader)
-	{
-		Balle::Renderer renderer;
-		renderer.draw_mesh_faces(shader, mesh);
-	}
-	void BMesh::draw_polygon_wireframe(GLShader &shader)
-	{
-		Balle::Renderer renderer;
-		renderer.draw_polygon_wireframe(shader, quadrangles, triangles, root, vertices);
-	}
-	void BMesh::draw_mesh_wireframe(GLShader &shader)
+	void BMesh::update_bmesh()
 	{
-		Balle::Renderer renderer;
-		renderer.draw_mesh_wireframe(shader, mesh, root);
+		// Keep the mesh around: if the skeleton still stitches into the same
+		// polygons, only its positions need to be re-evaluated
+		__clear_sweep();
+		generate_bmesh();
 	}
 
 	void BMesh::tick()
@@ -115,18 +106,17 @@ namespace Balle
 		shaking = shaking ^ true;
 	}
 
-	void BMesh::shake_nodes_position()
+	bool BMesh::shake_nodes_position()
 	{
 		if (!shaking)
 		{
-			return;
+			return false;
 		}
-		clear_mesh();
 		size_t idx = 0;
 		double t = (ts % 360) * PI / 180 * 20;
 		for (SkeletalNode *node_ptr : all_nodes)
 		{
-			if (node_ptr->interpolated || node_ptr->children->size() != 0)
+			if (node_ptr->interpolated || !node_ptr->children.empty())
 			{
 				continue;
 			}
@@ -140,9 +130,10 @@ namespace Balle
 			default:
 				node_ptr->pos = node_ptr->equilibrium + direction * sin(t) * 0.05;
 			}
+			node_ptr->dirty = true;
 			idx++;
 		}
-		generate_bmesh();
+		return idx > 0;
 	}
 
 	/******************************
@@ -158,20 +149,20 @@ namespace Balle
 		else if (selected == root)
 		{
 			selected->selected = false;
-			selected = (*root->children)[0];
+			selected = root->children.front();
 			selected->selected = true;
 		}
 		else
 		{
 			selected->selected = false;
 
-			int index = rand() % selected->parent->children->size();
-			if ((*selected->parent->children)[index] == selected)
+			int index = rand() % selected->parent->children.size();
+			if (selected->parent->children[index] == selected)
 			{
-				index = (index + 1) % selected->parent->children->size();
+				index = (index + 1) % selected->parent->children.size();
 			}
 
-			selected = (*selected->parent->children)[index];
+			selected = selected->parent->children[index];
 			selected->selected = true;
 		}
 	}
@@ -205,44 +196,45 @@ namespace Balle
 		}
 		else
 		{
-			if (selected->children->size() == 0)
+			if (selected->children.empty())
 				return; // No children
 
 			selected->selected = false;
-			selected = (*selected->children)[0];
+			selected = selected->children.front();
 			selected->selected = true;
 		}
 	}
 
 	SkeletalNode *BMesh::create_skeletal_node_after(SkeletalNode *parent)
 	{
+		__topology_changed();
 		SkeletalNode *temp;
 		if (parent == nullptr)
 		{
-			temp = new Balle::SkeletalNode(Vector3D(0, 0, 0), 0.05, parent);
+			temp = all_nodes.create(Vector3D(0, 0, 0), 0.05, parent);
 			root = temp;
 		}
 		else
 		{
-			temp = new Balle::SkeletalNode(parent->pos, parent->radius, parent);
-			parent->children->push_back(temp);
+			temp = all_nodes.create(parent->pos, parent->radius, parent);
+			parent->children.push_back(temp);
 		}
-		all_nodes.emplace(temp);
 		return temp;
 	}
 
 	bool BMesh::delete_node(SkeletalNode *node)
 	{
+		__topology_changed();
 		if (node == root)
 		{
 			logger->info("Deleting root, trying to reassign root first.");
-			if (node->children->size() > 0)
+			if (!node->children.empty())
 			{
-				SkeletalNode *parent = (*node->children)[0];
+				SkeletalNode *parent = node->children.front();
 				SkeletalNode *target = parent;
 				while (target->interpolated)
 				{
-					target = (*target->children)[0];
+					target = target->children.front();
 				}
 				__reroot(target, parent);
 				logger->info("Reassign root succeeded.");
@@ -250,45 +242,29 @@ namespace Balle
 			else
 			{
 				logger->warn("Deleting singular root!");
-				delete node->children;
-				delete node;
-				all_nodes.erase(node);
+				all_nodes.destroy(node);
 				root = nullptr;
 				return true;
 			}
 		}
 
 		SkeletalNode *cur = node;
-		vector<SkeletalNode *> node_children(*node->children);
+		vector<SkeletalNode *> node_children(node->children.begin(), node->children.end());
 		do
 		{
-			// First remove the node from the master list
-			if (all_nodes.count(cur) != 0)
-			{
-				all_nodes.erase(cur);
-			}
-			// Second remove the node from the parent list
+			// First remove the node from the parent list
 			SkeletalNode *parent = cur->parent;
-			size_t idx = 0;
-			for (SkeletalNode *temp : *(parent->children))
-			{
-				if (temp == cur)
-				{
-					break;
-				}
-				idx += 1;
-			}
-			parent->children->erase(parent->children->begin() + idx);
+			parent->children.remove(cur);
 
-			// Delete cur
-			delete cur;
+			// Second give its slot back to the skeleton
+			all_nodes.destroy(cur);
 			cur = parent;
 		} while (cur != nullptr && cur->interpolated);
 
 		// Third add origin node children to the first non-interpolated ancestor's
 		for (SkeletalNode *node_child : node_children)
 		{
-			cur->children->emplace_back(node_child);
+			cur->children.push_back(node_child);
 			node_child->parent = cur;
 		}
 		return true;
@@ -303,22 +279,14 @@ namespace Balle
 			cur->parent = parent;
 
 			// Second remove parent from cur->children
-			size_t idx;
-			for (idx = 0; idx < cur->children->size(); idx++)
-			{
-				if ((*cur->children)[idx] == parent)
-				{
-					break;
-				}
-			}
-			cur->children->erase(cur->children->begin() + idx);
+			cur->children.remove(parent);
 
 			// Third add cur to parent->children
-			parent->children->push_back(cur);
+			parent->children.push_back(cur);
 
 			// Fourth advance to target
 			cur = parent;
-			parent = (*parent->children)[0];
+			parent = parent->children.front();
 		}
 		target->parent = nullptr;
 		root = target;
@@ -326,8 +294,29 @@ namespace Balle
 
 	void BMesh::interpolate_spheres()
 	{
+		Misc::ScopedTimer timer("interpolate_spheres");
+
+		// Every edit of the nodes ends up here
+		geometry_version.skeleton++;
+		if (interpolation_valid)
+		{
+			// Same tree: move the interpolated spheres instead of recreating them,
+			// so that the nodes (and the patches swept around them) survive
+			__reinterpolate_helper(root);
+			return;
+		}
+		__clear_patches();
 		__delete_interpolation_helper(root);
 		__interpspheres_helper(root, 1);
+		interpolation_valid = root != nullptr;
+	}
+
+	void BMesh::__topology_changed()
+	{
+		geometry_version.skeleton++;
+		interpolation_valid = false;
+		all_nodes.invalidate_order();
+		__clear_patches();
 	}
 
 	void BMesh::__delete_interpolation_helper(SkeletalNode *root)
@@ -339,70 +328,109 @@ namespace Balle
 			return;
 		}
 
-		vector<SkeletalNode *> *new_children = new vector<SkeletalNode *>();
-
-		for (SkeletalNode *child : *(root->children))
+		// Collected first, the pass relinks the tree under the cached order
+		vector<SkeletalNode *> real_nodes;
+		for (SkeletalNode *node : all_nodes.preorder(root))
 		{
-			SkeletalNode *cur = child;
-			while (cur != nullptr && cur->interpolated)
+			if (!node->interpolated)
 			{
-				SkeletalNode *next = (*cur->children)[0];
-				all_nodes.erase(cur);
-				delete cur;
-				cur = next;
+				real_nodes.push_back(node);
 			}
-			if (cur != nullptr)
+		}
+
+		for (SkeletalNode *node : real_nodes)
+		{
+			vector<SkeletalNode *> old_children(node->children.begin(), node->children.end());
+			node->children.clear();
+
+			for (SkeletalNode *child : old_children)
 			{
-				new_children->push_back(cur);
-				__delete_interpolation_helper(cur);
+				SkeletalNode *cur = child;
+				while (cur != nullptr && cur->interpolated)
+				{
+					SkeletalNode *next = cur->children.front();
+					all_nodes.destroy(cur);
+					cur = next;
+				}
+				if (cur != nullptr)
+				{
+					cur->parent = node;
+					node->children.push_back(cur);
+				}
 			}
 		}
-		delete root->children;
-		root->children = new_children;
 	}
 
-	unordered_set<SkeletalNode *> BMesh::get_all_node()
+	bool BMesh::export_to_file(const string &filename)
 	{
-		return all_nodes;
+		logger->info("Saving as: " + filename);
+		return write_obj(*mesh, filename, weld_epsilon);
 	}
 
-	void BMesh::export_to_file(const string &filename)
+	bool write_obj(const HalfedgeMesh &mesh, const string &filename, double weld_epsilon)
 	{
-		logger->info("Saving as: " + filename);
 		ofstream file;
 		file.open(filename);
+		if (!file.good())
+		{
+			return false;
+		}
 
-		unordered_map<Vector3D, int> vert_to_ind;
-		int i = 1;
-		for (VertexIter v = mesh->verticesBegin(); v != mesh->verticesEnd(); v++)
+		// Coincident vertices are written once, so the file has no cracks
+		Misc::VertexWelder vert_to_ind(weld_epsilon);
+		vert_to_ind.reserve(mesh.nVertices());
+		for (VertexCIter v = mesh.verticesBegin(); v != mesh.verticesEnd(); v++)
+		{
+			vert_to_ind.insert(v->position);
+		}
+		for (const Vector3D &position : vert_to_ind.points())
 		{
 			file << "v"
-				 << " " << v->position.x << " " << v->position.y << " " << v->position.z << endl;
-			vert_to_ind[v->position] = i++;
+				 << " " << position.x << " " << position.y << " " << position.z << endl;
 		}
 
 		file << "g all_faces" << endl;
 
-		for (FaceIter f = mesh->facesBegin(); f != mesh->facesEnd(); f++)
+		for (FaceCIter f = mesh.facesBegin(); f != mesh.facesEnd(); f++)
 		{
 			file << "f";
 
-			HalfedgeIter h = f->halfedge();
+			HalfedgeCIter h = f->halfedge();
 			do
 			{
-				file << " " << vert_to_ind[h->vertex()->position];
+				file << " " << vert_to_ind.find(h->vertex()->position) + 1;
 				h = h->next();
 			} while (h != f->halfedge());
 
 			file << endl;
 		}
 
+		// A full disk only shows once the last buffer is flushed
 		file.close();
+		return file.good();
+	}
+
+	// Binary skeletons are picked by extension when saving and by their
+	// magic when loading
+	static bool is_binary_filename(const string &filename)
+	{
+		const string extension = ".balleb";
+		return filename.size() >= extension.size() &&
+			   filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0;
 	}
 
 	void BMesh::save_to_file(const string &filename)
 	{
 		logger->info("Saving as: " + filename);
+		if (is_binary_filename(filename))
+		{
+			if (!__skeleton_to_binary(filename))
+			{
+				logger->error("Could not write " + filename);
+			}
+			return;
+		}
+
 		// Load all info into json
 		json j;
 		__skeleton_to_json(j);
@@ -417,6 +445,17 @@ namespace Balle
 	bool BMesh::load_from_file(const string &filename)
 	{
 		logger->info("Loading from: " + filename);
+		if (is_binary_skeleton(filename))
+		{
+			MappedSkeleton skeleton;
+			if (!skeleton.open(filename) || !__binary_to_skeleton(skeleton))
+			{
+				return false;
+			}
+			__topology_changed();
+			return true;
+		}
+
 		ifstream file(filename);
 		if (!file.good())
 		{
@@ -426,7 +465,16 @@ namespace Balle
 		file >> j;
 		file.close();
 
-		__json_to_skeleton(j);
+		return load_from_json(j);
+	}
+
+	bool BMesh::load_from_json(const json &j)
+	{
+		if (!__json_to_skeleton(j))
+		{
+			return false;
+		}
+		__topology_changed();
 
 		return true;
 	}
@@ -450,42 +498,60 @@ namespace Balle
 		 * }
 		 */
 
-		// REMOVE INTERPOLATED NODES
-		__delete_interpolation_helper(root);
-
-		j["count"] = all_nodes.size();
-		unordered_map<SkeletalNode *, int> spheres_to_index;
-
-		int i = 0;
+		// Only the nodes the user placed are saved. The interpolated ones stay
+		// in the tree, along with the patches swept around them.
+		vector<SkeletalNode *> nodes;
+		vector<int32_t> parent;
+		__real_nodes(nodes, parent);
 
-		for (auto s : all_nodes)
+		vector<vector<int>> children(nodes.size());
+		for (size_t i = 0; i < nodes.size(); i++)
 		{
-			spheres_to_index[s] = i;
+			if (parent[i] != -1)
+			{
+				children[parent[i]].push_back((int)i);
+			}
+		}
 
+		j["count"] = nodes.size();
+		for (size_t i = 0; i < nodes.size(); i++)
+		{
+			SkeletalNode *s = nodes[i];
 			j["spheres"][i]["index"] = i; // Just for debugging
 			j["spheres"][i]["radius"] = s->radius;
 			j["spheres"][i]["pos"] = vector<double>({s->pos.x, s->pos.y, s->pos.z});
+			j["spheres"][i]["children"] = children[i];
+			j["spheres"][i]["parent"] = parent[i];
+		}
+	}
 
-			i++;
+	void BMesh::__real_nodes(vector<SkeletalNode *> &nodes, vector<int32_t> &parent) const
+	{
+		// Interpolated nodes only ever sit between two real ones, so skipping
+		// them leaves the preorder of the tree the user built
+		nodes.clear();
+		parent.clear();
+		if (root == nullptr)
+		{
+			return;
 		}
 
-		for (auto s : all_nodes)
+		vector<int32_t> index_of(all_nodes.id_bound());
+		for (SkeletalNode *node : all_nodes.preorder(root))
 		{
-			vector<int> children;
-			for (SkeletalNode *child : *s->children)
+			if (node->interpolated)
 			{
-				children.push_back(spheres_to_index[child]);
+				continue;
 			}
 
-			j["spheres"][spheres_to_index[s]]["children"] = children;
-			if (s->parent == NULL)
-			{
-				j["spheres"][spheres_to_index[s]]["parent"] = -1;
-			}
-			else
+			SkeletalNode *ancestor = node->parent;
+			while (ancestor != NULL && ancestor->interpolated)
 			{
-				j["spheres"][spheres_to_index[s]]["parent"] = spheres_to_index[s->parent];
+				ancestor = ancestor->parent;
 			}
+			index_of[node->id] = (int32_t)nodes.size();
+			nodes.push_back(node);
+			parent.push_back(ancestor == NULL ? -1 : index_of[ancestor->id]);
 		}
 	}
 
@@ -510,7 +576,6 @@ namespace Balle
 
 		// Delet all the spheres
 		__avada_kedavra();
-		all_nodes.clear();
 
 		unordered_map<int, SkeletalNode *> index_to_spheres;
 
@@ -525,8 +590,7 @@ namespace Balle
 			double radius = s["radius"];
 			int i = s["index"];
 
-			SkeletalNode *temp = new SkeletalNode(pos, radius, NULL);
-			all_nodes.insert(temp);
+			SkeletalNode *temp = all_nodes.create(pos, radius, NULL);
 			index_to_spheres[i] = temp;
 		}
 
@@ -548,23 +612,140 @@ namespace Balle
 
 			for (int i_child : s["children"])
 			{
-				temp->children->push_back(index_to_spheres[i_child]);
+				temp->children.push_back(index_to_spheres[i_child]);
 			}
 		}
 
 		return true;
 	}
 
-	void BMesh::__avada_kedavra()
+	bool BMesh::__skeleton_to_binary(const string &filename)
+	{
+		if (root == NULL)
+		{
+			return false;
+		}
+
+		// Preorder, so that every parent is written before its children and
+		// the children come back in the same order. Like the JSON, only the
+		// real nodes are written and the tree is left as it is.
+		vector<SkeletalNode *> nodes;
+		vector<int32_t> parent;
+		__real_nodes(nodes, parent);
+
+		size_t n = nodes.size();
+		vector<double> x, y, z;
+		vector<float> radius;
+		x.reserve(n);
+		y.reserve(n);
+		z.reserve(n);
+		radius.reserve(n);
+		for (SkeletalNode *node : nodes)
+		{
+			x.push_back(node->pos.x);
+			y.push_back(node->pos.y);
+			z.push_back(node->pos.z);
+			radius.push_back(node->radius);
+		}
+
+		return write_binary_skeleton(filename, x, y, z, radius, parent);
+	}
+
+	bool BMesh::__binary_to_skeleton(const MappedSkeleton &skeleton)
+	{
+		// The file is validated on open, parents always come first
+		__avada_kedavra();
+		all_nodes.reserve(skeleton.size());
+
+		vector<SkeletalNode *> nodes(skeleton.size());
+		for (size_t i = 0; i < skeleton.size(); i++)
+		{
+			Vector3D pos(skeleton.x[i], skeleton.y[i], skeleton.z[i]);
+			SkeletalNode *parent = skeleton.parent[i] < 0 ? NULL : nodes[skeleton.parent[i]];
+
+			SkeletalNode *temp = all_nodes.create(pos, skeleton.radius[i], parent);
+			if (parent == NULL)
+			{
+				root = temp;
+			}
+			else
+			{
+				parent->children.push_back(temp);
+			}
+			nodes[i] = temp;
+		}
+
+		return true;
+	}
+
+	void BMesh::snapshot_skeleton(SkeletonSnapshot &snapshot) const
+	{
+		vector<SkeletalNode *> nodes;
+		__real_nodes(nodes, snapshot.parent);
+		snapshot.pos.resize(nodes.size());
+		snapshot.radius.resize(nodes.size());
+		for (size_t i = 0; i < nodes.size(); i++)
+		{
+			snapshot.pos[i] = nodes[i]->pos;
+			snapshot.radius[i] = nodes[i]->radius;
+		}
+	}
+
+	void BMesh::load_snapshot(const SkeletonSnapshot &snapshot)
+	{
+		__avada_kedavra();
+		all_nodes.reserve(snapshot.size());
+
+		vector<SkeletalNode *> nodes(snapshot.size());
+		for (size_t i = 0; i < snapshot.size(); i++)
+		{
+			SkeletalNode *parent = snapshot.parent[i] < 0 ? NULL : nodes[snapshot.parent[i]];
+
+			SkeletalNode *temp = all_nodes.create(snapshot.pos[i], snapshot.radius[i], parent);
+			if (parent == NULL)
+			{
+				root = temp;
+			}
+			else
+			{
+				parent->children.push_back(temp);
+			}
+			nodes[i] = temp;
+		}
+		__topology_changed();
+	}
+
+	bool BMesh::update_from_snapshot(const SkeletonSnapshot &snapshot)
 	{
-		vector<SkeletalNode *> temp(all_nodes.begin(), all_nodes.end());
-		for (SkeletalNode *node : temp)
+		vector<SkeletalNode *> nodes;
+		vector<int32_t> parent;
+		__real_nodes(nodes, parent);
+		if (parent != snapshot.parent)
+		{
+			return false;
+		}
+
+		for (size_t i = 0; i < nodes.size(); i++)
 		{
-			if (all_nodes.count(node) != 0)
+			SkeletalNode *node = nodes[i];
+			if (node->pos == snapshot.pos[i] && node->radius == snapshot.radius[i])
 			{
-				delete_node(node);
+				continue;
 			}
+			node->pos = snapshot.pos[i];
+			node->equilibrium = snapshot.pos[i];
+			node->radius = snapshot.radius[i];
+			node->dirty = true;
 		}
+		return true;
+	}
+
+	void BMesh::__avada_kedavra()
+	{
+		// Every node goes at once, the blocks stay for the next skeleton
+		__topology_changed();
+		all_nodes.clear();
+		root = nullptr;
 	}
 
 	/******************************
@@ -573,8 +754,23 @@ namespace Balle
 
 	void BMesh::generate_bmesh()
 	{
+		Misc::ScopedTimer timer("generate_bmesh");
 		interpolate_spheres();
-		__joint_iterate(root);
+
+		// Sweep the limbs first, then build the joint hulls on top of them
+		joint_order.clear();
+		{
+			Misc::ScopedTimer sweep_timer("joint_iterate");
+			__joint_iterate(root);
+		}
+		{
+			Misc::ScopedTimer hull_timer("joint_hulls");
+			__build_joint_hulls();
+		}
+		for (SkeletalNode *node : all_nodes)
+		{
+			node->dirty = false;
+		}
 		__stitch_faces();
 	}
 
@@ -590,14 +786,18 @@ namespace Balle
 			return;
 		}
 		__catmull_clark(*mesh);
+		geometry_version.topology++;
 	}
 
 	void BMesh::remesh()
 	{
+		// Remeshing changes the connectivity, the stencils no longer apply
+		stencils.clear();
 		__remesh_flip(*mesh);
 		__remesh_collapse(*mesh);
 		__remesh_split(*mesh);
 		__remesh_average(*mesh);
+		geometry_version.topology++;
 	}
 
 	Vector3D get_face_point(const FaceIter f)
@@ -676,69 +876,88 @@ namespace Balle
 	}
 
 	void connect_new_mesh(vector<Quadrangle> quadrangles, vector<vector<size_t>> polygons,
-						  vector<Vector3D> vertices, HalfedgeMesh &mesh)
+						  vector<Vector3D> vertices, HalfedgeMesh &mesh, double weld_epsilon)
 	{
 		polygons.clear();
 		vertices.clear();
 
-		unordered_map<Vector3D, size_t> ids;
+		Misc::VertexWelder ids(weld_epsilon);
+		ids.reserve(4 * quadrangles.size());
 
 		// label quadrangle vertices
 		for (const Quadrangle &quadrangle : quadrangles)
 		{
-			if (ids.count(quadrangle.a) == 0)
-			{
-				ids[quadrangle.a] = ids.size();
-				vertices.push_back(quadrangle.a);
-			}
-			if (ids.count(quadrangle.b) == 0)
-			{
-				ids[quadrangle.b] = ids.size();
-				vertices.push_back(quadrangle.b);
-			}
-			if (ids.count(quadrangle.c) == 0)
-			{
-				ids[quadrangle.c] = ids.size();
-				vertices.push_back(quadrangle.c);
-			}
-			if (ids.count(quadrangle.d) == 0)
-			{
-				ids[quadrangle.d] = ids.size();
-				vertices.push_back(quadrangle.d);
-			}
-			unordered_set<size_t> distinct_ids = {ids[quadrangle.a], ids[quadrangle.b], ids[quadrangle.c], ids[quadrangle.d]};
+			size_t ida = ids.insert(quadrangle.a), idb = ids.insert(quadrangle.b);
+			size_t idc = ids.insert(quadrangle.c), idd = ids.insert(quadrangle.d);
+			unordered_set<size_t> distinct_ids = {ida, idb, idc, idd};
 			if (distinct_ids.size() == 4)
 			{
-				polygons.push_back({ids[quadrangle.a], ids[quadrangle.b], ids[quadrangle.c], ids[quadrangle.d]});
+				polygons.push_back({ida, idb, idc, idd});
 			}
 		}
+		vertices = ids.points();
 
-		mesh.build(polygons, vertices);
+		Misc::ScopedTimer timer("halfedge_build");
+		mesh.buildFast(polygons, vertices);
 	}
 
 	void BMesh::__catmull_clark(HalfedgeMesh &mesh)
 	{
-		//  1. Add new face point
-		for (FaceIter f = mesh.facesBegin(); f != mesh.facesEnd(); f++)
+		Misc::ScopedTimer timer("catmull_clark");
+
+		// Each phase only writes to its own elements, so the elements are
+		// split between the worker threads by index
+		mesh.compact();
+
+		// Keep the stencils in step with the refinement (before the
+		// connectivity of this level is replaced)
+		if (&mesh == this->mesh && !stencils.empty())
 		{
-			f->isNew = true;
-			f->newPosition = get_face_point(f);
+			stencils.refineCatmullClark(mesh, max_stencil_entries);
 		}
 
+		//  1. Add new face point
+		thread_pool.parallel_for(0, mesh.nFaces(), [&mesh](size_t begin, size_t end, size_t)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				FaceIter f = mesh.faceAt(i);
+				f->isNew = true;
+				f->newPosition = get_face_point(f);
+			}
+		});
+
 		// 2. Add new edge point
-		for (EdgeIter e = mesh.edgesBegin(); e != mesh.edgesEnd(); e++)
+		thread_pool.parallel_for(0, mesh.nEdges(), [&mesh](size_t begin, size_t end, size_t)
 		{
-			e->isNew = true;
-			e->newPosition = get_edge_point(e);
-		}
+			for (size_t i = begin; i < end; i++)
+			{
+				EdgeIter e = mesh.edgeAt(i);
+				e->isNew = true;
+				e->newPosition = get_edge_point(e);
+			}
+		});
 
 		// 3. Calculate new vertex
-		for (VertexIter v = mesh.verticesBegin(); v != mesh.verticesEnd(); v++)
+		thread_pool.parallel_for(0, mesh.nVertices(), [&mesh](size_t begin, size_t end, size_t)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				VertexIter v = mesh.vertexAt(i);
+				v->isNew = false;
+				v->newPosition = get_new_vertex(v);
+			}
+		});
+		// 4. split every face into quads in place, straight from the element
+		// indices of the current mesh
+		if (mesh.splitFacesIntoQuads() == 0)
 		{
-			v->isNew = false;
-			v->newPosition = get_new_vertex(v);
+			logger->info("CC division: call subdivision, new quad size " + to_string(mesh.nFaces()));
+			return;
 		}
-		// 4. generate quads, 1 face divide in to 4 faces
+
+		// Meshes with boundaries go through the polygon soup instead:
+		// generate quads, 1 face divide in to 4 faces
 		quadrangles.clear();
 		for (FaceIter f = mesh.facesBegin(); f != mesh.facesEnd(); f++)
 		{
@@ -748,12 +967,55 @@ namespace Balle
 		logger->info("CC division: call subdivision, new quad size " + to_string(quadrangles.size()));
 
 		// 5. mapping the quads to the polygon and vertex
-		connect_new_mesh(quadrangles, polygons, vertices, mesh);
+		connect_new_mesh(quadrangles, polygons, vertices, mesh, weld_epsilon);
 		logger->info("CC division: call subdivision, finish connecting new mesh");
 	}
 
+	void BMesh::__reset_stencils()
+	{
+		stencils.clear();
+		stencil_polygons.clear();
+
+		// The stencil rows follow the vertex slots, which buildFast puts in
+		// input order; make sure that is what we got
+		if (mesh == nullptr || !mesh->isCompact() || mesh->nVertices() != vertices.size())
+		{
+			return;
+		}
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			if (!(mesh->vertexAt(i)->position == vertices[i]))
+			{
+				return;
+			}
+		}
+
+		stencils.setIdentity(vertices.size());
+		stencil_polygons = polygons;
+	}
+
+	bool BMesh::__reevaluate_mesh()
+	{
+		if (mesh == nullptr || stencils.empty() ||
+			stencils.nControlVertices() != vertices.size() ||
+			stencils.nVertices() != mesh->nVertices() ||
+			polygons != stencil_polygons)
+		{
+			return false;
+		}
+
+		Misc::ScopedTimer timer("stencil_eval");
+		thread_pool.parallel_for(0, stencils.nVertices(), [this](size_t begin, size_t end, size_t)
+		{
+			stencils.apply(vertices, *mesh, begin, end);
+		});
+		return true;
+	}
+
 	void BMesh::__remesh_split(HalfedgeMesh &mesh)
 	{
+		Misc::ScopedTimer timer("remesh_split");
+
 		// Edge split operation
 		vector<EdgeIter> edges;
 
@@ -790,6 +1052,7 @@ namespace Balle
 
 	void BMesh::__remesh_collapse(HalfedgeMesh &mesh)
 	{
+		Misc::ScopedTimer timer("remesh_collapse");
 
 		// Edge collapse operation
 		vector<EdgeIter> edges;
@@ -838,11 +1101,17 @@ namespace Balle
 			}
 		}
 
+		// Collapsing leaves holes in the element pools, squeeze them out so
+		// that later passes walk densely packed elements again
+		mesh.compact();
+
 		logger->info("remesh: finish collapse, deleted edge number " + to_string(n));
 	}
 
 	void BMesh::__remesh_flip(HalfedgeMesh &mesh)
 	{
+		Misc::ScopedTimer timer("remesh_flip");
+
 		// Edge flip operation
 		vector<EdgeIter> edges;
 
@@ -890,6 +1159,8 @@ namespace Balle
 
 	void BMesh::__remesh_average(HalfedgeMesh &mesh)
 	{
+		Misc::ScopedTimer timer("remesh_average");
+
 		// Vertex average
 		for (VertexIter v = mesh.verticesBegin(); v != mesh.verticesEnd(); v++)
 		{
@@ -924,42 +1195,118 @@ namespace Balle
 	}
 
 	/******************************
-	 * PRIVATE                    *
+	 * Picking                    *
 	 ******************************/
 
-	void edge_interpolate(const SkeletalNode &n1, const SkeletalNode &n2, float *rad, float *x)
+	SkeletalNode *BMesh::pick(const Vector3D &origin, const Vector3D &direction)
 	{
-		// Interpolate a sphere touching n1
+		Misc::ScopedTimer timer("pick");
 
-		float d = (n2.pos - n1.pos).norm();
-		float r3 = n1.radius * (d + n2.radius - n1.radius) / (d - n2.radius + n1.radius);
-		*x = n1.radius + r3;
+		bool rebuild = !bvh_valid || bvh_topology != all_nodes.topology_version();
+		if (rebuild || bvh_skeleton != geometry_version.skeleton)
+		{
+			if (rebuild)
+			{
+				bvh_nodes.assign(all_nodes.begin(), all_nodes.end());
+			}
+			vector<Vector3D> centers(bvh_nodes.size());
+			vector<double> radii(bvh_nodes.size());
+			for (size_t i = 0; i < bvh_nodes.size(); i++)
+			{
+				centers[i] = bvh_nodes[i]->pos;
+				radii[i] = bvh_nodes[i]->radius;
+			}
 
-		*rad = r3;
-		//	*pos = n1.pos + x * (n2.pos - n1.pos).unit();
+			if (rebuild)
+			{
+				sphere_bvh.build(centers, radii);
+			}
+			else
+			{
+				sphere_bvh.refit(centers, radii);
+			}
+			bvh_topology = all_nodes.topology_version();
+			bvh_skeleton = geometry_version.skeleton;
+			bvh_valid = true;
+		}
+
+		double t;
+		size_t hit = sphere_bvh.intersect(Misc::Ray(origin, direction), t);
+		return hit == Misc::SphereBVH::npos ? nullptr : bvh_nodes[hit];
 	}
 
-	void BMesh::__interpspheres_helper(SkeletalNode *root, int divs)
+	bool BMesh::pick_surface(const Vector3D &origin, const Vector3D &direction, Vector3D &hit)
 	{
-		if (root == nullptr)
-		{
-			return;
-		}
+		Misc::ScopedTimer timer("pick_surface");
+		__update_surface_bvh();
 
-		// Iterate through each child node
-		vector<SkeletalNode *> *original_children = new vector<SkeletalNode *>();
-		for (SkeletalNode *child : *(root->children))
+		Misc::Ray ray(origin, direction);
+		double t;
+		if (surface_bvh.intersect(ray, t) == Misc::TriangleBVH::npos)
 		{
-			original_children->push_back(child);
+			return false;
 		}
+		hit = ray.at(t);
+		return true;
+	}
 
-		float radius = 1000;
-		float x = 0;
+	double BMesh::closest_surface_point(const Vector3D &p, Vector3D &closest)
+	{
+		Misc::ScopedTimer timer("closest_surface_point");
+		__update_surface_bvh();
 
-		// Get the smallest interpolation between joint, to parents and children
-		for (SkeletalNode *child : *(original_children))
+		if (surface_bvh.closest_point(p, closest) == Misc::TriangleBVH::npos)
 		{
-			float temp_rad, temp_x;
+			return -1.;
+		}
+		return (closest - p).norm();
+	}
+
+	const Misc::TriangleBVH &BMesh::get_surface_bvh()
+	{
+		__update_surface_bvh();
+		return surface_bvh;
+	}
+
+	/******************************
+	 * PRIVATE                    *
+	 ******************************/
+
+	void edge_interpolate(const SkeletalNode &n1, const SkeletalNode &n2, float *rad, float *x)
+	{
+		// Interpolate a sphere touching n1
+
+		float d = (n2.pos - n1.pos).norm();
+		float r3 = n1.radius * (d + n2.radius - n1.radius) / (d - n2.radius + n1.radius);
+		*x = n1.radius + r3;
+
+		*rad = r3;
+		//	*pos = n1.pos + x * (n2.pos - n1.pos).unit();
+	}
+
+	void BMesh::__interpspheres_helper(SkeletalNode *root, int divs)
+	{
+		// Parents first, so that every node finds the sphere its parent put in
+		// front of it. Copied, since the pass adds nodes
+		vector<SkeletalNode *> order = all_nodes.preorder(root);
+		for (SkeletalNode *node : order)
+		{
+			__interpolate_node(node, divs);
+		}
+	}
+
+	void BMesh::__interpolate_node(SkeletalNode *root, int divs)
+	{
+		// Iterate through each child node
+		vector<SkeletalNode *> original_children(root->children.begin(), root->children.end());
+
+		float radius = 1000;
+		float x = 0;
+
+		// Get the smallest interpolation between joint, to parents and children
+		for (SkeletalNode *child : original_children)
+		{
+			float temp_rad, temp_x;
 
 			edge_interpolate(*root, *child, &temp_rad, &temp_x);
 
@@ -983,41 +1330,21 @@ namespace Balle
 			}
 
 			// Now interpolate to the parent
-			SkeletalNode *interp_sphere = new SkeletalNode(root->pos + x * (root->parent->pos - root->pos).unit(), radius, root->parent);
+			SkeletalNode *interp_sphere = all_nodes.create(root->pos + x * (root->parent->pos - root->pos).unit(), radius, root->parent);
 			interp_sphere->interpolated = true;
 
 			SkeletalNode *temp_parent = root->parent;
+			temp_parent->children.remove(root);
 
-			int i = 0;
-			for (SkeletalNode *temp : *(root->parent->children))
-			{
-				if (temp == root)
-				{
-					root->parent->children->erase(root->parent->children->begin() + i);
-					break;
-				}
-				i += 1;
-			}
-
-			temp_parent->children->push_back(interp_sphere);
-			interp_sphere->children->push_back(root);
+			temp_parent->children.push_back(interp_sphere);
+			interp_sphere->children.push_back(root);
 			root->parent = interp_sphere;
-			all_nodes.emplace(interp_sphere);
 		}
 
-		for (SkeletalNode *child : *(original_children))
+		for (SkeletalNode *child : original_children)
 		{
 			// Remove the child from the current parents list of children
-			int i = 0;
-			for (SkeletalNode *temp : *(root->children))
-			{
-				if (temp == child)
-				{
-					root->children->erase(root->children->begin() + i);
-					break;
-				}
-				i += 1;
-			}
+			root->children.remove(child);
 
 			// Between the parent and each child, create new spheres
 			SkeletalNode *prev = root;
@@ -1034,24 +1361,89 @@ namespace Balle
 				float new_radius = root->radius + (i + 1) * rad_step;
 
 				// Create the interp sphere
-				// SkeletalNode *interp_sphere = new SkeletalNode(new_position, new_radius, prev);
-				SkeletalNode *interp_sphere = new SkeletalNode(root->pos + x * (child->pos - root->pos).unit(), radius, prev);
+				// SkeletalNode *interp_sphere = all_nodes.create(new_position, new_radius, prev);
+				SkeletalNode *interp_sphere = all_nodes.create(root->pos + x * (child->pos - root->pos).unit(), radius, prev);
 				interp_sphere->interpolated = true;
 
 				// Add the interp sphere to the struct
-				prev->children->push_back(interp_sphere);
-				all_nodes.emplace(interp_sphere);
+				prev->children.push_back(interp_sphere);
 
 				// Update prev
 				prev = interp_sphere;
 			}
 
 			// New re add the child node back to the end of the joint
-			prev->children->push_back(child);
+			prev->children.push_back(child);
 			child->parent = prev;
+		}
+	}
+
+	void move_interpolated(SkeletalNode *node, const Vector3D &pos, float radius)
+	{
+		if (!(node->pos == pos) || node->radius != radius)
+		{
+			node->pos = pos;
+			node->radius = radius;
+			node->dirty = true;
+		}
+	}
+
+	void BMesh::__reinterpolate_helper(SkeletalNode *root)
+	{
+		// The tree keeps its shape, so the cached order still holds. Parents go
+		// first: a node reads the sphere its parent placed in front of it
+		for (SkeletalNode *node : all_nodes.preorder(root))
+		{
+			if (!node->interpolated)
+			{
+				__reinterpolate_node(node);
+			}
+		}
+	}
+
+	void BMesh::__reinterpolate_node(SkeletalNode *root)
+	{
+		// Same computation as __interpolate_node, on a tree that is already
+		// interpolated: each edge reads root -> near_root -> near_child -> child,
+		// where near_root is placed by root and near_child by child
+		float radius = 1000;
+		float x = 0;
+
+		// Get the smallest interpolation between joint, to parents and children
+		for (SkeletalNode *near_root : root->children)
+		{
+			SkeletalNode *child = near_root->children.front()->children.front();
+			float temp_rad, temp_x;
 
-			// Now do the recursive call
-			__interpspheres_helper(child, divs);
+			edge_interpolate(*root, *child, &temp_rad, &temp_x);
+
+			if (temp_rad < radius)
+			{
+				radius = temp_rad;
+				x = temp_x;
+			}
+		}
+		radius *= 0.8;
+
+		if (root->parent != NULL)
+		{
+			SkeletalNode *near_parent = root->parent->parent;
+
+			float temp_rad, temp_x;
+			edge_interpolate(*root, *near_parent, &temp_rad, &temp_x);
+			if (temp_rad < radius)
+			{
+				radius = temp_rad;
+				x = temp_x;
+			}
+
+			move_interpolated(root->parent, root->pos + x * (near_parent->pos - root->pos).unit(), radius);
+		}
+
+		for (SkeletalNode *near_root : root->children)
+		{
+			SkeletalNode *child = near_root->children.front()->children.front();
+			move_interpolated(near_root, root->pos + x * (child->pos - root->pos).unit(), radius);
 		}
 	}
 
@@ -1064,7 +1456,7 @@ namespace Balle
 		double child_radius = child->radius;
 
 		Vector3D localx;
-		if ((root->children->size() == 1) && (root->parent != nullptr))
+		if ((root->children.size() == 1) && (root->parent != nullptr))
 		{
 			localx = ((root_center - root->parent->pos) + (child_center - root_center)).unit();
 		}
@@ -1111,7 +1503,219 @@ namespace Balle
 			// This should not be possible cause im calling this func only on joint nodes
 			throw runtime_error("ERROR: joint node is null");
 		}
-		if ((root->parent == nullptr) && (root->children->size() == 0))
+
+		// Every node with more than one child is a joint, and so is the root.
+		// A joint reads the end of its parent's limb, so joints are swept
+		// parents first; their patches are spliced children first.
+		const vector<SkeletalNode *> &order = all_nodes.preorder(root);
+		for (SkeletalNode *node : order)
+		{
+			if (node == root || node->children.size() > 1)
+			{
+				__sweep_joint(node);
+			}
+		}
+		for (SkeletalNode *node : all_nodes.postorder(root))
+		{
+			if (node == root || node->children.size() > 1)
+			{
+				joint_order.push_back(node);
+			}
+		}
+	}
+
+	void BMesh::__sweep_joint(SkeletalNode *root)
+	{
+		// Only re-sweep this joint if something around it moved
+		JointPatch *&patch = patches[root];
+		bool sweep = (patch == nullptr) || __sweep_dirty(root);
+		if (patch == nullptr)
+		{
+			patch = new JointPatch();
+		}
+
+		if ((root->parent == nullptr) && (root->children.empty()))
+		{ // Main  root only: its hull is just a sphere
+			patch->hull_dirty = sweep;
+			return;
+		}
+
+		if (sweep)
+		{
+			patch->clear_limbs();
+		}
+
+		// Because this is a joint node, iterate through all children
+		for (SkeletalNode *child : root->children)
+		{
+			if (child->children.empty())
+			{ // Leaf node
+				// That child should only have one rectangle mesh (essentially 2D)
+				if (sweep)
+				{
+					Limb *childlimb = new Limb();
+					patch->limbs.push_back(childlimb);
+					__update_limb(root, child, false, childlimb, true);
+					child->limb = childlimb;
+					childlimb->seal();
+				}
+			}
+			else if (child->children.size() == 1)
+			{ // limb node
+				// Create a new limb for this child
+				Limb *childlimb = nullptr;
+				if (sweep)
+				{
+					childlimb = new Limb();
+					patch->limbs.push_back(childlimb);
+				}
+
+				SkeletalNode *cur = child;
+				SkeletalNode *last;
+				while (cur->children.size() == 1)
+				{
+					if (sweep)
+					{
+						cur->limb = childlimb;
+						__update_limb(cur, cur->children.front(), true, childlimb, false);
+					}
+					last = cur;
+					cur = cur->children.front();
+				}
+				if (cur->children.empty())
+				{ // sweeping reached the end leaf node
+					if (sweep)
+					{
+						__update_limb(last, cur, false, childlimb, true);
+						cur->limb = childlimb;
+						childlimb->seal();
+					}
+				}
+				// Otherwise sweeping reached a joint node, swept on its own
+			}
+		}
+
+		// The hull also depends on the end of the parent limb, which belongs to
+		// the parent joint's patch
+		vector<Vector3D> parent_fringe;
+		if (root->parent && root->parent->limb)
+		{
+			parent_fringe = root->parent->limb->get_last_four_points();
+		}
+		patch->hull_dirty = sweep || parent_fringe != patch->parent_fringe;
+		patch->parent_fringe = parent_fringe;
+	}
+
+	void BMesh::__build_joint_hulls()
+	{
+		// A hull only reads the limbs swept around its joint and only writes the
+		// joint's patch, so hulls can be built concurrently. Splicing the patches
+		// in sweep order afterwards keeps the result independent of the threads.
+		vector<SkeletalNode *> hull_joints;
+		vector<JointPatch *> hull_patches;
+		for (SkeletalNode *joint : joint_order)
+		{
+			JointPatch *patch = patches[joint];
+			if (patch->hull_dirty)
+			{
+				hull_joints.push_back(joint);
+				hull_patches.push_back(patch);
+			}
+		}
+
+		// One quickhull arena per worker, kept warm across joints and sweeps
+		size_t num_threads = thread_pool.num_threads();
+		while (hull_arenas.size() < num_threads)
+		{
+			hull_arenas.push_back(qh_arena_t());
+			qh_arena_init(&hull_arenas.back());
+		}
+		size_t capacity = 0;
+		for (const qh_arena_t &arena : hull_arenas)
+		{
+			capacity += arena.capacity;
+		}
+
+		thread_pool.parallel_for(0, hull_joints.size(), [&](size_t begin, size_t end, size_t thread_index)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				__add_limb_faces(hull_joints[i], hull_patches[i], &hull_arenas[thread_index]);
+			}
+		}, 4);
+
+		size_t peak = 0, new_capacity = 0;
+		for (const qh_arena_t &arena : hull_arenas)
+		{
+			peak += arena.peak;
+			new_capacity += arena.capacity;
+		}
+		if (new_capacity > capacity)
+		{
+			logger->info("Quickhull scratch grew to " + to_string(new_capacity) + " bytes (peak use " + to_string(peak) + " bytes)");
+		}
+
+		for (SkeletalNode *joint : joint_order)
+		{
+			__splice_patch(patches[joint]);
+		}
+	}
+
+	bool BMesh::__sweep_dirty(SkeletalNode *root)
+	{
+		// Every node __sweep_joint reads for this joint: the joint itself and
+		// the limbs down to the next joint or leaf, ends included
+		if (root->dirty)
+		{
+			return true;
+		}
+		for (SkeletalNode *child : root->children)
+		{
+			SkeletalNode *cur = child;
+			while (cur->children.size() == 1)
+			{
+				if (cur->dirty)
+				{
+					return true;
+				}
+				cur = cur->children.front();
+			}
+			if (cur->dirty)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void BMesh::__splice_patch(const JointPatch *patch)
+	{
+		quadrangles.insert(quadrangles.end(), patch->quadrangles.begin(), patch->quadrangles.end());
+		triangles.insert(triangles.end(), patch->triangles.begin(), patch->triangles.end());
+		fringe_points.insert(fringe_points.end(), patch->fringe_points.begin(), patch->fringe_points.end());
+		all_points.insert(all_points.end(), patch->all_points.begin(), patch->all_points.end());
+	}
+
+	void BMesh::__clear_patches()
+	{
+		for (auto &joint_patch : patches)
+		{
+			delete joint_patch.second;
+		}
+		patches.clear();
+	}
+
+	void BMesh::__add_limb_faces(SkeletalNode *root, JointPatch *patch, qh_arena_t *arena)
+	{
+		Misc::ScopedTimer timer("add_limb_faces");
+
+		if (root == nullptr)
+		{
+			throw runtime_error("Adding faces from a null joint node.");
+		}
+		patch->clear_hull();
+
+		if ((root->parent == nullptr) && (root->children.empty()))
 		{ // Main  root only: just make a sphere
 			// Add something related to current joint node
 			// 6 uniform nodes across the joint node sphere
@@ -1135,7 +1739,8 @@ namespace Balle
 
 			// QuickHull algorithm
 			size_t n = local_hull_points.size();
-			qh_vertex_t *vertices = (qh_vertex_t *)malloc(sizeof(qh_vertex_t) * n);
+			qh_arena_reset(arena);
+			qh_vertex_t *vertices = (qh_vertex_t *)qh_arena_alloc(arena, sizeof(qh_vertex_t) * n);
 			for (size_t i = 0; i < n; i++)
 			{
 				vertices[i].x = local_hull_points[i].x;
@@ -1144,101 +1749,40 @@ namespace Balle
 			}
 
 			// Build a convex hull using quickhull algorithm and add the hull triangles
-			qh_mesh_t mesh = qh_quickhull3d(vertices, n);
+			qh_mesh_t mesh = qh_quickhull3d_arena(vertices, n, arena);
 			unordered_set<Vector3D> unique_extra_points;
 			for (size_t i = 0; i < mesh.nindices; i += 3)
 			{
 				Vector3D a(mesh.vertices[i].x, mesh.vertices[i].y, mesh.vertices[i].z);
 				Vector3D b(mesh.vertices[i + 1].x, mesh.vertices[i + 1].y, mesh.vertices[i + 1].z);
 				Vector3D c(mesh.vertices[i + 2].x, mesh.vertices[i + 2].y, mesh.vertices[i + 2].z);
-				triangles.push_back({a, b, c});
+				patch->triangles.push_back({a, b, c});
 
 				unique_extra_points.insert(a);
 				unique_extra_points.insert(b);
 				unique_extra_points.insert(c);
 			}
-			qh_free_mesh(mesh);
 
 			for (const Vector3D &unique_extra_point : unique_extra_points)
 			{
-				all_points.push_back(unique_extra_point);
+				patch->all_points.push_back(unique_extra_point);
 			}
-
 			return;
 		}
-
-		Vector3D root_center = root->pos;
-		double root_radius = root->radius;
-
-		// Because this is a joint node, iterate through all children
-		for (SkeletalNode *child : *(root->children))
-		{
-			// Create a new limb for this child
-			Limb *childlimb = new Limb(); // Add the sweeping stuff here
-			bool first = true;
-
-			if (child->children->size() == 0)
-			{ // Leaf node
-				// That child should only have one rectangle mesh (essentially 2D)
-				__update_limb(root, child, false, childlimb, true);
-				child->limb = childlimb;
-				childlimb->seal();
-			}
-			else if (child->children->size() == 1)
-			{ // limb node
-				SkeletalNode *cur = child;
-				SkeletalNode *last;
-				while (cur->children->size() == 1)
-				{
-					cur->limb = childlimb;
-					__update_limb(cur, (*cur->children)[0], true, childlimb, false);
-					if (first)
-					{
-						first = false;
-					}
-					last = cur;
-					cur = (*cur->children)[0];
-				}
-				if (cur->children->size() == 0)
-				{ // sweeping reached the end leaf node
-					__update_limb(last, cur, false, childlimb, true);
-					cur->limb = childlimb;
-					childlimb->seal();
-				}
-				else
-				{ // Sweeping reached a joint node
-					__joint_iterate(cur);
-				}
-			}
-			else
-			{ // Joint node
-				__joint_iterate(child);
-			}
-		}
-
-		__add_limb_faces(root);
-	}
-
-	void BMesh::__add_limb_faces(SkeletalNode *root)
-	{
-		if (root == nullptr)
-		{
-			throw runtime_error("Adding faces from a null joint node.");
-		}
-		// if (root->children->size() <= 1)
+		// if (root->children.size() <= 1)
 		// {
 		// 	throw runtime_error("Adding faces from a limb node.");
 		// }
 
 		// Add child Limb quadrangles
 		// Also, the first 4 mesh vertices of child skeletal node are fringe vertices
-		for (SkeletalNode *child : *(root->children))
+		for (SkeletalNode *child : root->children)
 		{
 			if (child->limb)
 			{
 				for (const Quadrangle &quadrangle : child->limb->quadrangles)
 				{
-					quadrangles.push_back(quadrangle);
+					patch->quadrangles.push_back(quadrangle);
 				}
 			}
 		}
@@ -1250,21 +1794,21 @@ namespace Balle
 		{
 			for (const Vector3D &point : root->parent->limb->get_last_four_points())
 			{
-				fringe_points.push_back(point);
+				patch->fringe_points.push_back(point);
 				local_hull_points.push_back(point);
-				all_points.push_back(point);
+				patch->all_points.push_back(point);
 			}
 		}
 		// Also, the first 4 mesh vertices of child skeletal node are fringe vertices
-		for (SkeletalNode *child : *(root->children))
+		for (SkeletalNode *child : root->children)
 		{
 			if (child->limb)
 			{
 				for (const Vector3D &point : child->limb->get_first_four_points())
 				{
-					fringe_points.push_back(point);
+					patch->fringe_points.push_back(point);
 					local_hull_points.push_back(point);
-					all_points.push_back(point);
+					patch->all_points.push_back(point);
 				}
 			}
 		}
@@ -1286,7 +1830,8 @@ namespace Balle
 
 		// QuickHull algorithm
 		size_t n = local_hull_points.size();
-		qh_vertex_t *vertices = (qh_vertex_t *)malloc(sizeof(qh_vertex_t) * n);
+		qh_arena_reset(arena);
+		qh_vertex_t *vertices = (qh_vertex_t *)qh_arena_alloc(arena, sizeof(qh_vertex_t) * n);
 		for (size_t i = 0; i < n; i++)
 		{
 			vertices[i].x = local_hull_points[i].x;
@@ -1295,14 +1840,14 @@ namespace Balle
 		}
 
 		// Build a convex hull using quickhull algorithm and add the hull triangles
-		qh_mesh_t mesh = qh_quickhull3d(vertices, n);
+		qh_mesh_t mesh = qh_quickhull3d_arena(vertices, n, arena);
 		unordered_set<Vector3D> unique_extra_points;
 		for (size_t i = 0; i < mesh.nindices; i += 3)
 		{
 			Vector3D a(mesh.vertices[i].x, mesh.vertices[i].y, mesh.vertices[i].z);
 			Vector3D b(mesh.vertices[i + 1].x, mesh.vertices[i + 1].y, mesh.vertices[i + 1].z);
 			Vector3D c(mesh.vertices[i + 2].x, mesh.vertices[i + 2].y, mesh.vertices[i + 2].z);
-			triangles.push_back({a, b, c});
+			patch->triangles.push_back({a, b, c});
 
 			if ((a - root->pos).norm() < root->radius + 0.001)
 			{
@@ -1317,103 +1862,86 @@ namespace Balle
 				unique_extra_points.insert(c);
 			}
 		}
-		qh_free_mesh(mesh);
 
 		for (const Vector3D &unique_extra_point : unique_extra_points)
 		{
-			all_points.push_back(unique_extra_point);
+			patch->all_points.push_back(unique_extra_point);
+		}
+	}
+
+	Vector3D snap_to_closest(const Misc::PointGrid &grid, const vector<Vector3D> &points, const Vector3D &p, vector<size_t> &candidates)
+	{
+		// Snaps p like a scan over all points would: the first point closer than
+		// the closest so far wins, with the closest distance kept as a float.
+		// Rounding to float means the winner can be slightly farther than the
+		// nearest point, but never farther than the float just above it; every
+		// point beyond that bound loses against any candidate, so only the
+		// candidates need to be scanned, in their original order
+		double nearest_dist;
+		if (grid.nearest(p, nearest_dist) == Misc::PointGrid::npos)
+		{
+			return Vector3D();
 		}
+		double bound = nearest_dist * (1. + 1e-6);
+		float radius = bound;
+		if (radius <= bound)
+		{
+			radius = nextafterf(radius, INFINITY);
+		}
+		grid.within(p, radius, candidates);
+
+		Vector3D closest;
+		float closest_dist = 100;
+		for (size_t i : candidates)
+		{
+			if ((points[i] - p).norm() < closest_dist)
+			{
+				closest_dist = (points[i] - p).norm();
+				closest = points[i];
+			}
+		}
+		return closest;
 	}
 
 	void BMesh::__stitch_faces()
 	{
+		Misc::ScopedTimer timer("stitch_faces");
+
 		// label vertices in triangles and quadrangles
 		// id starts from 0
-		unordered_map<Vector3D, size_t> ids;
-		unordered_map<Vector3D, size_t> fringe_ids;
+		Misc::VertexWelder ids(weld_epsilon);
+		Misc::VertexWelder fringe_ids(weld_epsilon);
+		ids.reserve(all_points.size() + 4 * quadrangles.size());
 		// label fringe points first in groups of 4
 		// (0, 1, 2, 3), (4, 5, 6, 7), 8 etc.
 
 		// This is just for checking fringe
+		fringe_ids.reserve(fringe_points.size());
 		for (const Vector3D &point : fringe_points)
 		{
-			if (fringe_ids.count(point) == 0)
-			{
-				fringe_ids[point] = fringe_ids.size();
-			}
+			fringe_ids.insert(point);
 		}
 
 		// label quadrangle vertices
 		for (const Quadrangle &quadrangle : quadrangles)
 		{
-			if (ids.count(quadrangle.a) == 0)
-			{
-				ids[quadrangle.a] = ids.size();
-				vertices.push_back(quadrangle.a);
-			}
-			if (ids.count(quadrangle.b) == 0)
-			{
-				ids[quadrangle.b] = ids.size();
-				vertices.push_back(quadrangle.b);
-			}
-			if (ids.count(quadrangle.c) == 0)
-			{
-				ids[quadrangle.c] = ids.size();
-				vertices.push_back(quadrangle.c);
-			}
-			if (ids.count(quadrangle.d) == 0)
-			{
-				ids[quadrangle.d] = ids.size();
-				vertices.push_back(quadrangle.d);
-			}
-			unordered_set<size_t> distinct_ids = {ids[quadrangle.a], ids[quadrangle.b], ids[quadrangle.c], ids[quadrangle.d]};
+			size_t ida = ids.insert(quadrangle.a), idb = ids.insert(quadrangle.b);
+			size_t idc = ids.insert(quadrangle.c), idd = ids.insert(quadrangle.d);
+			unordered_set<size_t> distinct_ids = {ida, idb, idc, idd};
 			if (distinct_ids.size() == 4)
 			{
-				polygons.push_back({ids[quadrangle.a], ids[quadrangle.b], ids[quadrangle.c], ids[quadrangle.d]});
+				polygons.push_back({ida, idb, idc, idd});
 			}
 		}
 		// label triangle vertices
+		Misc::PointGrid grid;
+		grid.build(all_points);
+		vector<size_t> candidates;
 		for (Triangle &triangle : triangles)
 		{
-			{
-				Vector3D closest;
-				float closest_dist = 100;
-				for (const Vector3D &vert : all_points)
-				{
-					if ((vert - triangle.a).norm() < closest_dist)
-					{
-						closest_dist = (vert - triangle.a).norm();
-						closest = vert;
-					}
-				}
-				triangle.a = closest;
-			}
-			{
-				Vector3D closest;
-				float closest_dist = 100;
-				for (const Vector3D &vert : all_points)
-				{
-					if ((vert - triangle.b).norm() < closest_dist)
-					{
-						closest_dist = (vert - triangle.b).norm();
-						closest = vert;
-					}
-				}
-				triangle.b = closest;
-			}
-			{
-				Vector3D closest;
-				float closest_dist = 100;
-				for (const Vector3D &vert : all_points)
-				{
-					if ((vert - triangle.c).norm() < closest_dist)
-					{
-						closest_dist = (vert - triangle.c).norm();
-						closest = vert;
-					}
-				}
-				triangle.c = closest;
-			}
+			triangle.a = snap_to_closest(grid, all_points, triangle.a, candidates);
+			triangle.b = snap_to_closest(grid, all_points, triangle.b, candidates);
+			triangle.c = snap_to_closest(grid, all_points, triangle.c, candidates);
 
 			// Check if the triangle is still valid
 			if ((triangle.a == triangle.b) || (triangle.b == triangle.c) || (triangle.c == triangle.a))
@@ -1421,105 +1949,165 @@ namespace Balle
 				continue;
 			}
 
+			size_t fringe_ida = fringe_ids.find(triangle.a);
+			size_t fringe_idb = fringe_ids.find(triangle.b);
+			size_t fringe_idc = fringe_ids.find(triangle.c);
+
 			// Add triangle if either it has a point that is not in fringe
 			// or if all 3 points are not in the same face
-			if ((fringe_ids.count(triangle.a) == 0) ||
-				(fringe_ids.count(triangle.b) == 0) ||
-				(fringe_ids.count(triangle.c) == 0))
-			{
-				if (ids.count(triangle.a) == 0)
-				{
-					ids[triangle.a] = ids.size();
-					vertices.push_back(triangle.a);
-				}
-				if (ids.count(triangle.b) == 0)
-				{
-					ids[triangle.b] = ids.size();
-					vertices.push_back(triangle.b);
-				}
-				if (ids.count(triangle.c) == 0)
-				{
-					ids[triangle.c] = ids.size();
-					vertices.push_back(triangle.c);
-				}
-
-				size_t ida = ids[triangle.a], idb = ids[triangle.b], idc = ids[triangle.c];
-				polygons.push_back({ida, idb, idc});
-			}
-			else
+			bool add = true;
+			if ((fringe_ida != Misc::VertexWelder::npos) &&
+				(fringe_idb != Misc::VertexWelder::npos) &&
+				(fringe_idc != Misc::VertexWelder::npos))
 			{
-
-				size_t fringe_ida = fringe_ids[triangle.a];
-				size_t fringe_idb = fringe_ids[triangle.b];
-				size_t fringe_idc = fringe_ids[triangle.c];
-
 				size_t fringe_maxid = max(max(fringe_ida, fringe_idb), fringe_idc);
 				size_t fringe_minid = min(min(fringe_ida, fringe_idb), fringe_idc);
 
 				unordered_set<size_t> distinct_ids = {fringe_ida, fringe_idb, fringe_idc};
 
-				if (distinct_ids.size() == 3)
+				// Quickhull will generate faces cover the limb fringe vertices
+				// We dont want those to be added to mesh
+				// Do this by:
+				// any_fringe_vertex_id divided by 4 is the group number
+				// if the triangle's 3 vertices are in the same group,
+				// then we don't want to add this to mesh cuz it's covering the fringe
+				add = (distinct_ids.size() == 3) && ((fringe_maxid / 4) != (fringe_minid / 4));
+			}
+
+			if (add)
+			{
+				size_t ida = ids.insert(triangle.a), idb = ids.insert(triangle.b), idc = ids.insert(triangle.c);
+				if (ida != idb && idb != idc && idc != ida)
 				{
-					// Quickhull will generate faces cover the limb fringe vertices
-					// We dont want those to be added to mesh
-					// Do this by:
-					// any_fringe_vertex_id divided by 4 is the group number
-					// if the triangle's 3 vertices are in the same group,
-					// then we don't want to add this to mesh cuz it's covering the fringe
-
-					if ((fringe_maxid / 4) != (fringe_minid / 4))
-					{
-						if (ids.count(triangle.a) == 0)
-						{
-							ids[triangle.a] = ids.size();
-							vertices.push_back(triangle.a);
-						}
-						if (ids.count(triangle.b) == 0)
-						{
-							ids[triangle.b] = ids.size();
-							vertices.push_back(triangle.b);
-						}
-						if (ids.count(triangle.c) == 0)
-						{
-							ids[triangle.c] = ids.size();
-							vertices.push_back(triangle.c);
-						}
-
-						size_t ida = ids[triangle.a], idb = ids[triangle.b], idc = ids[triangle.c];
-						polygons.push_back({ida, idb, idc});
-					}
+					polygons.push_back({ida, idb, idc});
 				}
 			}
 		}
+		vertices = ids.points();
 
-		// build halfedgeMesh
-		if (mesh != nullptr)
+		// Same polygons as last time: only re-evaluate the positions of the
+		// (possibly subdivided) mesh
+		int result = 0;
+		if (__reevaluate_mesh())
 		{
-			delete mesh;
+			geometry_version.positions++;
 		}
-		mesh = new HalfedgeMesh();
-		int result = mesh->build(polygons, vertices);
-		if (result == 0)
+		else
+		{
+			geometry_version.topology++;
+
+			// build halfedgeMesh
+			if (mesh != nullptr)
+			{
+				delete mesh;
+			}
+			mesh = new HalfedgeMesh();
+			{
+				Misc::ScopedTimer build_timer("halfedge_build");
+				result = mesh->buildFast(polygons, vertices);
+			}
+			if (result == 0)
+			{
+				__reset_stencils();
+				__catmull_clark(*mesh);
+				logger->info("HalfedgeMesh building succeeded.");
+			}
+		}
+
+		if (result != 0)
 		{
-			if (previous_shader_method == mesh_faces_no_indices || previous_shader_method == mesh_wireframe_no_indices)
+			if (mesh != nullptr)
+			{
+				delete mesh;
+				mesh = nullptr;
+			}
+			stencils.clear();
+			logger->warn("HalfedgeMesh building failed, using polygons instead.");
+		}
+		show_generated(result == 0);
+	}
+
+	void BMesh::show_generated(bool has_mesh)
+	{
+		if (shader_method != not_ready)
+		{
+			previous_shader_method = shader_method;
+		}
+
+		if (has_mesh)
+		{
+			if (previous_shader_method == mesh_faces_no_indices || previous_shader_method == mesh_wireframe_no_indices ||
+				previous_shader_method == mesh_faces_indices)
 			{
 				shader_method = previous_shader_method;
+			} else if (previous_shader_method == polygons_indices) {
+				shader_method = mesh_faces_indices;
 			} else {
 				shader_method = mesh_faces_no_indices;
 			}
-			__catmull_clark(*mesh);
-			logger->info("HalfedgeMesh building succeeded.");
 		}
 		else
 		{
+			if (previous_shader_method == mesh_faces_indices || previous_shader_method == polygons_indices)
+			{
+				shader_method = polygons_indices;
+			}
+			else
+			{
+				shader_method = polygons_no_indices;
+			}
+		}
+	}
+
+	void BMesh::__update_surface_bvh()
+	{
+		if (surface_valid && surface_topology == geometry_version.topology &&
+			surface_positions == geometry_version.positions)
+		{
+			return;
+		}
+
+		// Vertices by pool slot, like the indexed mesh draws
+		vector<Vector3D> positions;
+		if (mesh != nullptr)
+		{
+			for (VertexIter v = mesh->verticesBegin(); v != mesh->verticesEnd(); v++)
+			{
+				if (v.index() >= positions.size())
+				{
+					positions.resize(v.index() + 1);
+				}
+				positions[v.index()] = v->position;
+			}
+		}
+
+		if (surface_valid && surface_topology == geometry_version.topology)
+		{
+			surface_bvh.refit(positions);
+		}
+		else
+		{
+			// Faces split into fans of triangles
+			vector<uint32_t> indices;
 			if (mesh != nullptr)
 			{
-				delete mesh;
-				mesh = nullptr;
+				indices.reserve(mesh->nFaces() * 6);
+				for (FaceIter face = mesh->facesBegin(); face != mesh->facesEnd(); face++)
+				{
+					HalfedgeIter h0 = face->halfedge();
+					for (HalfedgeIter h = h0->next(); h->next() != h0; h = h->next())
+					{
+						indices.push_back(h0->vertex().index());
+						indices.push_back(h->vertex().index());
+						indices.push_back(h->next()->vertex().index());
+					}
+				}
 			}
-			shader_method = polygons_no_indices;
-			logger->warn("HalfedgeMesh building failed, using polygons instead.");
+			surface_bvh.build(positions, indices);
 		}
+		surface_topology = geometry_version.topology;
+		surface_positions = geometry_version.positions;
+		surface_valid = true;
 	}
 
 	void BMesh::print_skeleton()
@@ -1529,12 +2117,9 @@ namespace Balle
 
 	void BMesh::__print_skeleton(SkeletalNode *root)
 	{
-		if (!root)
-			return;
-		logger->info("print_skeleton: Current node radius " + to_string(root->radius));
-		for (SkeletalNode *child : *(root->children))
+		for (SkeletalNode *node : all_nodes.preorder(root))
 		{
-			__print_skeleton(child);
+			logger->info("print_skeleton: Current node radius " + to_string(node->radius));
 		}
 	}
 }; // END_NAMESPACE BALLE
\ No newline at end of file
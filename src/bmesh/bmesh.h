@@ -3,17 +3,25 @@
 
 #include <vector>
 #include <unordered_set>
-#include <nanogui/nanogui.h>
+#include <unordered_map>
 
-#include "../misc/sphere_drawing.h"
+#include "../misc/thread_pool.h"
+#include "../misc/point_grid.h"
+#include "../misc/vertex_welder.h"
+#include "../misc/profiler.h"
+#include "../misc/sphere_bvh.h"
+#include "../misc/triangle_bvh.h"
 #include "CGL/CGL.h"
 #include "../mesh/halfEdgeMesh.h"
+#include "../mesh/stencilTable.h"
 #include "skeletalNode.h"
+#include "skeleton.h"
+#include "skeleton_file.h"
 #include "primitives.h"
+#include "quickhull.h"
 #include "../json.hpp"
 #include "../logger.h"
 using namespace std;
-using namespace nanogui;
 using namespace CGL;
 using json = nlohmann::json;
 
@@ -25,6 +33,8 @@ namespace Balle
 		mesh_faces_no_indices,
 		polygons_wirefame_no_indices,
 		mesh_wireframe_no_indices,
+		polygons_indices,
+		mesh_faces_indices,
 		not_ready
 	};
 
@@ -41,8 +51,10 @@ namespace Balle
 		/******************************
 		 * Constructor/Destructor     *
 		 ******************************/
-		BMesh(Logger* logger);
-		~BMesh() = default;
+		// num_threads as for set_num_threads(), so a BMesh that only needs
+		// one thread never starts a pool per hardware thread
+		BMesh(Logger* logger, size_t num_threads = 0);
+		~BMesh();
 
 		/******************************
 		 * Main Feature Function      *
@@ -50,12 +62,17 @@ namespace Balle
 		void clear_mesh();
 		void rebuild();
 		void generate_bmesh();
+		void update_bmesh();
 		void subdivision();
 		void remesh();
-		void remesh_flip() { __remesh_flip(*mesh); };
-		void remesh_collapse() { __remesh_collapse(*mesh); };
-		void remesh_split() { __remesh_split(*mesh); };
-		void remesh_average() { __remesh_average(*mesh); };
+		void remesh_flip() { stencils.clear(); __remesh_flip(*mesh); geometry_version.topology++; };
+		void remesh_collapse() { stencils.clear(); __remesh_collapse(*mesh); geometry_version.topology++; };
+		void remesh_split() { stencils.clear(); __remesh_split(*mesh); geometry_version.topology++; };
+		void remesh_average() { stencils.clear(); __remesh_average(*mesh); geometry_version.topology++; };
+
+		// Worker threads used by subdivision (0 = one per hardware thread)
+		void set_num_threads(size_t num_threads) { thread_pool.set_num_threads(num_threads); };
+		size_t get_num_threads() const { return thread_pool.num_threads(); };
 
 		/******************************
 		 * Structual Manipulation     *
@@ -66,28 +83,74 @@ namespace Balle
 		SkeletalNode* create_skeletal_node_after(SkeletalNode* parent);
 
 		void interpolate_spheres();
+		// Nodes were edited without interpolating again (e.g. an undone grab)
+		void skeleton_changed() { geometry_version.skeleton++; };
 		bool delete_node(SkeletalNode* node);
-		unordered_set<SkeletalNode*> get_all_node();
+		const Skeleton& get_all_node() const { return all_nodes; };
 
-		void export_to_file(const string& filename);
+		bool export_to_file(const string& filename);
+		double get_weld_epsilon() const { return weld_epsilon; };
 		void save_to_file(const string& filename);
 		bool load_from_file(const string& filename);
+		bool load_from_json(const json& j);
+
+		// The skeleton as the user placed it, e.g. to build the mesh on
+		// another thread
+		void snapshot_skeleton(SkeletonSnapshot& snapshot) const;
+		void load_snapshot(const SkeletonSnapshot& snapshot);
+		// Moves and resizes the nodes to match a snapshot of the same tree,
+		// marking the ones that changed dirty; false if the trees differ
+		bool update_from_snapshot(const SkeletonSnapshot& snapshot);
 
 		/******************************
-		 * Rendering Functions        *
+		 * Generated Geometry         *
 		 ******************************/
-		void draw_skeleton(GLShader& shader);
-		void draw_polygon_faces(GLShader& shader);
-		void draw_mesh_faces(GLShader& shader);
-		void draw_polygon_wireframe(GLShader& shader);
-		void draw_mesh_wireframe(GLShader& shader);
+		// Read-only views for whoever draws or writes the result; BMesh itself
+		// never touches GL
+		SkeletalNode* get_root() const { return root; };
+		HalfedgeMesh* get_mesh() const { return mesh; };
+		const vector<vector<size_t>>& get_polygons() const { return polygons; };
+		const vector<Vector3D>& get_vertices() const { return vertices; };
+		const vector<Triangle>& get_triangles() const { return triangles; };
+		const vector<Quadrangle>& get_quadrangles() const { return quadrangles; };
+
+		// Changes whenever the generated geometry does, see GeometryVersion
+		const GeometryVersion& get_geometry_version() const { return geometry_version; };
+
+		// Display mode for freshly generated geometry: the mesh if it was
+		// built, the polygons otherwise, keeping the faces/wireframe/indexed
+		// choice of whatever was shown before
+		void show_generated(bool has_mesh);
+
+		// Every node under the root, parents before children
+		const vector<SkeletalNode*>& get_skeleton_order() const { return all_nodes.preorder(root); };
+
+		/******************************
+		 * Picking                    *
+		 ******************************/
+		// The sphere the ray origin + t * direction enters first, nullptr if
+		// it misses them all
+		SkeletalNode* pick(const Vector3D& origin, const Vector3D& direction);
+
+		// Where the ray origin + t * direction first hits the generated
+		// surface, false if it misses it (or there is no mesh)
+		bool pick_surface(const Vector3D& origin, const Vector3D& direction, Vector3D& hit);
+
+		// Distance from p to the generated surface and the point of it nearest
+		// to p, -1 if there is no mesh
+		double closest_surface_point(const Vector3D& p, Vector3D& closest);
+
+		// The tree behind both, brought up to date with the mesh first
+		const Misc::TriangleBVH& get_surface_bvh();
 
 		/******************************
 		 * Animation (Shake it!)      *
 		 ******************************/
 		void shake();
 		void tick();
-		void shake_nodes_position();
+		// Moves the leaves along their bones; true if the skeleton changed
+		// and the mesh needs generating again
+		bool shake_nodes_position();
 
 		/******************************
 		 * Debugging Function         *
@@ -100,25 +163,40 @@ namespace Balle
 		 * Structual Manipulation     *
 		 ******************************/
 		void __interpspheres_helper(SkeletalNode* root, int divs);
+		void __interpolate_node(SkeletalNode* root, int divs);
 		void __delete_interpolation_helper(SkeletalNode* root);
 		void __skeleton_to_json(json& j);
+		void __real_nodes(vector<SkeletalNode*>& nodes, vector<int32_t>& parent) const;
 		bool __json_to_skeleton(const json& j);
+		bool __skeleton_to_binary(const string& filename);
+		bool __binary_to_skeleton(const MappedSkeleton& skeleton);
 		void __avada_kedavra();
 		void __reroot(SkeletalNode* target, SkeletalNode* parent);
+		void __reinterpolate_helper(SkeletalNode* root);
+		void __reinterpolate_node(SkeletalNode* root);
+		void __topology_changed();
 
 		/******************************
 		 * Sweeping and stitching     *
 		 ******************************/
 		void __joint_iterate(SkeletalNode* root);
+		void __sweep_joint(SkeletalNode* root);
 		void __joint_iterate_limbs(SkeletalNode* root);
 		void __update_limb(SkeletalNode* root, SkeletalNode* child, bool add_root, Limb* limbmesh, bool isleaf);
-		void __add_limb_faces(SkeletalNode* root);
+		void __add_limb_faces(SkeletalNode* root, JointPatch* patch, qh_arena_t* arena);
+		bool __sweep_dirty(SkeletalNode* root);
+		void __build_joint_hulls();
+		void __splice_patch(const JointPatch* patch);
+		void __clear_patches();
 		void __stitch_faces();
+		void __clear_sweep();
 
 		/******************************
 		 * Catmull-Clark              *
 		 ******************************/
 		void __catmull_clark(HalfedgeMesh& mesh);
+		void __reset_stencils();
+		bool __reevaluate_mesh();
 		//void __remesh(HalfedgeMesh& mesh);
 
 		void __remesh_split(HalfedgeMesh& mesh);
@@ -126,6 +204,11 @@ namespace Balle
 		void __remesh_flip(HalfedgeMesh& mesh);
 		void __remesh_average(HalfedgeMesh& mesh);
 
+		/******************************
+		 * Picking                    *
+		 ******************************/
+		void __update_surface_bvh();
+
 		/******************************
 		 * Debugging                  *
 		 ******************************/
@@ -142,7 +225,7 @@ namespace Balle
 	private:
 		// Root of the tree structured skeletal nodes
 		SkeletalNode* root = nullptr;
-		unordered_set<SkeletalNode*> all_nodes;
+		Skeleton all_nodes;
 
 		// Generated Halfedge Mesh
 		HalfedgeMesh* mesh = nullptr;
@@ -157,10 +240,52 @@ namespace Balle
 		vector<Vector3D> all_points;
 		unordered_set<Vector3D> unique_extra_points;
 
+		// Stitched (and exported) vertices closer than this on every axis are
+		// welded into one
+		double weld_epsilon = 1e-9;
+
+		// Incremental sweeping: the interpolated spheres are updated in place as
+		// long as the tree keeps its shape, and every joint node keeps its patch
+		bool interpolation_valid = false;
+		unordered_map<SkeletalNode*, JointPatch*> patches;
+		vector<SkeletalNode*> joint_order; // joints in the order their patches are spliced
+		vector<qh_arena_t> hull_arenas;    // quickhull scratch, one per worker thread
+
+		// Picking: rebuilt when the tree changes, refit when nodes only moved
+		Misc::SphereBVH sphere_bvh;
+		vector<SkeletalNode*> bvh_nodes; // sphere index -> node
+		unsigned long long bvh_topology = 0;
+		unsigned long long bvh_skeleton = 0;
+		bool bvh_valid = false;
+
+		// Surface queries: rebuilt when the faces change, refit when only the
+		// vertices moved
+		Misc::TriangleBVH surface_bvh;
+		unsigned long long surface_topology = 0;
+		unsigned long long surface_positions = 0;
+		bool surface_valid = false;
+
 		// Animation
 		unsigned long long ts = 0ULL;
+
+		// Parallel subdivision
+		Misc::ThreadPool thread_pool;
+
+		// Stencils from `vertices` to the (subdivided) mesh, valid as long as
+		// stitching keeps producing `stencil_polygons`
+		StencilTable stencils;
+		vector<vector<size_t>> stencil_polygons;
+		size_t max_stencil_entries = 1 << 24;
+
+		// Renderers keep their uploaded geometry until `geometry_version`
+		// moves on
+		GeometryVersion geometry_version;
 		
 		Logger *logger;
 	}; // END_STRUCT BMESH
+
+	// Writes a generated mesh as OBJ, welding vertices closer than
+	// weld_epsilon on every axis; false if the file could not be written
+	bool write_obj(const HalfedgeMesh& mesh, const string& filename, double weld_epsilon);
 };	   // END_NAMESPACE BALLE
 #endif
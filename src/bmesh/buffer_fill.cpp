@@ -0,0 +1,116 @@
+#include "buffer_fill.h"
+
+#include <algorithm>
+
+namespace Balle
+{
+    size_t fill_mesh_faces(HalfedgeMesh *mesh, Eigen::MatrixXf &positions, Eigen::MatrixXf &normals)
+    {
+        positions.resize(3, mesh->nFaces() * 6);
+        normals.resize(3, mesh->nFaces() * 6);
+
+        int ind = 0;
+        for (auto face = mesh->facesBegin(); face != mesh->facesEnd(); face++)
+        {
+            Vector3D normal = face->normal();
+
+            int deg = face->degree();
+            if (deg == 3)
+            {
+                Vector3D v0 = face->halfedge()->vertex()->position;
+                Vector3D v1 = face->halfedge()->next()->vertex()->position;
+                Vector3D v2 = face->halfedge()->next()->next()->vertex()->position;
+
+                positions.col(ind * 3) << v0.x, v0.y, v0.z;
+                positions.col(ind * 3 + 1) << v1.x, v1.y, v1.z;
+                positions.col(ind * 3 + 2) << v2.x, v2.y, v2.z;
+
+                normals.col(ind * 3) << normal.x, normal.y, normal.z;
+                normals.col(ind * 3 + 1) << normal.x, normal.y, normal.z;
+                normals.col(ind * 3 + 2) << normal.x, normal.y, normal.z;
+
+                ind += 1;
+            }
+            else if (deg == 4)
+            {
+                Vector3D v0 = face->halfedge()->vertex()->position;
+                Vector3D v1 = face->halfedge()->next()->vertex()->position;
+                Vector3D v2 = face->halfedge()->next()->next()->vertex()->position;
+                Vector3D v3 = face->halfedge()->next()->next()->next()->vertex()->position;
+
+                positions.col(ind * 3) << v0.x, v0.y, v0.z;
+                positions.col(ind * 3 + 1) << v1.x, v1.y, v1.z;
+                positions.col(ind * 3 + 2) << v2.x, v2.y, v2.z;
+
+                normals.col(ind * 3) << normal.x, normal.y, normal.z;
+                normals.col(ind * 3 + 1) << normal.x, normal.y, normal.z;
+                normals.col(ind * 3 + 2) << normal.x, normal.y, normal.z;
+
+                ind += 1;
+
+                positions.col(ind * 3) << v2.x, v2.y, v2.z;
+                positions.col(ind * 3 + 1) << v3.x, v3.y, v3.z;
+                positions.col(ind * 3 + 2) << v0.x, v0.y, v0.z;
+
+                normals.col(ind * 3) << normal.x, normal.y, normal.z;
+                normals.col(ind * 3 + 1) << normal.x, normal.y, normal.z;
+                normals.col(ind * 3 + 2) << normal.x, normal.y, normal.z;
+
+                ind += 1;
+            }
+        }
+        return ind * 3;
+    }
+
+    size_t fill_mesh_vertices(HalfedgeMesh *mesh, bool smooth, Eigen::MatrixXf &positions, Eigen::MatrixXf &normals)
+    {
+        // Vertices go by their pool slot, a mesh with holes just leaves a few
+        // unused columns
+        size_t slots = 0;
+        for (auto v = mesh->verticesBegin(); v != mesh->verticesEnd(); v++)
+        {
+            slots = max(slots, (size_t)v.index() + 1);
+        }
+
+        positions = Eigen::MatrixXf::Zero(3, slots);
+        normals = Eigen::MatrixXf::Zero(3, slots);
+        for (auto v = mesh->verticesBegin(); v != mesh->verticesEnd(); v++)
+        {
+            Vector3D normal = smooth ? v->normal() : v->halfedge()->face()->normal();
+
+            positions.col(v.index()) << v->position.x, v->position.y, v->position.z;
+            normals.col(v.index()) << normal.x, normal.y, normal.z;
+        }
+        return slots;
+    }
+
+    void fill_mesh_face_indices(HalfedgeMesh *mesh, vector<uint32_t> &indices)
+    {
+        indices.clear();
+        indices.reserve(mesh->nFaces() * 6);
+        for (auto face = mesh->facesBegin(); face != mesh->facesEnd(); face++)
+        {
+            HalfedgeIter h0 = face->halfedge();
+            HalfedgeIter h = h0->next();
+            while (h->next() != h0)
+            {
+                indices.push_back(h0->vertex().index());
+                indices.push_back(h->vertex().index());
+                indices.push_back(h->next()->vertex().index());
+                h = h->next();
+            }
+        }
+    }
+
+    void fill_mesh_edge_indices(HalfedgeMesh *mesh, vector<uint32_t> &indices)
+    {
+        indices.clear();
+        indices.reserve(mesh->nEdges() * 2);
+        for (EdgeIter e = mesh->edgesBegin(); e != mesh->edgesEnd(); e++)
+        {
+            indices.push_back(e->halfedge()->vertex().index());
+            indices.push_back(e->halfedge()->twin()->vertex().index());
+        }
+    }
+
+}; // END_NAMESPACE BALLE
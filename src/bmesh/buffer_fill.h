@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include <Eigen/Core>
+#include "../mesh/halfEdgeMesh.h"
+
+using namespace std;
+using namespace CGL;
+namespace Balle
+{
+    // CPU side of the mesh draws: vertex arrays as the renderer uploads them.
+    // Kept free of GL so they can be timed and tested without a context.
+
+    // Three vertices per triangle, quads split in two, every vertex with the
+    // normal of its face. Returns the number of vertices written.
+    size_t fill_mesh_faces(HalfedgeMesh *mesh, Eigen::MatrixXf &positions, Eigen::MatrixXf &normals);
+
+    // One column per vertex pool slot, so indices are stable across position
+    // updates. Returns the number of columns.
+    size_t fill_mesh_vertices(HalfedgeMesh *mesh, bool smooth, Eigen::MatrixXf &positions, Eigen::MatrixXf &normals);
+
+    // Fan triangulation of every face over the slots of fill_mesh_vertices
+    void fill_mesh_face_indices(HalfedgeMesh *mesh, vector<uint32_t> &indices);
+
+    // Two slots per edge, for lines over the same vertices
+    void fill_mesh_edge_indices(HalfedgeMesh *mesh, vector<uint32_t> &indices);
+
+}; // END_NAMESPACE BALLE
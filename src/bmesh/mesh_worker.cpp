@@ -0,0 +1,228 @@
+#include "mesh_worker.h"
+
+#include <algorithm>
+
+namespace Balle
+{
+	MeshWorker::MeshWorker() : newest(0), builder(&quiet)
+	{
+		// Whoever shows the result reports on it
+		quiet.verbose = false;
+		worker = thread(&MeshWorker::__run, this);
+	}
+
+	MeshWorker::~MeshWorker()
+	{
+		{
+			lock_guard<mutex> lock(state_mutex);
+			quitting = true;
+			newest++;
+		}
+		job_ready.notify_one();
+		worker.join();
+	}
+
+	unsigned long long MeshWorker::submit(const SkeletonSnapshot &skeleton, const vector<MeshOperation> &operations, size_t num_threads)
+	{
+		if (skeleton.size() == 0)
+		{
+			return 0;
+		}
+
+		unsigned long long id;
+		{
+			lock_guard<mutex> lock(state_mutex);
+			id = ++newest;
+			pending.id = id;
+			pending.skeleton = skeleton;
+			pending.operations = operations;
+			pending.num_threads = num_threads;
+			has_pending = true;
+		}
+		job_ready.notify_one();
+		return id;
+	}
+
+	void MeshWorker::cancel()
+	{
+		lock_guard<mutex> lock(state_mutex);
+		newest++;
+		has_pending = false;
+		published.reset();
+		// Nothing submitted before stays shown
+		published_id = newest;
+	}
+
+	shared_ptr<const GeneratedMesh> MeshWorker::latest() const
+	{
+		lock_guard<mutex> lock(state_mutex);
+		return published;
+	}
+
+	bool MeshWorker::busy() const
+	{
+		lock_guard<mutex> lock(state_mutex);
+		return has_pending || running;
+	}
+
+	void MeshWorker::__run()
+	{
+		unique_lock<mutex> lock(state_mutex);
+		while (true)
+		{
+			job_ready.wait(lock, [this]
+						   { return quitting || has_pending; });
+			if (quitting)
+			{
+				return;
+			}
+			Job job = move(pending);
+			has_pending = false;
+			running = true;
+
+			lock.unlock();
+			try
+			{
+				__build(job);
+			}
+			catch (const exception &e)
+			{
+				__fail(job, e.what());
+			}
+			lock.lock();
+
+			running = false;
+		}
+	}
+
+	void MeshWorker::__build(const Job &job)
+	{
+		Misc::ScopedTimer timer("mesh_job");
+		size_t num_threads = job.num_threads != 0 ? job.num_threads : max(1u, thread::hardware_concurrency());
+		if (builder.get_num_threads() != num_threads)
+		{
+			builder.set_num_threads(num_threads);
+		}
+
+		if (!built || job.skeleton != built_skeleton)
+		{
+			unsigned long long topology = builder.get_geometry_version().topology;
+			if (built && job.skeleton.same_tree(built_skeleton))
+			{
+				// Same tree: only the moved nodes are swept again, and as long as
+				// the polygons still match the mesh keeps its operations
+				builder.update_from_snapshot(job.skeleton);
+				builder.update_bmesh();
+			}
+			else
+			{
+				builder.load_snapshot(job.skeleton);
+				builder.clear_mesh();
+				builder.generate_bmesh();
+			}
+			if (builder.get_mesh() == nullptr || builder.get_geometry_version().topology != topology)
+			{
+				built_operations.clear();
+			}
+			built_skeleton = job.skeleton;
+			built = true;
+			last_result.reset();
+		}
+
+		// Anything but more of the same starts over from the stitched polygons
+		bool extends = built_operations.size() <= job.operations.size() &&
+					   equal(built_operations.begin(), built_operations.end(), job.operations.begin());
+		if (!extends && builder.get_mesh() != nullptr)
+		{
+			if (__stale(job.id))
+			{
+				return;
+			}
+			builder.rebuild();
+			built_operations.clear();
+			last_result.reset();
+		}
+
+		if (builder.get_mesh() != nullptr)
+		{
+			for (size_t i = built_operations.size(); i < job.operations.size(); i++)
+			{
+				if (__stale(job.id))
+				{
+					return;
+				}
+				__apply(job.operations[i]);
+				built_operations.push_back(job.operations[i]);
+				last_result.reset();
+			}
+		}
+
+		// Every step is done: even if a newer job is waiting, this result is
+		// the freshest there is, which matters while every frame submits one
+		if (last_result == nullptr)
+		{
+			// A copy, so the next job can go on with the builder's mesh
+			shared_ptr<GeneratedMesh> result = make_shared<GeneratedMesh>();
+			if (builder.get_mesh() != nullptr)
+			{
+				result->mesh.reset(new HalfedgeMesh(*builder.get_mesh()));
+				result->surface = builder.get_surface_bvh();
+			}
+			result->polygons = builder.get_polygons();
+			result->vertices = builder.get_vertices();
+			result->triangles = builder.get_triangles();
+			result->quadrangles = builder.get_quadrangles();
+			result->version = builder.get_geometry_version();
+			last_result = result;
+		}
+		__publish(job, last_result);
+	}
+
+	void MeshWorker::__fail(const Job &job, const string &error)
+	{
+		// Whatever the builder was halfway through, the next job loads its
+		// skeleton again
+		built = false;
+		built_operations.clear();
+		last_result.reset();
+
+		shared_ptr<GeneratedMesh> result = make_shared<GeneratedMesh>();
+		result->error = error;
+		__publish(job, result);
+	}
+
+	void MeshWorker::__publish(const Job &job, const shared_ptr<const GeneratedMesh> &result)
+	{
+		lock_guard<mutex> lock(state_mutex);
+		if (job.id > published_id)
+		{
+			published = result;
+			published_id = job.id;
+		}
+	}
+
+	void MeshWorker::__apply(MeshOperation operation)
+	{
+		switch (operation)
+		{
+		case MeshOperation::subdivide:
+			builder.subdivision();
+			break;
+		case MeshOperation::remesh:
+			builder.remesh();
+			break;
+		case MeshOperation::remesh_split:
+			builder.remesh_split();
+			break;
+		case MeshOperation::remesh_collapse:
+			builder.remesh_collapse();
+			break;
+		case MeshOperation::remesh_flip:
+			builder.remesh_flip();
+			break;
+		case MeshOperation::remesh_average:
+			builder.remesh_average();
+			break;
+		}
+	}
+}; // END_NAMESPACE BALLE
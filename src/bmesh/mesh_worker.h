@@ -0,0 +1,122 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "bmesh.h"
+
+using namespace std;
+using namespace CGL;
+
+namespace Balle
+{
+	// Steps applied to the stitched mesh, in the order they were asked for
+	enum class MeshOperation
+	{
+		subdivide,
+		remesh,
+		remesh_split,
+		remesh_collapse,
+		remesh_flip,
+		remesh_average
+	};
+
+	/**
+	 * What a job produced, never changed once published: the stitched
+	 * polygons and, unless they failed to stitch into a halfedge mesh, a copy
+	 * of that mesh with every operation applied.
+	 */
+	struct GeneratedMesh
+	{
+		unique_ptr<HalfedgeMesh> mesh;
+		vector<vector<size_t>> polygons;
+		vector<Vector3D> vertices;
+		vector<Triangle> triangles;
+		vector<Quadrangle> quadrangles;
+
+		// Why the job threw instead of building a mesh; nothing else is set
+		string error;
+
+		// Counted by the worker's BMesh, so that consecutive results with the
+		// same faces keep the renderer's index buffers
+		GeometryVersion version;
+
+		// Over the copied mesh, for picking on the surface
+		Misc::TriangleBVH surface;
+	};
+
+	/**
+	 * Builds meshes on a thread of its own, so that editing the skeleton never
+	 * waits for the sweep or the subdivision.
+	 *
+	 * submit() hands over a snapshot of the skeleton and returns at once. Only
+	 * the newest job matters: one that has not started is replaced, and one
+	 * that is running stops at its next step. Sweeping, stitching and each
+	 * operation run to completion once started, and a job that got through
+	 * all of its steps is published unless a later one already was. A job that
+	 * throws publishes a result holding only the error, and the next job
+	 * starts from scratch.
+	 *
+	 * The worker keeps its BMesh between jobs: moving nodes of the same tree
+	 * only sweeps their patches again, and asking for one more subdivision
+	 * only runs that one.
+	 */
+	class MeshWorker
+	{
+	public:
+		MeshWorker();
+		~MeshWorker();
+
+		// Returns the id of the job, which supersedes every earlier one; an
+		// empty skeleton has nothing to build and is turned down with 0
+		unsigned long long submit(const SkeletonSnapshot& skeleton, const vector<MeshOperation>& operations, size_t num_threads);
+		// Drops the submitted jobs and the last result
+		void cancel();
+
+		// The result of the newest finished job, nullptr if there is none
+		shared_ptr<const GeneratedMesh> latest() const;
+		// A job is queued or running
+		bool busy() const;
+
+	private:
+		struct Job
+		{
+			unsigned long long id = 0;
+			SkeletonSnapshot skeleton;
+			vector<MeshOperation> operations;
+			size_t num_threads = 0;
+		};
+
+		void __run();
+		void __build(const Job& job);
+		void __fail(const Job& job, const string& error);
+		void __publish(const Job& job, const shared_ptr<const GeneratedMesh>& result);
+		void __apply(MeshOperation operation);
+		bool __stale(unsigned long long id) const { return id != newest; };
+
+		mutable mutex state_mutex; // guards everything up to `newest`
+		condition_variable job_ready;
+		Job pending;
+		bool has_pending = false;
+		bool running = false;
+		bool quitting = false;
+		shared_ptr<const GeneratedMesh> published;
+		unsigned long long published_id = 0; // raised by cancel() too
+		atomic<unsigned long long> newest;
+
+		// Only touched by the worker thread
+		Logger quiet; // before the builder, which logs to it
+		BMesh builder;
+		SkeletonSnapshot built_skeleton;
+		vector<MeshOperation> built_operations;
+		bool built = false;
+		// A copy of what the builder holds, dropped as soon as it moves on
+		shared_ptr<const GeneratedMesh> last_result;
+
+		// Started last, once everything it reads exists
+		thread worker;
+	};
+}; // END_NAMESPACE BALLE
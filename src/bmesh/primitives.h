@@ -7,6 +7,16 @@ using namespace CGL;
 
 namespace Balle
 {
+	// Bumped by BMesh whenever the generated geometry changes: `topology` when
+	// the faces themselves may differ, `positions` when only vertices moved,
+	// `skeleton` when any node moved or the tree changed
+	struct GeometryVersion
+	{
+		unsigned long long topology = 0;
+		unsigned long long positions = 0;
+		unsigned long long skeleton = 0;
+	};
+
 	struct Triangle
 	{
 	public:
@@ -87,4 +97,45 @@ namespace Balle
 			return {points[0], points[1], points[2], points[3]};
 		}
 	};
+
+	// Everything one joint node contributes to the sweep: the limbs swept towards
+	// its children and the faces of its hull. Kept between sweeps so that joints
+	// whose neighbourhood did not change are spliced back in as they are.
+	struct JointPatch
+	{
+	public:
+		vector<Limb *> limbs;
+		vector<Triangle> triangles;
+		vector<Quadrangle> quadrangles;
+		vector<Vector3D> fringe_points;
+		vector<Vector3D> all_points;
+
+		// Last four points of the parent limb the hull is built with, and
+		// whether the hull needs to be built again
+		vector<Vector3D> parent_fringe;
+		bool hull_dirty = true;
+
+		JointPatch() = default;
+		~JointPatch()
+		{
+			clear_limbs();
+		}
+
+		void clear_limbs()
+		{
+			for (Limb *limb : limbs)
+			{
+				delete limb;
+			}
+			limbs.clear();
+		}
+
+		void clear_hull()
+		{
+			triangles.clear();
+			quadrangles.clear();
+			fringe_points.clear();
+			all_points.clear();
+		}
+	};
 }; // END_NAMESPACE BALLE
\ No newline at end of file
@@ -47,6 +47,8 @@
 #ifndef QUICKHULL_H
 #define QUICKHULL_H
 
+#include <stddef.h> // size_t
+
 // ------------------------------------------------------------------------------------------------
 // QUICKHULL PUBLIC API
 //
@@ -74,8 +76,40 @@ typedef struct qh_mesh {
     unsigned int nnormals;
 } qh_mesh_t;
 
+// Caller-owned scratch memory for qh_quickhull3d_arena. Allocations are
+// bump allocated and only released all at once by qh_arena_reset, so that a
+// warm arena builds hulls without touching malloc. When an allocation does not
+// fit, an overflow block is chained in; the next reset merges all blocks into
+// one block large enough for everything used since the previous reset.
+typedef struct qh_arena_block {
+    struct qh_arena_block* next;
+    size_t capacity;
+    size_t used;
+} qh_arena_block_t;
+
+typedef struct qh_arena {
+    qh_arena_block_t* blocks;   // current block first
+    size_t used;                // bytes handed out since the last reset
+    size_t peak;                // largest `used` ever seen
+    size_t capacity;            // bytes owned by the arena
+} qh_arena_t;
+
+void qh_arena_init(qh_arena_t* arena);
+
+void qh_arena_free(qh_arena_t* arena);
+
+// Invalidates everything allocated from the arena, including hull meshes.
+void qh_arena_reset(qh_arena_t* arena);
+
+void* qh_arena_alloc(qh_arena_t* arena, size_t size);
+
 qh_mesh_t qh_quickhull3d(qh_vertex_t const* vertices, unsigned int nvertices);
 
+// Same as qh_quickhull3d, but all memory, including the returned mesh, comes
+// from arena. The mesh stays valid until the next qh_arena_reset and must not
+// be passed to qh_free_mesh.
+qh_mesh_t qh_quickhull3d_arena(qh_vertex_t const* vertices, unsigned int nvertices, qh_arena_t* arena);
+
 void qh_mesh_export(qh_mesh_t const* mesh, char const* filename);
 
 void qh_free_mesh(qh_mesh_t mesh);
@@ -166,6 +200,7 @@ typedef struct qh_context {
     unsigned int nedges;
     unsigned int nvertices;
     unsigned int nfaces;
+    qh_arena_t* arena;          // NULL: use QH_MALLOC/QH_FREE
 
     #ifdef QUICKHULL_DEBUG
     unsigned int maxfaces;
@@ -173,6 +208,104 @@ typedef struct qh_context {
     #endif
 } qh_context_t;
 
+#define QH_ARENA_ALIGN 16
+#define QH_ARENA_HEADER ((sizeof(qh_arena_block_t) + QH_ARENA_ALIGN - 1) & ~(size_t)(QH_ARENA_ALIGN - 1))
+#define QH_ARENA_MIN_BLOCK 4096
+
+void qh_arena_init(qh_arena_t* arena)
+{
+    arena->blocks = NULL;
+    arena->used = 0;
+    arena->peak = 0;
+    arena->capacity = 0;
+}
+
+void qh_arena_free(qh_arena_t* arena)
+{
+    qh_arena_block_t* block = arena->blocks;
+    while (block) {
+        qh_arena_block_t* next = block->next;
+        QH_FREE(block);
+        block = next;
+    }
+    qh_arena_init(arena);
+}
+
+qh_arena_block_t* qh__arena_new_block(size_t capacity)
+{
+    qh_arena_block_t* block = (qh_arena_block_t*) QH_MALLOC(char, QH_ARENA_HEADER + capacity);
+    block->next = NULL;
+    block->capacity = capacity;
+    block->used = 0;
+    return block;
+}
+
+void qh_arena_reset(qh_arena_t* arena)
+{
+    if (arena->blocks && arena->blocks->next) {
+        // Overflowed since the last reset: replace the chain by one block
+        size_t peak = arena->peak;
+        qh_arena_free(arena);
+        arena->peak = peak;
+        arena->blocks = qh__arena_new_block(peak);
+        arena->capacity = peak;
+    }
+    if (arena->blocks) {
+        arena->blocks->used = 0;
+    }
+    arena->used = 0;
+}
+
+void* qh_arena_alloc(qh_arena_t* arena, size_t size)
+{
+    qh_arena_block_t* block = arena->blocks;
+    size = (size + QH_ARENA_ALIGN - 1) & ~(size_t)(QH_ARENA_ALIGN - 1);
+
+    if (!block || block->used + size > block->capacity) {
+        size_t capacity = arena->capacity > size ? arena->capacity : size;
+        if (capacity < QH_ARENA_MIN_BLOCK) {
+            capacity = QH_ARENA_MIN_BLOCK;
+        }
+        block = qh__arena_new_block(capacity);
+        block->next = arena->blocks;
+        arena->blocks = block;
+        arena->capacity += capacity;
+    }
+
+    void* p = (char*) block + QH_ARENA_HEADER + block->used;
+    block->used += size;
+    arena->used += size;
+    if (arena->used > arena->peak) {
+        arena->peak = arena->used;
+    }
+    return p;
+}
+
+void* qh__alloc(qh_context_t* context, size_t size)
+{
+    if (context->arena) {
+        return qh_arena_alloc(context->arena, size);
+    }
+    return QH_MALLOC(char, size);
+}
+
+void* qh__realloc(qh_context_t* context, void* p, size_t oldsize, size_t size)
+{
+    if (context->arena) {
+        void* q = qh_arena_alloc(context->arena, size);
+        memcpy(q, p, oldsize < size ? oldsize : size);
+        return q;
+    }
+    return QH_REALLOC(char, p, size);
+}
+
+void qh__free(qh_context_t* context, void* p)
+{
+    if (!context->arena) {
+        QH_FREE(p);
+    }
+}
+
 void qh__find_6eps(qh_vertex_t* vertices, unsigned int nvertices, qh_index_t* eps)
 {
     qh_vertex_t* ptr = vertices;
@@ -444,7 +577,7 @@ void qh__face_init(qh_face_t* face, qh_index_t vertices[3], qh_context_t* contex
     face->centroid = centroid;
     face->sdist = qh__vec3_dot(&normal, &centroid);
     face->normal = normal;
-    face->iset.indices = QH_MALLOC(qh_index_t, QH_VERTEX_SET_SIZE);
+    face->iset.indices = (qh_index_t*) qh__alloc(context, sizeof(qh_index_t) * QH_VERTEX_SET_SIZE);
     face->iset.capacity = QH_VERTEX_SET_SIZE;
     face->iset.size = 0;
     face->visitededges = 0;
@@ -897,8 +1030,8 @@ void qh__build_hull(qh_context_t* context, float epsilon)
                     if (dface) {
                         if (dface->iset.size + 1 >= dface->iset.capacity) {
                             dface->iset.capacity *= 2;
-                            dface->iset.indices = QH_REALLOC(qh_index_t,
-                                dface->iset.indices, dface->iset.capacity);
+                            dface->iset.indices = (qh_index_t*) qh__realloc(context, dface->iset.indices,
+                                sizeof(qh_index_t) * dface->iset.capacity / 2, sizeof(qh_index_t) * dface->iset.capacity);
                         }
 
                         dface->iset.indices[dface->iset.size++] = vertex;
@@ -1110,8 +1243,8 @@ qh_face_t* qh__build_tetrahedron(qh_context_t* context, float epsilon)
 
                 if (dface->iset.size + 1 >= dface->iset.capacity) {
                     dface->iset.capacity *= 2;
-                    dface->iset.indices = QH_REALLOC(qh_index_t,
-                        dface->iset.indices, dface->iset.capacity);
+                    dface->iset.indices = (qh_index_t*) qh__realloc(context, dface->iset.indices,
+                        sizeof(qh_index_t) * dface->iset.capacity / 2, sizeof(qh_index_t) * dface->iset.capacity);
                 }
 
                 dface->iset.indices[dface->iset.size++] = i;
@@ -1160,7 +1293,7 @@ void qh__remove_vertex_duplicates(qh_context_t* context, float epsilon)
     }
 }
 
-void qh__init_context(qh_context_t* context, qh_vertex_t const* vertices, unsigned int nvertices)
+void qh__init_context(qh_context_t* context, qh_vertex_t const* vertices, unsigned int nvertices, qh_arena_t* arena)
 {
     // TODO:
     // size_t nedges = 3 * nvertices - 6;
@@ -1168,15 +1301,16 @@ void qh__init_context(qh_context_t* context, qh_vertex_t const* vertices, unsign
     unsigned int nfaces = nvertices * (nvertices - 1);
     unsigned int nedges = nfaces * 3;
 
-    context->edges = QH_MALLOC(qh_half_edge_t, nedges);
-    context->faces = QH_MALLOC(qh_face_t, nfaces);
-    context->facestack.begin = QH_MALLOC(qh_index_t, nfaces);
-    context->scratch.begin = QH_MALLOC(qh_index_t, nfaces);
-    context->horizonedges.begin = QH_MALLOC(qh_index_t, nedges);
-    context->newhorizonedges.begin = QH_MALLOC(qh_index_t, nedges);
-    context->valid = QH_MALLOC(char, nfaces);
+    context->arena = arena;
+    context->edges = (qh_half_edge_t*) qh__alloc(context, sizeof(qh_half_edge_t) * nedges);
+    context->faces = (qh_face_t*) qh__alloc(context, sizeof(qh_face_t) * nfaces);
+    context->facestack.begin = (qh_index_t*) qh__alloc(context, sizeof(qh_index_t) * nfaces);
+    context->scratch.begin = (qh_index_t*) qh__alloc(context, sizeof(qh_index_t) * nfaces);
+    context->horizonedges.begin = (qh_index_t*) qh__alloc(context, sizeof(qh_index_t) * nedges);
+    context->newhorizonedges.begin = (qh_index_t*) qh__alloc(context, sizeof(qh_index_t) * nedges);
+    context->valid = (char*) qh__alloc(context, sizeof(char) * nfaces);
 
-    context->vertices = QH_MALLOC(qh_vertex_t, nvertices);
+    context->vertices = (qh_vertex_t*) qh__alloc(context, sizeof(qh_vertex_t) * nvertices);
     memcpy(context->vertices, vertices, sizeof(qh_vertex_t) * nvertices);
 
     context->nvertices = nvertices;
@@ -1198,22 +1332,22 @@ void qh__free_context(qh_context_t* context)
     int i;
 
     for (i = 0; i < context->nfaces; ++i) {
-        QH_FREE(context->faces[i].iset.indices);
+        qh__free(context, context->faces[i].iset.indices);
         context->faces[i].iset.size = 0;
     }
 
     context->nvertices = 0;
     context->nfaces = 0;
 
-    QH_FREE(context->edges);
+    qh__free(context, context->edges);
 
-    QH_FREE(context->faces);
-    QH_FREE(context->facestack.begin);
-    QH_FREE(context->scratch.begin);
-    QH_FREE(context->horizonedges.begin);
-    QH_FREE(context->newhorizonedges.begin);
-    QH_FREE(context->vertices);
-    QH_FREE(context->valid);
+    qh__free(context, context->faces);
+    qh__free(context, context->facestack.begin);
+    qh__free(context, context->scratch.begin);
+    qh__free(context, context->horizonedges.begin);
+    qh__free(context, context->newhorizonedges.begin);
+    qh__free(context, context->vertices);
+    qh__free(context, context->valid);
 }
 
 void qh_free_mesh(qh_mesh_t mesh)
@@ -1250,6 +1384,11 @@ float qh__compute_epsilon(qh_vertex_t const* vertices, unsigned int nvertices)
 }
 
 qh_mesh_t qh_quickhull3d(qh_vertex_t const* vertices, unsigned int nvertices)
+{
+    return qh_quickhull3d_arena(vertices, nvertices, NULL);
+}
+
+qh_mesh_t qh_quickhull3d_arena(qh_vertex_t const* vertices, unsigned int nvertices, qh_arena_t* arena)
 {
     qh_mesh_t m;
     qh_context_t context;
@@ -1259,7 +1398,7 @@ qh_mesh_t qh_quickhull3d(qh_vertex_t const* vertices, unsigned int nvertices)
 
     epsilon = qh__compute_epsilon(vertices, nvertices);
 
-    qh__init_context(&context, vertices, nvertices);
+    qh__init_context(&context, vertices, nvertices, arena);
 
     qh__remove_vertex_duplicates(&context, epsilon);
 
@@ -1281,10 +1420,10 @@ qh_mesh_t qh_quickhull3d(qh_vertex_t const* vertices, unsigned int nvertices)
 
     nindices = nfaces * 3;
 
-    m.normals = QH_MALLOC(qh_vertex_t, nfaces);
-    m.normalindices = QH_MALLOC(unsigned int, nfaces);
-    m.vertices = QH_MALLOC(qh_vertex_t, nindices);
-    m.indices = QH_MALLOC(unsigned int, nindices);
+    m.normals = (qh_vertex_t*) qh__alloc(&context, sizeof(qh_vertex_t) * nfaces);
+    m.normalindices = (unsigned int*) qh__alloc(&context, sizeof(unsigned int) * nfaces);
+    m.vertices = (qh_vertex_t*) qh__alloc(&context, sizeof(qh_vertex_t) * nindices);
+    m.indices = (unsigned int*) qh__alloc(&context, sizeof(unsigned int) * nindices);
     m.nindices = nindices;
     m.nnormals = nfaces;
     m.nvertices = 0;
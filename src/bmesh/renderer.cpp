@@ -2,35 +2,67 @@
 
 namespace Balle
 {
-    void Renderer::draw_skeleton(GLShader &shader, SkeletalNode *root)
+    Renderer::~Renderer()
     {
-        // enable sphere rendering
-        int numlinks = __get_num_bones(root);
-
-        MatrixXf positions(4, numlinks * 2);
-        MatrixXf normals(4, numlinks * 2);
+        free_buffers();
+    }
 
-        for (int i = 0; i < numlinks; i++)
+    void GeometryBuffers::free()
+    {
+        if (position_buffer != 0)
+        {
+            glDeleteBuffers(1, &position_buffer);
+        }
+        if (normal_buffer != 0)
+        {
+            glDeleteBuffers(1, &normal_buffer);
+        }
+        if (index_buffer != 0)
         {
-            normals.col(i * 2) << 0., 0., 0., 0.0;
-            normals.col(i * 2 + 1) << 0., 0., 0., 0.0;
+            glDeleteBuffers(1, &index_buffer);
         }
+        position_buffer = 0;
+        normal_buffer = 0;
+        index_buffer = 0;
+        positions.resize(0, 0);
+        normals.resize(0, 0);
+        count = 0;
+        index_count = 0;
+        valid = false;
+    }
 
-        int si = 0;
-        __fill_position(positions, root, si);
+    void Renderer::free_buffers()
+    {
+        polygon_faces_buffers.free();
+        mesh_faces_buffers.free();
+        polygon_wireframe_buffers.free();
+        polygon_indexed_buffers.free();
+        mesh_vertex_buffers.free();
+        mesh_edge_buffers.free();
+        bone_buffers.free();
+    }
 
+    void Renderer::draw_skeleton(GLShader &shader, const vector<SkeletalNode *> &skeleton, const GeometryVersion &version)
+    {
+        // enable sphere rendering
         shader.setUniform("u_balls", true, false);
-        shader.uploadAttrib("in_position", positions, false);
-        shader.uploadAttrib("in_normal", normals, false);
+        __draw_skeleton_lines(shader, skeleton, version);
 
-        shader.drawArray(GL_LINES, 0, numlinks * 2);
-
-        Misc::SphereMesh msm;
-        __draw_skeletal_spheres(shader, msm, root);
+        __draw_skeletal_spheres(shader, skeleton);
+        __flush_spheres(shader, true);
     }
 
-    void Renderer::draw_polygon_faces(GLShader &shader, vector<Quadrangle> &quadrangles, vector<Triangle> &triangles, vector<vector<size_t>> &polygons, vector<Vector3D> &vertices)
+    void Renderer::draw_polygon_faces(GLShader &shader, const vector<Quadrangle> &quadrangles, const vector<Triangle> &triangles, const vector<vector<size_t>> &polygons, const vector<Vector3D> &vertices, const GeometryVersion &version)
     {
+        if (polygon_faces_buffers.is_current(version))
+        {
+            shader.setUniform("u_balls", false, false);
+            __bind(shader, polygon_faces_buffers);
+            shader.drawArray(GL_TRIANGLES, 0, polygon_faces_buffers.count);
+            return;
+        }
+        Misc::ScopedTimer timer("buffer_fill");
+
         MatrixXf mesh_positions(3, triangles.size() * 3 + quadrangles.size() * 6);
         MatrixXf mesh_normals(3, triangles.size() * 3 + quadrangles.size() * 6);
 
@@ -89,76 +121,168 @@ namespace Balle
         size_t actual_triangles_to_draw = ind * 3;
         ind = 0;
 
+        __upload(polygon_faces_buffers, mesh_positions, mesh_normals, actual_triangles_to_draw, version);
+
         shader.setUniform("u_balls", false, false);
-        shader.uploadAttrib("in_normal", mesh_normals);
-        shader.uploadAttrib("in_position", mesh_positions);
+        __bind(shader, polygon_faces_buffers);
         shader.drawArray(GL_TRIANGLES, 0, actual_triangles_to_draw);
     }
 
-    void Renderer::draw_mesh_faces(GLShader &shader, HalfedgeMesh *mesh)
+    void Renderer::draw_mesh_faces(GLShader &shader, HalfedgeMesh *mesh, const GeometryVersion &version)
     {
-        MatrixXf mesh_positions(3, mesh->nFaces() * 6);
-        MatrixXf mesh_normals(3, mesh->nFaces() * 6);
+        if (mesh_faces_buffers.is_current(version))
+        {
+            shader.setUniform("u_balls", false, false);
+            __bind(shader, mesh_faces_buffers);
+            shader.drawArray(GL_TRIANGLES, 0, mesh_faces_buffers.count);
+            return;
+        }
+        Misc::ScopedTimer timer("buffer_fill");
 
-        int ind = 0;
-        for (auto face = mesh->facesBegin(); face != mesh->facesEnd(); face++)
+        MatrixXf mesh_positions;
+        MatrixXf mesh_normals;
+        size_t count = fill_mesh_faces(mesh, mesh_positions, mesh_normals);
+
+        __upload(mesh_faces_buffers, mesh_positions, mesh_normals, count, version);
+
+        shader.setUniform("u_balls", false, false);
+        __bind(shader, mesh_faces_buffers);
+        shader.drawArray(GL_TRIANGLES, 0, count);
+    }
+
+    void Renderer::draw_polygon_faces_indexed(GLShader &shader, const vector<vector<size_t>> &polygons, const vector<Vector3D> &vertices, const GeometryVersion &version, bool smooth)
+    {
+        GeometryBuffers &buffers = polygon_indexed_buffers;
+        if (buffers.is_current(version) && buffers.smooth == smooth)
         {
-            Vector3D normal = face->normal();
+            __draw_indexed(shader, buffers);
+            return;
+        }
+        Misc::ScopedTimer timer("buffer_fill");
+
+        MatrixXf mesh_positions(3, vertices.size());
+        MatrixXf mesh_normals = MatrixXf::Zero(3, vertices.size());
+        vector<uint32_t> indices;
+        bool topology_changed = !buffers.valid || buffers.version.topology != version.topology;
 
-            int deg = face->degree();
-            if (deg == 3)
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            mesh_positions.col(i) << vertices[i].x, vertices[i].y, vertices[i].z;
+        }
+
+        vector<bool> has_normal(smooth ? 0 : vertices.size(), false);
+        for (const vector<size_t> &polygon : polygons)
+        {
+            if (polygon.size() < 3)
             {
-                Vector3D v0 = face->halfedge()->vertex()->position;
-                Vector3D v1 = face->halfedge()->next()->vertex()->position;
-                Vector3D v2 = face->halfedge()->next()->next()->vertex()->position;
+                continue;
+            }
 
-                mesh_positions.col(ind * 3) << v0.x, v0.y, v0.z;
-                mesh_positions.col(ind * 3 + 1) << v1.x, v1.y, v1.z;
-                mesh_positions.col(ind * 3 + 2) << v2.x, v2.y, v2.z;
+            // The unnormalized sum weighs the faces by their area
+            Vector3D normal(0, 0, 0);
+            for (size_t i = 0; i < polygon.size(); i++)
+            {
+                normal += cross(vertices[polygon[i]], vertices[polygon[(i + 1) % polygon.size()]]);
+            }
+            if (!smooth)
+            {
+                normal = normal.unit();
+            }
 
-                mesh_normals.col(ind * 3) << normal.x, normal.y, normal.z;
-                mesh_normals.col(ind * 3 + 1) << normal.x, normal.y, normal.z;
-                mesh_normals.col(ind * 3 + 2) << normal.x, normal.y, normal.z;
+            for (size_t i = 0; i < polygon.size(); i++)
+            {
+                size_t v = polygon[i];
+                if (smooth)
+                {
+                    mesh_normals.col(v) += Vector3f(normal.x, normal.y, normal.z);
+                }
+                else if (!has_normal[v])
+                {
+                    mesh_normals.col(v) << normal.x, normal.y, normal.z;
+                    has_normal[v] = true;
+                }
+            }
 
-                ind += 1;
+            if (topology_changed)
+            {
+                for (size_t i = 1; i + 1 < polygon.size(); i++)
+                {
+                    indices.push_back(polygon[0]);
+                    indices.push_back(polygon[i]);
+                    indices.push_back(polygon[i + 1]);
+                }
             }
-            else if (deg == 4)
+        }
+
+        if (smooth)
+        {
+            for (size_t i = 0; i < vertices.size(); i++)
             {
-                Vector3D v0 = face->halfedge()->vertex()->position;
-                Vector3D v1 = face->halfedge()->next()->vertex()->position;
-                Vector3D v2 = face->halfedge()->next()->next()->vertex()->position;
-                Vector3D v3 = face->halfedge()->next()->next()->next()->vertex()->position;
+                if (mesh_normals.col(i).squaredNorm() > 0)
+                {
+                    mesh_normals.col(i).normalize();
+                }
+            }
+        }
 
-                mesh_positions.col(ind * 3) << v0.x, v0.y, v0.z;
-                mesh_positions.col(ind * 3 + 1) << v1.x, v1.y, v1.z;
-                mesh_positions.col(ind * 3 + 2) << v2.x, v2.y, v2.z;
+        if (topology_changed)
+        {
+            __upload_indices(buffers, indices);
+        }
+        __upload(buffers, mesh_positions, mesh_normals, vertices.size(), version);
+        buffers.smooth = smooth;
 
-                mesh_normals.col(ind * 3) << normal.x, normal.y, normal.z;
-                mesh_normals.col(ind * 3 + 1) << normal.x, normal.y, normal.z;
-                mesh_normals.col(ind * 3 + 2) << normal.x, normal.y, normal.z;
+        __draw_indexed(shader, buffers);
+    }
 
-                ind += 1;
+    void Renderer::draw_mesh_faces_indexed(GLShader &shader, HalfedgeMesh *mesh, const GeometryVersion &version, bool smooth)
+    {
+        __update_mesh_vertices(mesh, version, smooth);
+        __draw_indexed(shader, mesh_vertex_buffers);
+    }
 
-                mesh_positions.col(ind * 3) << v2.x, v2.y, v2.z;
-                mesh_positions.col(ind * 3 + 1) << v3.x, v3.y, v3.z;
-                mesh_positions.col(ind * 3 + 2) << v0.x, v0.y, v0.z;
+    void Renderer::__update_mesh_vertices(HalfedgeMesh *mesh, const GeometryVersion &version, bool smooth)
+    {
+        GeometryBuffers &buffers = mesh_vertex_buffers;
+        if (buffers.is_current(version) && buffers.smooth == smooth)
+        {
+            return;
+        }
+        Misc::ScopedTimer timer("buffer_fill");
 
-                mesh_normals.col(ind * 3) << normal.x, normal.y, normal.z;
-                mesh_normals.col(ind * 3 + 1) << normal.x, normal.y, normal.z;
-                mesh_normals.col(ind * 3 + 2) << normal.x, normal.y, normal.z;
+        MatrixXf mesh_positions;
+        MatrixXf mesh_normals;
+        size_t slots = fill_mesh_vertices(mesh, smooth, mesh_positions, mesh_normals);
 
-                ind += 1;
-            }
+        if (!buffers.valid || buffers.version.topology != version.topology)
+        {
+            vector<uint32_t> indices;
+            fill_mesh_face_indices(mesh, indices);
+            __upload_indices(buffers, indices);
+        }
+        __upload(buffers, mesh_positions, mesh_normals, slots, version);
+        buffers.smooth = smooth;
+    }
+
+    void Renderer::draw_polygon_wireframe(GLShader &shader, const vector<Quadrangle> &quadrangles, const vector<Triangle> &triangles, const vector<SkeletalNode *> &skeleton, const vector<Vector3D> &vertices, const GeometryVersion &version)
+    {
+        if (!polygon_wireframe_buffers.is_current(version))
+        {
+            __fill_polygon_wireframe(quadrangles, triangles, version);
         }
 
         shader.setUniform("u_balls", false, false);
-        shader.uploadAttrib("in_normal", mesh_normals);
-        shader.uploadAttrib("in_position", mesh_positions);
-        shader.drawArray(GL_TRIANGLES, 0, ind * 3);
+        __bind(shader, polygon_wireframe_buffers);
+        shader.drawArray(GL_LINES, 0, polygon_wireframe_buffers.count);
+
+        __draw_skeleton_lines(shader, skeleton, version);
+        __draw_mesh_vertices(shader, vertices);
+        __flush_spheres(shader, false);
     }
 
-    void Renderer::draw_polygon_wireframe(GLShader &shader, vector<Quadrangle> &quadrangles, vector<Triangle> &triangles, SkeletalNode *root, vector<Vector3D> &vertices)
+    void Renderer::__fill_polygon_wireframe(const vector<Quadrangle> &quadrangles, const vector<Triangle> &triangles, const GeometryVersion &version)
     {
+        Misc::ScopedTimer timer("buffer_fill");
         MatrixXf mesh_positions(3, triangles.size() * 6 + quadrangles.size() * 8);
         MatrixXf mesh_normals(3, triangles.size() * 6 + quadrangles.size() * 8);
 
@@ -216,156 +340,265 @@ namespace Balle
             ind += 8;
         }
 
-        shader.uploadAttrib("in_position", mesh_positions, false);
-        shader.uploadAttrib("in_normal", mesh_normals, false);
-        shader.setUniform("u_balls", false, false);
-        shader.drawArray(GL_LINES, 0, triangles.size() * 6 + quadrangles.size() * 8);
-
-        int numlinks = __get_num_bones(root);
+        __upload(polygon_wireframe_buffers, mesh_positions, mesh_normals, ind, version);
+    }
 
-        MatrixXf positions(4, numlinks * 2);
-        MatrixXf normals(4, numlinks * 2);
+    void Renderer::draw_mesh_wireframe(GLShader &shader, HalfedgeMesh *mesh, const vector<SkeletalNode *> &skeleton, const GeometryVersion &version)
+    {
+        // The lines index the same vertex buffer as the indexed faces, only the
+        // edge list has to follow topology changes
+        __update_mesh_vertices(mesh, version, mesh_vertex_buffers.smooth);
 
-        for (int i = 0; i < numlinks; i++)
+        GeometryBuffers &edges = mesh_edge_buffers;
+        if (!edges.valid || edges.version.topology != version.topology)
         {
-            normals.col(i * 2) << 0., 0., 0., 0.0;
-            normals.col(i * 2 + 1) << 0., 0., 0., 0.0;
+            Misc::ScopedTimer timer("buffer_fill");
+            vector<uint32_t> indices;
+            fill_mesh_edge_indices(mesh, indices);
+            __upload_indices(edges, indices);
+            edges.version = version;
+            edges.valid = true;
         }
 
-        int si = 0;
-        __fill_position(positions, root, si);
+        shader.setUniform("u_balls", false, false);
+        __bind_positions(shader, mesh_vertex_buffers.position_buffer, 3, Vector4f(0., 0., 0., 1.));
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, edges.index_buffer);
+        shader.drawIndexed(GL_LINES, 0, edges.index_count / 2);
 
-        shader.uploadAttrib("in_position", positions, false);
-        shader.uploadAttrib("in_normal", normals, false);
+        __draw_skeleton_lines(shader, skeleton, version);
 
-        shader.drawArray(GL_LINES, 0, numlinks * 2);
-        Misc::SphereMesh msm;
-        __draw_mesh_vertices(shader, msm, vertices);
+        __draw_skeletal_spheres(shader, skeleton);
+        __flush_spheres(shader, false);
     }
 
-    void Renderer::draw_mesh_wireframe(GLShader &shader, HalfedgeMesh *mesh, SkeletalNode *root)
+    void Renderer::__draw_skeleton_lines(GLShader &shader, const vector<SkeletalNode *> &skeleton, const GeometryVersion &version)
     {
-        MatrixXf mesh_positions(3, mesh->nEdges() * 2);
-        MatrixXf mesh_normals(3, mesh->nEdges() * 2);
-
-        int ind = 0;
-        for (EdgeIter i = mesh->edgesBegin(); i != mesh->edgesEnd(); i++)
+        GeometryBuffers &bones = bone_buffers;
+        if (!bones.valid || bones.version.skeleton != version.skeleton)
         {
-            // TODO: Fix this for faces
-            Vector3D vertex1 = i->halfedge()->vertex()->position;
-            Vector3D vertex2 = i->halfedge()->next()->vertex()->position;
+            Misc::ScopedTimer timer("buffer_fill");
+            int numlinks = __get_num_bones(skeleton);
 
-            // Vector3D normal = i->face()->normal();
+            MatrixXf positions(4, numlinks * 2);
+            int si = 0;
+            __fill_position(positions, skeleton, si);
 
-            mesh_positions.col(ind) << vertex1.x, vertex1.y, vertex1.z;
-            mesh_positions.col(ind + 1) << vertex2.x, vertex2.y, vertex2.z;
+            if (bones.position_buffer == 0)
+            {
+                glGenBuffers(1, &bones.position_buffer);
+            }
+            size_t bytes = positions.size() * sizeof(float);
+            glBindBuffer(GL_ARRAY_BUFFER, bones.position_buffer);
+            glBufferData(GL_ARRAY_BUFFER, bytes, positions.data(), GL_DYNAMIC_DRAW);
+            uploaded_bytes += bytes;
+
+            bones.count = numlinks * 2;
+            bones.version = version;
+            bones.valid = true;
+        }
 
-            mesh_normals.col(ind) << 0., 0., 0.;
-            mesh_normals.col(ind + 1) << 0., 0., 0.;
+        __bind_positions(shader, bones.position_buffer, 4, Vector4f(0., 0., 0., 0.));
+        shader.drawArray(GL_LINES, 0, bones.count);
+    }
+
+    /******************************
+     * Persistent buffers         *
+     ******************************/
 
-            ind += 2;
+    void Renderer::__upload(GeometryBuffers &buffers, const MatrixXf &positions, const MatrixXf &normals, size_t count, const GeometryVersion &version)
+    {
+        if (buffers.position_buffer == 0)
+        {
+            glGenBuffers(1, &buffers.position_buffer);
+            glGenBuffers(1, &buffers.normal_buffer);
         }
 
-        shader.uploadAttrib("in_position", mesh_positions, false);
-        shader.uploadAttrib("in_normal", mesh_normals, false);
-        shader.setUniform("u_balls", false, false);
-        shader.drawArray(GL_LINES, 0, mesh->nEdges() * 2);
+        if (buffers.valid && buffers.version.topology == version.topology && buffers.count == count)
+        {
+            // Same faces in the same order, only upload the span that moved
+            __upload_changed(buffers.position_buffer, buffers.positions, positions, count);
+            __upload_changed(buffers.normal_buffer, buffers.normals, normals, count);
+        }
+        else
+        {
+            buffers.positions = positions.leftCols(count);
+            buffers.normals = normals.leftCols(count);
+            size_t bytes = count * 3 * sizeof(float);
+
+            glBindBuffer(GL_ARRAY_BUFFER, buffers.position_buffer);
+            glBufferData(GL_ARRAY_BUFFER, bytes, buffers.positions.data(), GL_DYNAMIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, buffers.normal_buffer);
+            glBufferData(GL_ARRAY_BUFFER, bytes, buffers.normals.data(), GL_DYNAMIC_DRAW);
+            uploaded_bytes += 2 * bytes;
+        }
 
-        int numlinks = __get_num_bones(root);
+        buffers.count = count;
+        buffers.version = version;
+        buffers.valid = true;
+    }
 
-        MatrixXf positions(4, numlinks * 2);
-        MatrixXf normals(4, numlinks * 2);
+    void Renderer::__upload_changed(GLuint buffer, MatrixXf &cached, const MatrixXf &fresh, size_t count)
+    {
+        size_t first = 0;
+        while (first < count && cached.col(first) == fresh.col(first))
+        {
+            first++;
+        }
+        if (first == count)
+        {
+            return;
+        }
 
-        for (int i = 0; i < numlinks; i++)
+        size_t last = count - 1;
+        while (last > first && cached.col(last) == fresh.col(last))
         {
-            normals.col(i * 2) << 0., 0., 0., 0.0;
-            normals.col(i * 2 + 1) << 0., 0., 0., 0.0;
+            last--;
         }
-        int si = 0;
-        __fill_position(positions, root, si);
 
-        shader.uploadAttrib("in_position", positions, false);
-        shader.uploadAttrib("in_normal", normals, false);
+        size_t span = last - first + 1;
+        cached.middleCols(first, span) = fresh.middleCols(first, span);
 
-        shader.drawArray(GL_LINES, 0, numlinks * 2);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferSubData(GL_ARRAY_BUFFER, first * 3 * sizeof(float), span * 3 * sizeof(float), cached.col(first).data());
+        uploaded_bytes += span * 3 * sizeof(float);
+    }
+
+    void Renderer::__upload_indices(GeometryBuffers &buffers, const vector<uint32_t> &indices)
+    {
+        if (buffers.index_buffer == 0)
+        {
+            glGenBuffers(1, &buffers.index_buffer);
+        }
 
-        Misc::SphereMesh msm;
-        __draw_skeletal_spheres(shader, msm, root);
+        size_t bytes = indices.size() * sizeof(uint32_t);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.index_buffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, bytes, indices.data(), GL_DYNAMIC_DRAW);
+        uploaded_bytes += bytes;
+        buffers.index_count = indices.size();
     }
 
-    void Renderer::__draw_skeletal_spheres(GLShader &shader, Misc::SphereMesh &msm, SkeletalNode *root)
+    void Renderer::__draw_indexed(GLShader &shader, const GeometryBuffers &buffers)
     {
-        if (root == nullptr)
-            return;
+        shader.setUniform("u_balls", false, false);
+        __bind(shader, buffers);
 
-        nanogui::Color color(0.0f, 1.0f, 1.0f, 1.0f);
+        // The element buffer binding is part of the vertex array state, which
+        // nothing else in the shader touches
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.index_buffer);
+        shader.drawIndexed(GL_TRIANGLES, 0, buffers.index_count / 3);
+    }
 
-        if (root->selected && root->interpolated)
+    void Renderer::__bind_positions(GLShader &shader, GLuint position_buffer, int dim, const Vector4f &normal)
+    {
+        GLint position_id = shader.attrib("in_position", false);
+        if (position_id >= 0)
         {
-            color = nanogui::Color(0.8f, 0.5f, 0.5f, 1.0f);
+            glBindBuffer(GL_ARRAY_BUFFER, position_buffer);
+            glEnableVertexAttribArray(position_id);
+            glVertexAttribPointer(position_id, dim, GL_FLOAT, GL_FALSE, 0, 0);
         }
-        else if (root->selected)
+
+        // Lines share one normal, no need for a buffer full of it
+        GLint normal_id = shader.attrib("in_normal", false);
+        if (normal_id >= 0)
         {
-            color = nanogui::Color(1.0f, 0.0f, 0.0f, 1.0f);
+            glDisableVertexAttribArray(normal_id);
+            glVertexAttrib4f(normal_id, normal[0], normal[1], normal[2], normal[3]);
         }
-        else if (root->interpolated)
+    }
+
+    void Renderer::__bind(GLShader &shader, const GeometryBuffers &buffers)
+    {
+        // Point the shader at our buffers; the next uploadAttrib re-points it
+        // at the shader's own ones
+        GLint position_id = shader.attrib("in_position", false);
+        if (position_id >= 0)
         {
-            color = nanogui::Color(0.6f, 0.6f, 0.6f, 1.0f);
+            glBindBuffer(GL_ARRAY_BUFFER, buffers.position_buffer);
+            glEnableVertexAttribArray(position_id);
+            glVertexAttribPointer(position_id, 3, GL_FLOAT, GL_FALSE, 0, 0);
         }
 
-        msm.draw_sphere(shader, root->pos, root->radius, color);
-
-        for (int i = 0; i < root->children->size(); i++)
+        GLint normal_id = shader.attrib("in_normal", false);
+        if (normal_id >= 0)
         {
-            SkeletalNode *child = root->children->at(i);
-            __draw_skeletal_spheres(shader, msm, child);
+            glBindBuffer(GL_ARRAY_BUFFER, buffers.normal_buffer);
+            glEnableVertexAttribArray(normal_id);
+            glVertexAttribPointer(normal_id, 3, GL_FLOAT, GL_FALSE, 0, 0);
         }
+    }
+
+    void Renderer::__draw_skeletal_spheres(GLShader &shader, const vector<SkeletalNode *> &skeleton)
+    {
+        for (SkeletalNode *node : skeleton)
+        {
+            nanogui::Color color(0.0f, 1.0f, 1.0f, 1.0f);
+
+            if (node->selected && node->interpolated)
+            {
+                color = nanogui::Color(0.8f, 0.5f, 0.5f, 1.0f);
+            }
+            else if (node->selected)
+            {
+                color = nanogui::Color(1.0f, 0.0f, 0.0f, 1.0f);
+            }
+            else if (node->interpolated)
+            {
+                color = nanogui::Color(0.6f, 0.6f, 0.6f, 1.0f);
+            }
 
-        return;
+            __add_sphere(shader, node->pos, node->radius, color);
+        }
     }
 
-    void Renderer::__draw_mesh_vertices(GLShader &shader, Misc::SphereMesh &msm, vector<Vector3D> &vertices)
+    void Renderer::__draw_mesh_vertices(GLShader &shader, const vector<Vector3D> &vertices)
     {
         nanogui::Color color(0.0f, 1.0f, 1.0f, 1.0f);
         for (const Vector3D &vertex : vertices)
         {
-            msm.draw_sphere(shader, vertex, 0.0005, color);
+            __add_sphere(shader, vertex, 0.0005, color);
         }
     }
 
-    void Renderer::__fill_position(MatrixXf &positions, SkeletalNode *root, int &si)
+    void Renderer::__add_sphere(GLShader &shader, const Vector3D &p, double r, nanogui::Color color)
     {
-        if (root == nullptr)
-            return;
-
-        if (root->children->size() == 0)
-            return;
-
-        for (int i = 0; i < root->children->size(); i++)
+        if (sphere_shader == nullptr)
         {
-            SkeletalNode *child = root->children->at(i);
-
-            positions.col(si) << root->pos.x, root->pos.y, root->pos.z, 1.0;
-            positions.col(si + 1) << child->pos.x, child->pos.y, child->pos.z, 1.0;
-            si += 2;
-
-            __fill_position(positions, child, si);
+            sphere_mesh.draw_sphere(shader, p, r, color);
+            return;
         }
+        sphere_instances.add(p, r, color);
     }
 
-    int Renderer::__get_num_bones(SkeletalNode *root)
+    void Renderer::__flush_spheres(GLShader &shader, bool lit)
     {
-        if (root == nullptr)
-            return 0;
+        if (sphere_shader == nullptr || sphere_instances.size() == 0)
+        {
+            return;
+        }
 
-        int size = root->children->size();
+        sphere_shader->bind();
+        sphere_shader->setUniform("u_balls", lit, false);
+        sphere_instances.draw(*sphere_shader);
+        shader.bind();
+    }
 
-        for (int i = 0; i < root->children->size(); i++)
+    void Renderer::__fill_position(MatrixXf &positions, const vector<SkeletalNode *> &skeleton, int &si)
+    {
+        for (SkeletalNode *node : skeleton)
         {
-            SkeletalNode *child = root->children->at(i);
-            size += __get_num_bones(child);
+            for (SkeletalNode *child : node->children)
+            {
+                positions.col(si) << node->pos.x, node->pos.y, node->pos.z, 1.0;
+                positions.col(si + 1) << child->pos.x, child->pos.y, child->pos.z, 1.0;
+                si += 2;
+            }
         }
+    }
 
-        return size;
+    int Renderer::__get_num_bones(const vector<SkeletalNode *> &skeleton)
+    {
+        // One bone per node but the root
+        return skeleton.empty() ? 0 : skeleton.size() - 1;
     }
 }; // END_NAMESPACE BALLE
\ No newline at end of file
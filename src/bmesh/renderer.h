@@ -3,31 +3,94 @@
 #include <vector>
 #include <nanogui/nanogui.h>
 #include "../misc/sphere_drawing.h"
+#include "../misc/profiler.h"
 #include "CGL/CGL.h"
 #include "../mesh/halfEdgeMesh.h"
 #include "skeletalNode.h"
 #include "primitives.h"
+#include "buffer_fill.h"
 
 using namespace std;
 using namespace nanogui;
 using namespace CGL;
 namespace Balle
 {
+    // GPU copy of one draw's vertex arrays, kept alive across frames
+    struct GeometryBuffers
+    {
+        GLuint position_buffer = 0;
+        GLuint normal_buffer = 0;
+        GLuint index_buffer = 0; // indexed draws only
+        MatrixXf positions; // what the buffers currently hold
+        MatrixXf normals;
+        size_t count = 0;
+        size_t index_count = 0;
+        bool smooth = false;
+        bool valid = false;
+        GeometryVersion version;
+
+        bool is_current(const GeometryVersion &v) const
+        {
+            return valid && version.topology == v.topology && version.positions == v.positions;
+        }
+        void free();
+    };
+
     // Rendering Class
     struct Renderer
     {
     public:
-        void draw_skeleton(GLShader &shader, SkeletalNode *root);
-        void draw_polygon_faces(GLShader &shader, vector<Quadrangle> &quadrangles, vector<Triangle> &triangles, vector<vector<size_t>> &polygons, vector<Vector3D> &vertices);
-        void draw_mesh_faces(GLShader &shader, HalfedgeMesh *mesh);
-        void draw_polygon_wireframe(GLShader &shader, vector<Quadrangle> &quadrangles, vector<Triangle> &triangles, SkeletalNode *root, vector<Vector3D> &vertices);
-        void draw_mesh_wireframe(GLShader &shader, HalfedgeMesh *mesh, SkeletalNode *root);
+        ~Renderer();
+
+        void draw_skeleton(GLShader &shader, const vector<SkeletalNode *> &skeleton, const GeometryVersion &version);
+        void draw_polygon_faces(GLShader &shader, const vector<Quadrangle> &quadrangles, const vector<Triangle> &triangles, const vector<vector<size_t>> &polygons, const vector<Vector3D> &vertices, const GeometryVersion &version);
+        void draw_mesh_faces(GLShader &shader, HalfedgeMesh *mesh, const GeometryVersion &version);
+        void draw_polygon_wireframe(GLShader &shader, const vector<Quadrangle> &quadrangles, const vector<Triangle> &triangles, const vector<SkeletalNode *> &skeleton, const vector<Vector3D> &vertices, const GeometryVersion &version);
+        void draw_mesh_wireframe(GLShader &shader, HalfedgeMesh *mesh, const vector<SkeletalNode *> &skeleton, const GeometryVersion &version);
+
+        // One vertex per mesh vertex plus an element buffer. With `smooth` the
+        // normals are averaged over the adjacent faces, otherwise every vertex
+        // takes the normal of a single adjacent face
+        void draw_polygon_faces_indexed(GLShader &shader, const vector<vector<size_t>> &polygons, const vector<Vector3D> &vertices, const GeometryVersion &version, bool smooth);
+        void draw_mesh_faces_indexed(GLShader &shader, HalfedgeMesh *mesh, const GeometryVersion &version, bool smooth);
+
+        // Drop every cached buffer, e.g. before the GL context goes away
+        void free_buffers();
+
+        // Bytes sent with glBufferData / glBufferSubData so far
+        size_t uploaded_bytes = 0;
+
+        // Program for instanced spheres (shaders/instanced); without one every
+        // sphere is drawn on its own through the main shader
+        GLShader *sphere_shader = nullptr;
 
     private:
-        void __fill_position(MatrixXf &positions, SkeletalNode *root, int &si);
-        void __draw_skeletal_spheres(GLShader &shader, Misc::SphereMesh &msm, SkeletalNode *root);
-        void __draw_mesh_vertices(GLShader &shader, Misc::SphereMesh &msm, vector<Vector3D> &vertices);
-        int __get_num_bones(SkeletalNode *root);
+        void __upload(GeometryBuffers &buffers, const MatrixXf &positions, const MatrixXf &normals, size_t count, const GeometryVersion &version);
+        void __upload_changed(GLuint buffer, MatrixXf &cached, const MatrixXf &fresh, size_t count);
+        void __upload_indices(GeometryBuffers &buffers, const vector<uint32_t> &indices);
+        void __draw_indexed(GLShader &shader, const GeometryBuffers &buffers);
+        void __bind(GLShader &shader, const GeometryBuffers &buffers);
+        void __bind_positions(GLShader &shader, GLuint position_buffer, int dim, const Vector4f &normal);
+        void __draw_skeleton_lines(GLShader &shader, const vector<SkeletalNode *> &skeleton, const GeometryVersion &version);
+        void __fill_polygon_wireframe(const vector<Quadrangle> &quadrangles, const vector<Triangle> &triangles, const GeometryVersion &version);
+        void __update_mesh_vertices(HalfedgeMesh *mesh, const GeometryVersion &version, bool smooth);
+        void __fill_position(MatrixXf &positions, const vector<SkeletalNode *> &skeleton, int &si);
+        void __draw_skeletal_spheres(GLShader &shader, const vector<SkeletalNode *> &skeleton);
+        void __draw_mesh_vertices(GLShader &shader, const vector<Vector3D> &vertices);
+        void __add_sphere(GLShader &shader, const Vector3D &p, double r, nanogui::Color color);
+        void __flush_spheres(GLShader &shader, bool lit);
+        int __get_num_bones(const vector<SkeletalNode *> &skeleton);
+
+        GeometryBuffers polygon_faces_buffers;
+        GeometryBuffers mesh_faces_buffers;
+        GeometryBuffers polygon_wireframe_buffers;
+        GeometryBuffers polygon_indexed_buffers;
+        GeometryBuffers mesh_vertex_buffers; // one vertex per mesh vertex, faces in index_buffer
+        GeometryBuffers mesh_edge_buffers;   // only index_buffer, lines over mesh_vertex_buffers
+        GeometryBuffers bone_buffers;        // only position_buffer, rebuilt on skeleton changes
+
+        Misc::SphereMesh sphere_mesh;
+        Misc::SphereInstances sphere_instances;
     };
 
 }; // END_NAMESPACE BALLE
\ No newline at end of file
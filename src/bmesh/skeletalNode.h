@@ -1,6 +1,8 @@
 #pragma once
 
 #include <vector>
+#include <iterator>
+#include <stdint.h>
 #include "CGL/CGL.h"
 #include "../mesh/halfEdgeMesh.h"
 #include "primitives.h"
@@ -10,18 +12,61 @@ using namespace CGL;
 
 namespace Balle
 {
+	struct SkeletalNode;
+
+	// The children of a node, linked through SkeletalNode::next_sibling so that
+	// adding one never allocates. A node is in at most one list at a time.
+	class ChildList
+	{
+	public:
+		class iterator
+		{
+		public:
+			typedef forward_iterator_tag iterator_category;
+			typedef SkeletalNode *value_type;
+			typedef ptrdiff_t difference_type;
+			typedef SkeletalNode *const *pointer;
+			typedef SkeletalNode *reference;
+
+			iterator(SkeletalNode *node) : node(node){};
+			SkeletalNode *operator*() const { return node; };
+			iterator &operator++();
+			bool operator==(const iterator &other) const { return node == other.node; };
+			bool operator!=(const iterator &other) const { return node != other.node; };
+
+		private:
+			SkeletalNode *node;
+		};
+
+		iterator begin() const { return iterator(first); };
+		iterator end() const { return iterator(nullptr); };
+		size_t size() const { return count; };
+		bool empty() const { return count == 0; };
+
+		SkeletalNode *front() const { return first; };
+		SkeletalNode *operator[](size_t index) const;
+
+		void push_back(SkeletalNode *child);
+		// Unlinks the child, the others keep their order
+		void remove(SkeletalNode *child);
+		void clear();
+
+	private:
+		SkeletalNode *first = nullptr;
+		SkeletalNode *last = nullptr;
+		size_t count = 0;
+	};
+
 	// The struct for the tree itself
 	struct SkeletalNode
 	{
 	public:
 		SkeletalNode(Vector3D pos, float radius, SkeletalNode *parent) : pos(pos), equilibrium(pos), radius(radius), parent(parent)
 		{
-			children = new vector<SkeletalNode *>;
 		};
 
-		~SkeletalNode()
-		{
-		}
+		// Slot in the owning Skeleton, stable for the life of the node
+		uint32_t id = 0;
 
 		SkeletalNode *parent;
 
@@ -37,13 +82,78 @@ namespace Balle
 		bool selected = false;
 		bool interpolated = false;
 
+		// Set whenever pos or radius changed since the last sweep, so that
+		// BMesh::generate_bmesh only re-sweeps the limbs and hulls around it
+		bool dirty = true;
+
 		// The children of the ball
 		// Leaf node == end node -> connects to only one bone
 		// connection node if it connects to two bones
 		// joint node -> more than 2 bones
-		vector<SkeletalNode *> *children;
+		ChildList children;
+
+		// Next child of the parent, see ChildList
+		SkeletalNode *next_sibling = nullptr;
 
 		// Limb primitives that surrounds this skeletal node
 		Limb *limb = nullptr;
 	};
-}; // END_NAMESPACE BALLE
\ No newline at end of file
+
+	inline ChildList::iterator &ChildList::iterator::operator++()
+	{
+		node = node->next_sibling;
+		return *this;
+	}
+
+	inline SkeletalNode *ChildList::operator[](size_t index) const
+	{
+		SkeletalNode *node = first;
+		while (index-- > 0)
+		{
+			node = node->next_sibling;
+		}
+		return node;
+	}
+
+	inline void ChildList::push_back(SkeletalNode *child)
+	{
+		child->next_sibling = nullptr;
+		if (last == nullptr)
+		{
+			first = child;
+		}
+		else
+		{
+			last->next_sibling = child;
+		}
+		last = child;
+		count++;
+	}
+
+	inline void ChildList::remove(SkeletalNode *child)
+	{
+		SkeletalNode *prev = nullptr;
+		for (SkeletalNode *node = first; node != nullptr; node = node->next_sibling)
+		{
+			if (node == child)
+			{
+				(prev == nullptr ? first : prev->next_sibling) = node->next_sibling;
+				if (last == node)
+				{
+					last = prev;
+				}
+				node->next_sibling = nullptr;
+				count--;
+				return;
+			}
+			prev = node;
+		}
+	}
+
+	inline void ChildList::clear()
+	{
+		first = nullptr;
+		last = nullptr;
+		count = 0;
+	}
+}; // END_NAMESPACE BALLE
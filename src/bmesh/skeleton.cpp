@@ -0,0 +1,140 @@
+#include "skeleton.h"
+
+#include <new>
+#include <algorithm>
+
+namespace Balle
+{
+	// Blocks are only released here, so that contains() can still read the id
+	// of a destroyed node
+	Skeleton::~Skeleton()
+	{
+		for (SkeletalNode *block : blocks)
+		{
+			::operator delete(block);
+		}
+	}
+
+	SkeletalNode *Skeleton::create(const Vector3D &pos, float radius, SkeletalNode *parent)
+	{
+		uint32_t id;
+		if (!free_ids.empty())
+		{
+			id = free_ids.back();
+			free_ids.pop_back();
+		}
+		else
+		{
+			id = (uint32_t)slots.size();
+			slots.push_back(nullptr);
+			if (id / block_size >= blocks.size())
+			{
+				blocks.push_back((SkeletalNode *)::operator new(block_size * sizeof(SkeletalNode)));
+			}
+		}
+
+		SkeletalNode *node = new (blocks[id / block_size] + id % block_size) SkeletalNode(pos, radius, parent);
+		node->id = id;
+		slots[id] = node;
+		live++;
+		invalidate_order();
+		return node;
+	}
+
+	void Skeleton::destroy(SkeletalNode *node)
+	{
+		if (!contains(node))
+		{
+			return;
+		}
+		slots[node->id] = nullptr;
+		free_ids.push_back(node->id);
+		live--;
+		invalidate_order();
+	}
+
+	void Skeleton::clear()
+	{
+		// Keeps the blocks for the next skeleton
+		slots.clear();
+		free_ids.clear();
+		live = 0;
+		invalidate_order();
+	}
+
+	void Skeleton::reserve(size_t count)
+	{
+		slots.reserve(count);
+		while (blocks.size() * block_size < count)
+		{
+			blocks.push_back((SkeletalNode *)::operator new(block_size * sizeof(SkeletalNode)));
+		}
+	}
+
+	const vector<SkeletalNode *> &Skeleton::preorder(SkeletalNode *root) const
+	{
+		if (preorder_valid && preorder_root == root)
+		{
+			return preorder_nodes;
+		}
+
+		preorder_nodes.clear();
+		preorder_nodes.reserve(live);
+		traversal_stack.clear();
+		if (root != nullptr)
+		{
+			traversal_stack.push_back(root);
+		}
+		while (!traversal_stack.empty())
+		{
+			SkeletalNode *node = traversal_stack.back();
+			traversal_stack.pop_back();
+			preorder_nodes.push_back(node);
+
+			// Pushed reversed so that the first child comes off the stack first
+			size_t first_child = traversal_stack.size();
+			for (SkeletalNode *child : node->children)
+			{
+				traversal_stack.push_back(child);
+			}
+			reverse(traversal_stack.begin() + first_child, traversal_stack.end());
+		}
+
+		preorder_root = root;
+		preorder_valid = true;
+		return preorder_nodes;
+	}
+
+	const vector<SkeletalNode *> &Skeleton::postorder(SkeletalNode *root) const
+	{
+		if (postorder_valid && postorder_root == root)
+		{
+			return postorder_nodes;
+		}
+
+		// A preorder that takes the last child first, reversed
+		postorder_nodes.clear();
+		postorder_nodes.reserve(live);
+		traversal_stack.clear();
+		if (root != nullptr)
+		{
+			traversal_stack.push_back(root);
+		}
+		while (!traversal_stack.empty())
+		{
+			SkeletalNode *node = traversal_stack.back();
+			traversal_stack.pop_back();
+			postorder_nodes.push_back(node);
+
+			for (SkeletalNode *child : node->children)
+			{
+				traversal_stack.push_back(child);
+			}
+		}
+		reverse(postorder_nodes.begin(), postorder_nodes.end());
+
+		postorder_root = root;
+		postorder_valid = true;
+		return postorder_nodes;
+	}
+}; // END_NAMESPACE BALLE
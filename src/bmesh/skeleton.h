@@ -0,0 +1,135 @@
+#pragma once
+
+#include <vector>
+#include <iterator>
+#include <stdint.h>
+#include "skeletalNode.h"
+
+using namespace std;
+using namespace CGL;
+
+namespace Balle
+{
+	/**
+	 * Owns the skeletal nodes of a BMesh. Nodes are carved out of fixed-size
+	 * blocks, so creating one is a free-list pop or a bump and never moves the
+	 * others. A node's id is its slot: ids are dense, stable while the node
+	 * lives and reused once it is destroyed.
+	 *
+	 * Iterating visits the live nodes in id order. The tree itself is walked
+	 * through preorder() and postorder(), built with an explicit stack and
+	 * cached, so neither deep chains nor repeated passes cost recursion.
+	 */
+	class Skeleton
+	{
+	public:
+		class iterator
+		{
+		public:
+			typedef forward_iterator_tag iterator_category;
+			typedef SkeletalNode *value_type;
+			typedef ptrdiff_t difference_type;
+			typedef SkeletalNode *const *pointer;
+			typedef SkeletalNode *reference;
+
+			iterator(const SkeletalNode *const *slot, const SkeletalNode *const *end) : slot(slot), end(end) { __skip(); };
+			SkeletalNode *operator*() const { return const_cast<SkeletalNode *>(*slot); };
+			iterator &operator++()
+			{
+				slot++;
+				__skip();
+				return *this;
+			};
+			bool operator==(const iterator &other) const { return slot == other.slot; };
+			bool operator!=(const iterator &other) const { return slot != other.slot; };
+
+		private:
+			void __skip()
+			{
+				while (slot != end && *slot == nullptr)
+				{
+					slot++;
+				}
+			};
+
+			const SkeletalNode *const *slot;
+			const SkeletalNode *const *end;
+		};
+
+		Skeleton() = default;
+		~Skeleton();
+		Skeleton(const Skeleton &) = delete;
+		Skeleton &operator=(const Skeleton &) = delete;
+
+		// Does not link the node into the children of its parent
+		SkeletalNode *create(const Vector3D &pos, float radius, SkeletalNode *parent);
+		void destroy(SkeletalNode *node);
+		void clear();
+		void reserve(size_t count);
+
+		bool contains(const SkeletalNode *node) const { return node->id < slots.size() && slots[node->id] == node; };
+
+		// The live node with this id, nullptr if there is none
+		SkeletalNode *at(uint32_t id) const { return id < slots.size() ? slots[id] : nullptr; };
+
+		size_t size() const { return live; };
+		bool empty() const { return live == 0; };
+
+		// One past the largest id handed out, for arrays indexed by id
+		size_t id_bound() const { return slots.size(); };
+
+		// The nodes under `root` depth first, children in order: every node
+		// before its children, or after them. Valid until the next create(),
+		// destroy() or invalidate_order(), the last one being needed after
+		// relinking nodes without adding or removing any.
+		const vector<SkeletalNode *> &preorder(SkeletalNode *root) const;
+		const vector<SkeletalNode *> &postorder(SkeletalNode *root) const;
+		void invalidate_order()
+		{
+			preorder_valid = false;
+			postorder_valid = false;
+			topology++;
+		};
+
+		// Changes whenever the orders are invalidated, i.e. on every change of
+		// the tree other than moving or resizing nodes
+		unsigned long long topology_version() const { return topology; };
+
+		iterator begin() const { return iterator((const SkeletalNode *const *)slots.data(), (const SkeletalNode *const *)slots.data() + slots.size()); };
+		iterator end() const { return iterator((const SkeletalNode *const *)slots.data() + slots.size(), (const SkeletalNode *const *)slots.data() + slots.size()); };
+
+	private:
+		static const size_t block_size = 256;
+
+		vector<SkeletalNode *> blocks; // raw storage for block_size nodes each
+		vector<SkeletalNode *> slots;  // id -> node, nullptr once destroyed
+		vector<uint32_t> free_ids;
+		size_t live = 0;
+
+		mutable vector<SkeletalNode *> preorder_nodes;
+		mutable vector<SkeletalNode *> postorder_nodes;
+		mutable SkeletalNode *preorder_root = nullptr;
+		mutable SkeletalNode *postorder_root = nullptr;
+		mutable bool preorder_valid = false;
+		mutable bool postorder_valid = false;
+		mutable vector<SkeletalNode *> traversal_stack;
+		unsigned long long topology = 0;
+	};
+
+	/**
+	 * A copy of the spheres a user placed, without the interpolated ones:
+	 * parents before children, each node's parent by index (-1 for the
+	 * root). Plain data, so it can be handed to another thread.
+	 */
+	struct SkeletonSnapshot
+	{
+		vector<Vector3D> pos;
+		vector<float> radius;
+		vector<int32_t> parent;
+
+		size_t size() const { return pos.size(); };
+		bool same_tree(const SkeletonSnapshot &other) const { return parent == other.parent; };
+		bool operator==(const SkeletonSnapshot &other) const { return parent == other.parent && radius == other.radius && pos == other.pos; };
+		bool operator!=(const SkeletonSnapshot &other) const { return !(*this == other); };
+	};
+}; // END_NAMESPACE BALLE
@@ -0,0 +1,161 @@
+#include "skeleton_file.h"
+
+#include <fstream>
+#include <cstring>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Balle
+{
+	static const char skeleton_magic[4] = {'B', 'S', 'K', 'L'};
+
+	// Bytes of a file with `count` nodes
+	static size_t skeleton_file_size(size_t count)
+	{
+		return sizeof(SkeletonFileHeader) + count * (3 * sizeof(double) + sizeof(float) + sizeof(int32_t));
+	}
+
+	bool is_binary_skeleton(const string &filename)
+	{
+		ifstream file(filename, ios::binary);
+		char magic[4];
+		if (!file.read(magic, sizeof(magic)))
+		{
+			return false;
+		}
+		return memcmp(magic, skeleton_magic, sizeof(magic)) == 0;
+	}
+
+	bool write_binary_skeleton(const string &filename, const vector<double> &x, const vector<double> &y, const vector<double> &z,
+							   const vector<float> &radius, const vector<int32_t> &parent)
+	{
+		ofstream file(filename, ios::binary);
+		if (!file)
+		{
+			return false;
+		}
+
+		SkeletonFileHeader header;
+		memcpy(header.magic, skeleton_magic, sizeof(header.magic));
+		header.version = skeleton_file_version;
+		header.count = (uint32_t)x.size();
+		header.reserved = 0;
+
+		size_t n = x.size();
+		file.write((const char *)&header, sizeof(header));
+		file.write((const char *)x.data(), n * sizeof(double));
+		file.write((const char *)y.data(), n * sizeof(double));
+		file.write((const char *)z.data(), n * sizeof(double));
+		file.write((const char *)radius.data(), n * sizeof(float));
+		file.write((const char *)parent.data(), n * sizeof(int32_t));
+		return (bool)file;
+	}
+
+	bool MappedSkeleton::open(const string &filename)
+	{
+		close();
+
+#ifndef _WIN32
+		int fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			return false;
+		}
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(SkeletonFileHeader))
+		{
+			::close(fd);
+			return false;
+		}
+		void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (mapped == MAP_FAILED)
+		{
+			return false;
+		}
+		data = (const char *)mapped;
+		mapped_length = st.st_size;
+		size_t length = st.st_size;
+#else
+		ifstream file(filename, ios::binary | ios::ate);
+		if (!file)
+		{
+			return false;
+		}
+		size_t length = (size_t)file.tellg();
+		buffer.resize(length);
+		file.seekg(0);
+		if (!file.read(buffer.data(), length))
+		{
+			buffer.clear();
+			return false;
+		}
+		data = buffer.data();
+#endif
+
+		if (!__validate(length))
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	bool MappedSkeleton::__validate(size_t length)
+	{
+		if (length < sizeof(SkeletonFileHeader))
+		{
+			return false;
+		}
+		SkeletonFileHeader header;
+		memcpy(&header, data, sizeof(header));
+		if (memcmp(header.magic, skeleton_magic, sizeof(header.magic)) != 0 ||
+			header.version != skeleton_file_version ||
+			header.count == 0 || length < skeleton_file_size(header.count))
+		{
+			return false;
+		}
+
+		count = header.count;
+		const char *p = data + sizeof(SkeletonFileHeader);
+		x = (const double *)p;
+		y = x + count;
+		z = y + count;
+		radius = (const float *)(z + count);
+		parent = (const int32_t *)(radius + count);
+
+		if (parent[0] != -1)
+		{
+			return false;
+		}
+		for (size_t i = 1; i < count; i++)
+		{
+			if (parent[i] < 0 || (size_t)parent[i] >= i)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void MappedSkeleton::close()
+	{
+#ifndef _WIN32
+		if (mapped_length != 0)
+		{
+			munmap((void *)data, mapped_length);
+		}
+#endif
+		buffer.clear();
+		data = nullptr;
+		mapped_length = 0;
+		count = 0;
+		x = y = z = nullptr;
+		radius = nullptr;
+		parent = nullptr;
+	}
+}; // END_NAMESPACE BALLE
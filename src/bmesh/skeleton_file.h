@@ -0,0 +1,70 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+using namespace std;
+
+namespace Balle
+{
+	/**
+	 * Binary skeleton file (.balleb), the compact sibling of the JSON .balle:
+	 *
+	 *   SkeletonFileHeader
+	 *   double  x[count], y[count], z[count]
+	 *   float   radius[count]
+	 *   int32_t parent[count]
+	 *
+	 * Nodes are stored in depth-first preorder: node 0 is the root (parent -1),
+	 * every other parent has a smaller index, and children keep their order
+	 * when collected by increasing index. Values are in host byte order, which
+	 * is little endian on every platform we build for.
+	 */
+	struct SkeletonFileHeader
+	{
+		char magic[4];	  // "BSKL"
+		uint32_t version; // skeleton_file_version
+		uint32_t count;	  // nodes
+		uint32_t reserved;
+	};
+
+	const uint32_t skeleton_file_version = 1;
+
+	// True if the file starts with a binary skeleton header
+	bool is_binary_skeleton(const string &filename);
+
+	bool write_binary_skeleton(const string &filename, const vector<double> &x, const vector<double> &y, const vector<double> &z,
+							   const vector<float> &radius, const vector<int32_t> &parent);
+
+	// Read-only view of a binary skeleton, mapped into memory where the
+	// platform allows it. The arrays stay valid until close().
+	class MappedSkeleton
+	{
+	public:
+		MappedSkeleton() = default;
+		~MappedSkeleton() { close(); };
+		MappedSkeleton(const MappedSkeleton &) = delete;
+		MappedSkeleton &operator=(const MappedSkeleton &) = delete;
+
+		// Fails on a missing file, another version, a truncated file or a
+		// parent that breaks the preorder
+		bool open(const string &filename);
+		void close();
+
+		size_t size() const { return count; };
+
+		const double *x = nullptr;
+		const double *y = nullptr;
+		const double *z = nullptr;
+		const float *radius = nullptr;
+		const int32_t *parent = nullptr;
+
+	private:
+		bool __validate(size_t length);
+
+		size_t count = 0;
+		const char *data = nullptr;
+		size_t mapped_length = 0; // 0 if `data` points into `buffer`
+		vector<char> buffer;
+	};
+}; // END_NAMESPACE BALLE
@@ -0,0 +1,390 @@
+// Headless driver: .balle skeletons in, OBJ meshes out. Never touches GL, so
+// it runs on machines without a display or GPU.
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include "misc/getopt.h" // getopt for windows
+#else
+#include <getopt.h>
+#include <unistd.h>
+#endif
+
+#include "bmesh/bmesh.h"
+#include "misc/file_utils.h"
+#include "misc/task_pool.h"
+#include "logger.h"
+
+using namespace std;
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options
+{
+	int subdivision_levels = 0;
+	int remesh_iterations = 0;
+	int num_threads = 0;
+	bool quiet = false;
+};
+
+// Timings of one file, in milliseconds
+struct JobResult
+{
+	string input;
+	string output;
+	bool ok = false;
+	string error;
+	size_t faces = 0;
+	double load = 0, generate = 0, subdivide = 0, remesh = 0, write = 0, total = 0;
+};
+
+void usageError(const char* binaryName)
+{
+	printf("Usage: %s [options]\n", binaryName);
+	printf("Input (one of):\n");
+	printf("  -f     <STRING>    Skeleton to load (.balle or .balleb)\n");
+	printf("  -d     <STRING>    Directory, every .balle/.balleb file in it is processed\n");
+	printf("  -l     <STRING>    Manifest, one .balle path per line\n");
+	printf("Optional program options:\n");
+	printf("  -o     <STRING>    Output mesh (.obj), single file only.\n");
+	printf("                     Defaults to the input with an .obj extension.\n");
+	printf("  -O     <STRING>    Output directory for -d and -l.\n");
+	printf("                     Defaults to next to every input. Inputs that\n");
+	printf("                     share a file name fail after the first one.\n");
+	printf("  -s     <INT>       Subdivision levels after generation (default 0).\n");
+	printf("  -m     <INT>       Remesh iterations after subdividing (default 0).\n");
+	printf("  -t     <INT>       Worker threads, 0 for one per core (default 0).\n");
+	printf("                     With -d and -l every file gets one of them.\n");
+	printf("  -q                 Only print errors.\n");
+	printf("\n");
+	exit(-1);
+}
+
+string obj_filename(const string& input, const string& directory)
+{
+	size_t slash = input.find_last_of("/\\");
+	size_t dot = input.rfind('.');
+	string stem = input;
+	if (dot != string::npos && (slash == string::npos || dot > slash))
+	{
+		stem = input.substr(0, dot);
+	}
+	if (directory.empty())
+	{
+		return stem + ".obj";
+	}
+	if (slash != string::npos)
+	{
+		stem = stem.substr(slash + 1);
+	}
+	return directory + "/" + stem + ".obj";
+}
+
+double ms_since(Clock::time_point &start)
+{
+	Clock::time_point now = Clock::now();
+	double ms = std::chrono::duration<double, std::milli>(now - start).count();
+	start = now;
+	return ms;
+}
+
+// Load, generate, subdivide, remesh and export one skeleton
+void run_stages(const Options& options, Logger& logger, JobResult& result)
+{
+	Clock::time_point begin = Clock::now();
+	Clock::time_point start = begin;
+
+	Balle::BMesh bmesh(&logger, options.num_threads);
+
+	try
+	{
+		if (!bmesh.load_from_file(result.input))
+		{
+			result.error = "Could not read " + result.input;
+			return;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		result.error = "Could not parse " + result.input + ": " + e.what();
+		return;
+	}
+	if (bmesh.get_root() == nullptr)
+	{
+		result.error = "Could not build a mesh from " + result.input + ": empty skeleton";
+		return;
+	}
+	result.load = ms_since(start);
+
+	bmesh.generate_bmesh();
+	if (bmesh.get_mesh() == nullptr ||
+		bmesh.shader_method == Balle::Method::polygons_no_indices ||
+		bmesh.shader_method == Balle::Method::polygons_indices)
+	{
+		result.error = "Could not build a mesh from " + result.input;
+		return;
+	}
+	result.generate = ms_since(start);
+
+	for (int i = 0; i < options.subdivision_levels; i++)
+	{
+		bmesh.subdivision();
+	}
+	result.subdivide = ms_since(start);
+
+	for (int i = 0; i < options.remesh_iterations; i++)
+	{
+		bmesh.remesh();
+	}
+	result.remesh = ms_since(start);
+
+	if (!bmesh.export_to_file(result.output))
+	{
+		result.error = "Could not write " + result.output;
+		return;
+	}
+	result.write = ms_since(start);
+
+	result.faces = bmesh.get_mesh()->nFaces();
+	result.total = ms_since(begin);
+	result.ok = true;
+}
+
+// Batch files run on TaskPool workers, which must not let an exception out
+void run_pipeline(const Options& options, Logger& logger, JobResult& result)
+{
+	try
+	{
+		run_stages(options, logger, result);
+	}
+	catch (const std::exception& e)
+	{
+		result.ok = false;
+		result.error = "Could not build a mesh from " + result.input + ": " + e.what();
+	}
+}
+
+bool read_manifest(const string& filename, vector<string>& inputs)
+{
+	ifstream file(filename);
+	if (!file.good())
+	{
+		return false;
+	}
+	string line;
+	while (getline(file, line))
+	{
+		// Tolerate CRLF manifests, blank lines and # comments
+		if (!line.empty() && line.back() == '\r')
+		{
+			line.pop_back();
+		}
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+		inputs.push_back(line);
+	}
+	return true;
+}
+
+bool read_directory(const string& directory, vector<string>& inputs)
+{
+	set<string> files;
+	if (!FileUtils::list_files_in_directory(directory, files))
+	{
+		return false;
+	}
+	for (const string& file : files)
+	{
+		string stem, extension;
+		if (FileUtils::split_filename(file, stem, extension) && (extension == "balle" || extension == "balleb"))
+		{
+			inputs.push_back(directory + "/" + file);
+		}
+	}
+	return true;
+}
+
+void print_result(const JobResult& result)
+{
+	if (!result.ok)
+	{
+		printf("%-40s  FAILED  %s\n", result.input.c_str(), result.error.c_str());
+		return;
+	}
+	printf("%-40s  %8zu faces  load %8.2f  generate %8.2f  subdivide %8.2f  remesh %8.2f  write %8.2f  total %8.2f ms\n",
+		   result.input.c_str(), result.faces, result.load, result.generate,
+		   result.subdivide, result.remesh, result.write, result.total);
+}
+
+// Every file on its own BMesh, one file per worker at a time
+int run_batch(const Options& options, const vector<string>& inputs, const string& output_directory)
+{
+	vector<JobResult> results(inputs.size());
+	map<string, size_t> writers;
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		results[i].input = inputs[i];
+		results[i].output = obj_filename(inputs[i], output_directory);
+
+		// Same stem in two directories under -O: only the first one may
+		// write, rather than two workers writing one file at once
+		map<string, size_t>::iterator writer = writers.find(results[i].output);
+		if (writer != writers.end())
+		{
+			results[i].error = results[i].output + " is already written for " + inputs[writer->second];
+			print_result(results[i]);
+			continue;
+		}
+		writers[results[i].output] = i;
+	}
+
+	// Parallelism comes from running files side by side, not from within one
+	Options file_options = options;
+	file_options.num_threads = 1;
+
+	Clock::time_point begin = Clock::now();
+	mutex print_mutex;
+	size_t workers;
+	size_t steals;
+	{
+		CGL::Misc::TaskPool pool(options.num_threads);
+		workers = pool.num_threads();
+		for (JobResult& result : results)
+		{
+			if (!result.error.empty())
+			{
+				continue;
+			}
+			JobResult* job = &result;
+			pool.submit([&file_options, &print_mutex, job]
+						{
+				Logger logger;
+				logger.verbose = false;
+				run_pipeline(file_options, logger, *job);
+
+				lock_guard<mutex> lock(print_mutex);
+				if (!file_options.quiet || !job->ok)
+				{
+					print_result(*job);
+				} });
+		}
+		pool.wait();
+		steals = pool.steals();
+	}
+	double wall = std::chrono::duration<double>(Clock::now() - begin).count();
+
+	size_t failed = 0;
+	size_t faces = 0;
+	double busy = 0;
+	for (const JobResult& result : results)
+	{
+		if (!result.ok)
+		{
+			failed++;
+			continue;
+		}
+		faces += result.faces;
+		busy += result.total / 1000.0;
+	}
+
+	printf("\n%zu files (%zu failed) on %zu workers in %.3f s: %.1f files/s, %.0f faces/s\n",
+		   results.size(), failed, workers, wall,
+		   wall > 0 ? results.size() / wall : 0.0, wall > 0 ? faces / wall : 0.0);
+	printf("%.3f s of per-file time, %.1f files in flight on average, %zu tasks stolen\n",
+		   busy, wall > 0 ? busy / wall : 0.0, steals);
+
+	return failed == 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+	int c;
+
+	string input;
+	string input_directory;
+	string manifest;
+	string output;
+	string output_directory;
+	Options options;
+
+	while ((c = getopt(argc, argv, "f:d:l:o:O:s:m:t:q")) != -1)
+	{
+		switch (c)
+		{
+		case 'f':
+			input = optarg;
+			break;
+		case 'd':
+			input_directory = optarg;
+			break;
+		case 'l':
+			manifest = optarg;
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		case 'O':
+			output_directory = optarg;
+			break;
+		case 's':
+			options.subdivision_levels = atoi(optarg);
+			break;
+		case 'm':
+			options.remesh_iterations = atoi(optarg);
+			break;
+		case 't':
+			options.num_threads = atoi(optarg);
+			break;
+		case 'q':
+			options.quiet = true;
+			break;
+		default:
+			usageError(argv[0]);
+			break;
+		}
+	}
+
+	int num_inputs = !input.empty() + !input_directory.empty() + !manifest.empty();
+	bool batch = input.empty();
+	if (num_inputs != 1 || (batch && !output.empty()) || options.subdivision_levels < 0 || options.remesh_iterations < 0 || options.num_threads < 0)
+	{
+		usageError(argv[0]);
+	}
+
+	if (batch)
+	{
+		vector<string> inputs;
+		bool listed = manifest.empty() ? read_directory(input_directory, inputs) : read_manifest(manifest, inputs);
+		if (!listed)
+		{
+			cerr << "Could not read " << (manifest.empty() ? input_directory : manifest) << endl;
+			return 1;
+		}
+		return run_batch(options, inputs, output_directory);
+	}
+
+	Logger logger;
+	logger.verbose = !options.quiet;
+
+	JobResult result;
+	result.input = input;
+	result.output = output.empty() ? obj_filename(input, output_directory) : output;
+	run_pipeline(options, logger, result);
+	if (!result.ok)
+	{
+		logger.error(result.error);
+		return 1;
+	}
+	logger.done(input + " -> " + result.output + " in " + to_string(result.total) + " ms");
+
+	return 0;
+}
@@ -1,51 +1,46 @@
 #include "logger.h"
-#include <nanogui/nanogui.h>
 #include <iostream>
 #include <sstream>
-using namespace nanogui;
 using namespace std;
 
-// Warnings
-void Logger::warn(const string &s)
+void Logger::__log(const string &tag, const string &s)
 {
-    cout << "[warning] ";
-    cout << s << endl;
-    
-    if (textbox != nullptr)
+    if (verbose)
+    {
+        cout << tag << " ";
+        cout << s << endl;
+    }
+
+    if (sink)
     {
-        textbox->setValue("[warning] " + s);
+        sink(tag + " " + s);
     }
 }
 
+// Warnings
+void Logger::warn(const string &s)
+{
+    __log("[warning]", s);
+}
+
 // Errors
 void Logger::error(const string &s)
 {
-    cout << "[!!! ERROR !!!] ";
-    cout << s << endl;
-    if (textbox != nullptr)
+    if (!verbose)
     {
-        textbox->setValue("[!!! ERROR !!!]" + s);
+        cerr << "[!!! ERROR !!!] " << s << endl;
     }
+    __log("[!!! ERROR !!!]", s);
 }
 
 // Any general info / debugging
 void Logger::info(const string &s)
 {
-    cout << "[info] ";
-    cout << s << endl;
-    if (textbox != nullptr)
-    {
-        textbox->setValue("[info] " + s);
-    }
+    __log("[info]", s);
 }
 
 // Completed tasks
 void Logger::done(const string &s)
 {
-    cout << "[done] ";
-    cout << s << endl;
-    if (textbox != nullptr)
-    {
-        textbox->setValue("[done] " + s);
-    }
-}
\ No newline at end of file
+    __log("[done]", s);
+}
@@ -3,18 +3,22 @@
 
 #include <iostream>
 #include <sstream>
-#include <nanogui/nanogui.h>
+#include <functional>
 using namespace std;
-using namespace nanogui;
 
 struct Logger
 {
 	/******************************
 	 * Constructor/Destructor     *
 	 ******************************/
-	Logger(TextBox *textbox) : textbox(textbox) {};
+	Logger() = default;
+	Logger(function<void(const string &)> sink) : sink(sink) {};
 	~Logger() = default;
-	TextBox* textbox = nullptr;
+
+	// Receives every tagged message, e.g. the GUI's terminal text box
+	function<void(const string &)> sink;
+	// Echo messages to stdout; when off, errors still reach stderr
+	bool verbose = true;
 	stringstream ss;
 
 	
@@ -29,6 +33,9 @@ struct Logger
 
 	// Completed tasks
 	void done(const string &s);
+
+private:
+	void __log(const string &tag, const string &s);
 };
 
 #endif /* LOGGER_H */
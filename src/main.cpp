@@ -200,6 +200,34 @@ int main(int argc, char** argv)
 	std::string file_to_load_from;
 	bool file_specified = false;
 
+	while ((c = getopt(argc, argv, "f:r:a:o:")) != -1)
+	{
+		switch (c)
+		{
+		case 'f':
+			file_to_load_from = optarg;
+			file_specified = true;
+			break;
+		case 'r':
+			project_root = optarg;
+			if (!is_valid_project_root(project_root))
+			{
+				std::cout << "Warning: Could not find required file \"shaders/Default.vert\" in specified project root: " << project_root << std::endl;
+			}
+			found_project_root = true;
+			break;
+		case 'a':
+			sphere_num_lat = atoi(optarg);
+			break;
+		case 'o':
+			sphere_num_lon = atoi(optarg);
+			break;
+		default:
+			usageError(argv[0]);
+			break;
+		}
+	}
+
 	if (!found_project_root)
 	{
 		std::cout << "Error: Could not find required file \"shaders/Default.vert\" anywhere!" << std::endl;
@@ -216,6 +244,10 @@ int main(int argc, char** argv)
 
 	app = new GUI(project_root, screen);
 	app->init();
+	if (file_specified && !app->load_bmesh_from_file(file_to_load_from))
+	{
+		return -1;
+	}
 
 	// Call this after all the widgets have been defined
 
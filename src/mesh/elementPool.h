@@ -0,0 +1,243 @@
+/*
+ * elementPool.h
+ *
+ * Contiguous storage for the elements of a HalfedgeMesh.
+ */
+
+ /**
+  * An ElementPool keeps mesh elements in a single contiguous array rather than
+  * in the nodes of a linked list.  Elements are referred to by a 32-bit slot
+  * index; a handle (ElementPool::iterator) is nothing more than that index plus
+  * a pointer back to the pool that owns it, so that it can still be
+  * dereferenced like the STL iterators the HalfedgeMesh used to hand out.
+  *
+  * Deleting an element does not move anything: its slot is marked dead (a
+  * "tombstone") and pushed on a free-list, and the next insertion reuses it.
+  * Iteration simply skips dead slots.  Because no element ever moves until
+  * compact() is called, handles stay valid across insertions and deletions of
+  * *other* elements, exactly like list iterators did.  (The one difference is
+  * that raw addresses, i.e., &*h, are not stable: the underlying array may be
+  * reallocated when it grows.  Always hold on to handles, never to pointers.)
+  *
+  * compact() squeezes the tombstones out and returns, for every old slot, the
+  * slot the element moved to (or npos if it was dead).  The owner of the pool
+  * is responsible for rewriting any handles it stores using this table; see
+  * HalfedgeMesh::compact().
+  */
+
+#ifndef CGL_ELEMENTPOOL_H
+#define CGL_ELEMENTPOOL_H
+
+#include <vector>
+#include <cstddef>
+#include <iterator>
+#include <stdint.h>
+#include <type_traits>
+
+namespace CGL
+{
+    template <typename T> class ElementPool;
+
+    /**
+     * Handle to an element of an ElementPool.  IsConst selects between the
+     * mutable and the read-only flavor; a mutable handle converts implicitly
+     * into a read-only one, mirroring list<T>::iterator / const_iterator.
+     */
+    template <typename T, bool IsConst>
+    class PoolIterator
+    {
+    public:
+        typedef typename std::conditional<IsConst, const ElementPool<T>, ElementPool<T> >::type PoolType;
+
+        typedef std::forward_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef typename std::conditional<IsConst, const T*, T*>::type pointer;
+        typedef typename std::conditional<IsConst, const T&, T&>::type reference;
+
+        static const uint32_t npos = 0xffffffffu;
+
+        PoolIterator(void) : _pool(nullptr), _index(npos) {}
+        PoolIterator(PoolType* pool, uint32_t index) : _pool(pool), _index(index) {}
+
+        /**
+         * Mutable-to-const conversion.
+         */
+        template <bool C, typename = typename std::enable_if<IsConst && !C>::type>
+        PoolIterator(const PoolIterator<T, C>& other) : _pool(other.pool()), _index(other.index()) {}
+
+        reference operator*(void) const { return _pool->_data[_index]; }
+        pointer operator->(void) const { return &_pool->_data[_index]; }
+
+        PoolIterator& operator++(void)
+        {
+            _index = _pool->nextAlive(_index + 1);
+            return *this;
+        }
+
+        PoolIterator operator++(int)
+        {
+            PoolIterator tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+
+        /**
+         * Two handles are equal if they name the same slot of the same pool.
+         * Past-the-end handles of a pool compare equal regardless of how they
+         * were obtained, since "end" is just the npos index.
+         */
+        template <bool C>
+        bool operator==(const PoolIterator<T, C>& other) const
+        {
+            return _index == other.index() && (_index == npos || _pool == other.pool());
+        }
+
+        template <bool C>
+        bool operator!=(const PoolIterator<T, C>& other) const
+        {
+            return !(*this == other);
+        }
+
+        uint32_t index(void) const { return _index; } ///< slot of the element in its pool
+        PoolType* pool(void) const { return _pool; } ///< pool that owns the element
+
+    private:
+        PoolType* _pool;
+        uint32_t _index;
+    };
+
+    template <typename T, bool IsConst>
+    const uint32_t PoolIterator<T, IsConst>::npos;
+
+    /**
+     * Some algorithms (e.g., std::map keyed by handles) need to know which of two
+     * handles comes first; we order them by pool and then by slot, which within a
+     * pool agrees with the order of the underlying addresses.
+     */
+    template <typename T, bool C1, bool C2>
+    inline bool operator<(const PoolIterator<T, C1>& i, const PoolIterator<T, C2>& j)
+    {
+        const void* pi = i.pool();
+        const void* pj = j.pool();
+        if (pi != pj) return pi < pj;
+        return i.index() < j.index();
+    }
+
+    template <typename T>
+    class ElementPool
+    {
+    public:
+        typedef PoolIterator<T, false> iterator;
+        typedef PoolIterator<T, true> const_iterator;
+
+        static const uint32_t npos = 0xffffffffu;
+
+        ElementPool(void) : _size(0) {}
+
+        iterator begin(void) { return iterator(this, nextAlive(0)); }
+        iterator end(void) { return iterator(this, npos); }
+        const_iterator begin(void) const { return const_iterator(this, nextAlive(0)); }
+        const_iterator end(void) const { return const_iterator(this, npos); }
+
+        size_t size(void) const { return _size; } ///< number of live elements
+        size_t slots(void) const { return _data.size(); } ///< number of slots, live or dead
+        bool empty(void) const { return _size == 0; }
+        bool isCompact(void) const { return _free.empty(); } ///< true if no slot is dead
+
+        bool alive(uint32_t i) const { return i < _data.size() && _alive[i]; }
+
+        iterator at(uint32_t i) { return iterator(this, i); }
+        const_iterator at(uint32_t i) const { return const_iterator(this, i); }
+
+        void reserve(size_t n)
+        {
+            _data.reserve(n);
+            _alive.reserve(n);
+        }
+
+        void clear(void)
+        {
+            _data.clear();
+            _alive.clear();
+            _free.clear();
+            _size = 0;
+        }
+
+        /**
+         * Stores a copy of value, reusing a dead slot if one is available.
+         */
+        iterator insert(const T& value)
+        {
+            uint32_t i;
+            if (!_free.empty())
+            {
+                i = _free.back();
+                _free.pop_back();
+                _data[i] = value;
+                _alive[i] = 1;
+            }
+            else
+            {
+                i = (uint32_t)_data.size();
+                _data.push_back(value);
+                _alive.push_back(1);
+            }
+            _size++;
+            return iterator(this, i);
+        }
+
+        /**
+         * Kills the element and returns a handle to the next live one.
+         */
+        iterator erase(iterator it)
+        {
+            uint32_t i = it.index();
+            _alive[i] = 0;
+            _free.push_back(i);
+            _size--;
+            return iterator(this, nextAlive(i + 1));
+        }
+
+        /**
+         * Moves all live elements to the front of the array (keeping their
+         * relative order) and fills remap with the new slot of each old slot,
+         * or npos for slots that were dead.
+         */
+        void compact(std::vector<uint32_t>& remap)
+        {
+            remap.assign(_data.size(), npos);
+            uint32_t n = 0;
+            for (uint32_t i = 0; i < _data.size(); i++)
+            {
+                if (!_alive[i]) continue;
+                if (i != n) _data[n] = _data[i];
+                remap[i] = n++;
+            }
+            _data.resize(n);
+            _alive.assign(n, 1);
+            _free.clear();
+        }
+
+    private:
+        template <typename, bool> friend class PoolIterator;
+
+        uint32_t nextAlive(uint32_t i) const
+        {
+            uint32_t n = (uint32_t)_data.size();
+            while (i < n && !_alive[i]) i++;
+            return i < n ? i : npos;
+        }
+
+        std::vector<T> _data;          ///< element storage, indexed by slot
+        std::vector<uint8_t> _alive;   ///< tombstone flags
+        std::vector<uint32_t> _free;   ///< dead slots available for reuse
+        size_t _size;                  ///< number of live elements
+    };
+
+    template <typename T>
+    const uint32_t ElementPool<T>::npos;
+
+} // namespace CGL
+
+#endif // CGL_ELEMENTPOOL_H
@@ -86,10 +86,10 @@ namespace CGL {
         faces.clear();
         boundaries.clear();
 
-        // Since the vertices in our halfedge mesh are stored in a linked list,
-        // we will temporarily need to keep track of the correspondence between
-        // indices of vertices in our input and pointers to vertices in the new
-        // mesh (which otherwise can't be accessed by index).  Note that since
+        // Since the input indices need not match the slots of the vertices in
+        // our halfedge mesh, we will temporarily need to keep track of the
+        // correspondence between indices of vertices in our input and pointers
+        // to vertices in the new mesh.  Note that since
         // we're using a general-purpose map (rather than, say, a vector), we can
         // be a bit more flexible about the indexing scheme: input vertex indices
         // aren't required to be 0-based or 1-based; in fact, the set of indices
@@ -100,7 +100,9 @@ namespace CGL {
 
         // Also store the vertex degree, i.e., the number of polygons that use each
         // vertex; this information will be used to check that the mesh is manifold.
-        map<VertexIter, Size> vertexDegree;
+        // (Vertices are allocated one after the other in an empty pool, so we can
+        // simply index this by the slot of each vertex.)
+        vector<Size> vertexDegree;
 
         // First, we do some basic sanity checks on the input.
         for (PolygonListCIter p = polygons.begin(); p != polygons.end(); p++)
@@ -133,12 +135,12 @@ namespace CGL {
                     VertexIter v = newVertex();
                     v->halfedge() = halfedges.end(); // this vertex doesn't yet point to any halfedge
                     indexToVertex[*i] = v;
-                    vertexDegree[v] = 1; // we've now seen this vertex only once
+                    vertexDegree.push_back(1); // we've now seen this vertex only once
                 }
                 else
                 {
                     // keep track of the number of times we've seen this vertex
-                    vertexDegree[indexToVertex[*i]]++;
+                    vertexDegree[indexToVertex[*i].index()]++;
                 }
 
             } // end loop over polygon vertices
@@ -159,13 +161,13 @@ namespace CGL {
 
         } // end basic sanity checks on input
 
-        // The number of vertices in the mesh is the
-        // number of unique indices seen in the input.
-        Size nVertices = indexToVertex.size();
-
         // The number of faces is just the number of polygons in the input.
         Size nFaces = polygons.size();
-        faces.resize(nFaces); // allocate storage for faces in our new mesh
+        faces.reserve(nFaces); // allocate storage for faces in our new mesh
+        for (Index i = 0; i < nFaces; i++)
+        {
+            newFace();
+        }
 
         // We will store a map from ordered pairs of vertex indices to
         // the corresponding halfedge object in our new (halfedge) mesh;
@@ -259,6 +261,236 @@ namespace CGL {
 
         } // done building basic halfedge connectivity
 
+        // Link up boundary loops and check that the result is manifold.
+        if (linkBoundaries(vertexDegree, true) != 0)
+        {
+            return -1;
+        }
+
+        // Now that we have the connectivity, we copy the list of vertex
+        // positions into member variables of the individual vertices.
+        if (vertexPositions.size() != vertices.size())
+        {
+            cerr << "Error converting polygons to halfedge mesh: number of vertex positions is different from the number of distinct vertices!" << endl;
+            cerr << "(number of positions in input: " << vertexPositions.size() << ")" << endl;
+            cerr << "(  number of vertices in mesh: " << vertices.size() << ")" << endl;
+            return -1;
+        }
+        // Since an STL map internally sorts its keys, we can iterate over the map from vertex indices to
+        // vertex iterators to visit our (input) vertices in lexicographic order
+        int i = 0;
+        for (map<Index, VertexIter>::const_iterator e = indexToVertex.begin(); e != indexToVertex.end(); e++)
+        {
+            // grab a pointer to the vertex associated with the current key (i.e., the current index)
+            VertexIter v = e->second;
+
+            // set the position of this vertex to the corresponding position in the input
+            v->position = vertexPositions[i];
+            i++;
+        }
+        return 0;
+    } // end HalfedgeMesh::build()
+
+    namespace
+    {
+        // Open-addressing hash table from an oriented edge (a, b), packed into a
+        // single 64-bit key, to the slot of the corresponding halfedge.  Sized once
+        // up front for the known number of halfedges, so it never needs to grow.
+        class EdgeTable
+        {
+        public:
+            EdgeTable(Size nHalfedges)
+            {
+                Size capacity = 16;
+                while (capacity < 2 * nHalfedges) capacity *= 2;
+                _mask = capacity - 1;
+                _keys.assign(capacity, EMPTY);
+                _values.resize(capacity);
+            }
+
+            static uint64_t key(Index a, Index b) { return ((uint64_t)a << 32) | (uint64_t)b; }
+
+            // Returns the halfedge slot stored for key, or npos if there is none.
+            uint32_t find(uint64_t k) const
+            {
+                for (Size i = slot(k);; i = (i + 1) & _mask)
+                {
+                    if (_keys[i] == k) return _values[i];
+                    if (_keys[i] == EMPTY) return ElementPool<Halfedge>::npos;
+                }
+            }
+
+            // Stores value for key; returns false if the key was already present.
+            bool insert(uint64_t k, uint32_t value)
+            {
+                for (Size i = slot(k);; i = (i + 1) & _mask)
+                {
+                    if (_keys[i] == k) return false;
+                    if (_keys[i] == EMPTY)
+                    {
+                        _keys[i] = k;
+                        _values[i] = value;
+                        return true;
+                    }
+                }
+            }
+
+        private:
+            enum : uint64_t { EMPTY = ~(uint64_t)0 };
+
+            Size slot(uint64_t k) const
+            {
+                // Fibonacci hashing: spreads the packed (a, b) pairs evenly over the table
+                return (Size)((k * 0x9E3779B97F4A7C15ull) >> 32) & _mask;
+            }
+
+            vector<uint64_t> _keys;
+            vector<uint32_t> _values;
+            Size _mask;
+        };
+    }
+
+    int HalfedgeMesh::buildFast(const vector< vector<Index> >& polygons,
+        const vector<Vector3D>& vertexPositions)
+        // Same as build(), but for input where vertex indices are exactly 0 .. n-1 (one per
+        // entry of vertexPositions) and the surface is expected to be manifold, which is what
+        // stitching and subdivision produce.  Instead of ordered maps we use the input index
+        // directly as the vertex slot and find twins through a hashed edge table, which makes
+        // the whole thing linear in the size of the input.  Nothing is reported here: as soon
+        // as something looks wrong we throw away the partial mesh and let the checked build()
+        // deal with (and explain) the input.
+    {
+        halfedges.clear();
+        vertices.clear();
+        edges.clear();
+        faces.clear();
+        boundaries.clear();
+
+        Size nVertices = vertexPositions.size();
+        Size nFaces = polygons.size();
+        Size nHalfedges = 0;
+        for (Index p = 0; p < nFaces; p++)
+        {
+            nHalfedges += polygons[p].size();
+        }
+        if (nVertices >= ElementPool<Vertex>::npos || 2 * nHalfedges >= ElementPool<Halfedge>::npos)
+        {
+            return build(polygons, vertexPositions);
+        }
+
+        // For a closed surface there are exactly as many halfedges as polygon corners;
+        // boundaries only add a few more.
+        halfedges.reserve(nHalfedges);
+        edges.reserve(nHalfedges / 2);
+        vertices.reserve(nVertices);
+        faces.reserve(nFaces);
+
+        // Vertex i of the input lives in slot i of the mesh.
+        for (Index i = 0; i < nVertices; i++)
+        {
+            VertexIter v = newVertex();
+            v->halfedge() = halfedges.end();
+            v->position = vertexPositions[i];
+        }
+        vector<Size> vertexDegree(nVertices, 0);
+
+        EdgeTable pairToHalfedge(nHalfedges);
+        vector<HalfedgeIter> faceHalfedges;
+
+        for (Index p = 0; p < nFaces; p++)
+        {
+            const vector<Index>& polygon = polygons[p];
+            Size degree = polygon.size();
+            if (degree < 3)
+            {
+                return build(polygons, vertexPositions);
+            }
+
+            // polygons are tiny (usually triangles or quads), so a quadratic check for
+            // repeated vertices is cheaper than building a set
+            for (Index i = 0; i < degree; i++)
+            {
+                if (polygon[i] >= nVertices)
+                {
+                    return build(polygons, vertexPositions);
+                }
+                for (Index j = 0; j < i; j++)
+                {
+                    if (polygon[i] == polygon[j])
+                    {
+                        return build(polygons, vertexPositions);
+                    }
+                }
+                vertexDegree[polygon[i]]++;
+            }
+
+            FaceIter f = newFace();
+            faceHalfedges.clear();
+
+            for (Index i = 0; i < degree; i++)
+            {
+                Index a = polygon[i];
+                Index b = polygon[(i + 1) % degree];
+
+                HalfedgeIter hab = newHalfedge();
+                if (!pairToHalfedge.insert(EdgeTable::key(a, b), hab.index()))
+                {
+                    // multiple oriented edges (a, b)
+                    return build(polygons, vertexPositions);
+                }
+
+                hab->face() = f;
+                f->halfedge() = hab;
+                hab->vertex() = vertexAt(a);
+                hab->vertex()->halfedge() = hab;
+                faceHalfedges.push_back(hab);
+
+                uint32_t iba = pairToHalfedge.find(EdgeTable::key(b, a));
+                if (iba != ElementPool<Halfedge>::npos)
+                {
+                    HalfedgeIter hba = halfedgeAt(iba);
+                    hab->twin() = hba;
+                    hba->twin() = hab;
+
+                    EdgeIter e = newEdge();
+                    hab->edge() = e;
+                    hba->edge() = e;
+                    e->halfedge() = hab;
+                }
+                else
+                {
+                    hab->twin() = halfedges.end();
+                }
+            }
+
+            for (Index i = 0; i < degree; i++)
+            {
+                faceHalfedges[i]->next() = faceHalfedges[(i + 1) % degree];
+            }
+        }
+
+        // every vertex must be used by some polygon
+        for (Index i = 0; i < nVertices; i++)
+        {
+            if (vertexDegree[i] == 0)
+            {
+                return build(polygons, vertexPositions);
+            }
+        }
+
+        if (linkBoundaries(vertexDegree, false) != 0)
+        {
+            return build(polygons, vertexPositions);
+        }
+        return 0;
+    } // end HalfedgeMesh::buildFast()
+
+    int HalfedgeMesh::linkBoundaries(const vector<Size>& vertexDegree, bool verbose)
+        // Second half of build() and buildFast(): at this point every polygon has its halfedges,
+        // and halfedges without a twin point to halfedges.end().  Here we close up each boundary
+        // with a "virtual" face and make sure that every vertex is a proper fan of polygons,
+        // whose size was counted into vertexDegree (indexed by vertex slot) by the caller.
+    {
         // For each vertex on the boundary, advance its halfedge pointer to one that is also on the boundary.
         for (VertexIter v = verticesBegin(); v != verticesEnd(); v++)
         {
@@ -361,7 +593,7 @@ namespace CGL {
             // if it is then we do not have a valid 2-manifold surface.
             if (v->halfedge() == halfedges.end())
             {
-                cerr << "Error converting polygons to halfedge mesh: some vertices are not referenced by any polygon." << endl;
+                if (verbose) cerr << "Error converting polygons to halfedge mesh: some vertices are not referenced by any polygon." << endl;
                 return -1;
             }
 
@@ -380,36 +612,15 @@ namespace CGL {
                 h = h->twin()->next();
             } while (h != v->halfedge());
 
-            if (count != vertexDegree[v])
+            if (count != vertexDegree[v.index()])
             {
-                cerr << "Error converting polygons to halfedge mesh: at least one of the vertices is nonmanifold." << endl;
+                if (verbose) cerr << "Error converting polygons to halfedge mesh: at least one of the vertices is nonmanifold." << endl;
                 return -1;
             }
         } // end loop over vertices
 
-        // Now that we have the connectivity, we copy the list of vertex
-        // positions into member variables of the individual vertices.
-        if (vertexPositions.size() != vertices.size())
-        {
-            cerr << "Error converting polygons to halfedge mesh: number of vertex positions is different from the number of distinct vertices!" << endl;
-            cerr << "(number of positions in input: " << vertexPositions.size() << ")" << endl;
-            cerr << "(  number of vertices in mesh: " << vertices.size() << ")" << endl;
-            return -1;
-        }
-        // Since an STL map internally sorts its keys, we can iterate over the map from vertex indices to
-        // vertex iterators to visit our (input) vertices in lexicographic order
-        int i = 0;
-        for (map<Index, VertexIter>::const_iterator e = indexToVertex.begin(); e != indexToVertex.end(); e++)
-        {
-            // grab a pointer to the vertex associated with the current key (i.e., the current index)
-            VertexIter v = e->second;
-
-            // set the position of this vertex to the corresponding position in the input
-            v->position = vertexPositions[i];
-            i++;
-        }
         return 0;
-    } // end HalfedgeMesh::build()
+    } // end HalfedgeMesh::linkBoundaries()
 
     const HalfedgeMesh& HalfedgeMesh :: operator=(const HalfedgeMesh& mesh)
         // The assignment operator does a "deep" copy of the halfedge mesh data structure; in
@@ -419,48 +630,107 @@ namespace CGL {
         // on the right-hand side of an assignment may be temporary (hence any pointers to elements
         // in this mesh will become invalid as soon as it is released.)
     {
-        // Clear any existing elements.
-        halfedges.clear();
-        vertices.clear();
-        edges.clear();
-        faces.clear();
-        boundaries.clear();
-
-        // These maps will be used to identify elements of the old mesh
-        // with elements of the new mesh.  (Note that we can use a single
-        // map for both interior and boundary faces, because the map
-        // doesn't care which list of faces these iterators come from.)
-        map< HalfedgeCIter, HalfedgeIter > halfedgeOldToNew;
-        map<   VertexCIter, VertexIter >   vertexOldToNew;
-        map<     EdgeCIter, EdgeIter >     edgeOldToNew;
-        map<     FaceCIter, FaceIter >     faceOldToNew;
-
-        // Copy geometry from the original mesh and create a map from
-        // pointers in the original mesh to those in the new mesh.
-        for (HalfedgeCIter h = mesh.halfedgesBegin(); h != mesh.halfedgesEnd(); h++) halfedgeOldToNew[h] = halfedges.insert(halfedges.end(), *h);
-        for (VertexCIter v = mesh.verticesBegin(); v != mesh.verticesEnd(); v++)   vertexOldToNew[v] = vertices.insert(vertices.end(), *v);
-        for (EdgeCIter e = mesh.edgesBegin(); e != mesh.edgesEnd(); e++)     edgeOldToNew[e] = edges.insert(edges.end(), *e);
-        for (FaceCIter f = mesh.facesBegin(); f != mesh.facesEnd(); f++)     faceOldToNew[f] = faces.insert(faces.end(), *f);
-        for (FaceCIter b = mesh.boundariesBegin(); b != mesh.boundariesEnd(); b++)     faceOldToNew[b] = boundaries.insert(boundaries.end(), *b);
-
-        // "Search and replace" old pointers with new ones.
-        for (HalfedgeIter he = halfedgesBegin(); he != halfedgesEnd(); he++)
-        {
-            he->next() = halfedgeOldToNew[he->next()];
-            he->twin() = halfedgeOldToNew[he->twin()];
-            he->vertex() = vertexOldToNew[he->vertex()];
-            he->edge() = edgeOldToNew[he->edge()];
-            he->face() = faceOldToNew[he->face()];
+        if (this == &mesh)
+        {
+            return *this;
         }
-        for (VertexIter v = verticesBegin(); v != verticesEnd(); v++) v->halfedge() = halfedgeOldToNew[v->halfedge()];
-        for (EdgeIter e = edgesBegin(); e != edgesEnd(); e++) e->halfedge() = halfedgeOldToNew[e->halfedge()];
-        for (FaceIter f = facesBegin(); f != facesEnd(); f++) f->halfedge() = halfedgeOldToNew[f->halfedge()];
-        for (FaceIter b = boundariesBegin(); b != boundariesEnd(); b++) b->halfedge() = halfedgeOldToNew[b->halfedge()];
+
+        // Copy the element pools wholesale.  Since elements keep their slots, the copied
+        // iterators already have the right indices; they just still refer to the pools of
+        // the original mesh, so we "search and replace" the pools they point into.
+        halfedges = mesh.halfedges;
+        vertices = mesh.vertices;
+        edges = mesh.edges;
+        faces = mesh.faces;
+        boundaries = mesh.boundaries;
+
+        rebindElements(&mesh.halfedges, &mesh.vertices, &mesh.edges, &mesh.faces, &mesh.boundaries,
+            nullptr, nullptr, nullptr, nullptr, nullptr);
 
         // Return a reference to the new mesh.
         return *this;
     }
 
+    void HalfedgeMesh::compact(void)
+    {
+        if (isCompact())
+        {
+            return;
+        }
+
+        // Squeeze the holes out of each pool, remembering where every element moved to...
+        vector<uint32_t> halfedgeMap, vertexMap, edgeMap, faceMap, boundaryMap;
+        halfedges.compact(halfedgeMap);
+        vertices.compact(vertexMap);
+        edges.compact(edgeMap);
+        faces.compact(faceMap);
+        boundaries.compact(boundaryMap);
+
+        // ...and then fix up the references between elements.  References to deleted
+        // elements (which should not be followed anyway) become end() iterators.
+        rebindElements(&halfedges, &vertices, &edges, &faces, &boundaries,
+            &halfedgeMap, &vertexMap, &edgeMap, &faceMap, &boundaryMap);
+    }
+
+    // Points an iterator that refers into oldPool at the same element of newPool,
+    // translating its slot through remap if one is given.  Returns false (and leaves
+    // the iterator alone) if the iterator refers to some other pool.
+    template <typename T>
+    static bool rebindIter(PoolIterator<T, false>& it, const void* oldPool, ElementPool<T>& newPool,
+        const vector<uint32_t>* remap)
+    {
+        if ((const void*)it.pool() != oldPool)
+        {
+            return false;
+        }
+
+        uint32_t i = it.index();
+        if (remap != nullptr && i != ElementPool<T>::npos)
+        {
+            i = i < remap->size() ? (*remap)[i] : ElementPool<T>::npos;
+        }
+        it = PoolIterator<T, false>(&newPool, i);
+        return true;
+    }
+
+    void HalfedgeMesh::rebindElements(const void* oldHalfedges, const void* oldVertices, const void* oldEdges,
+        const void* oldFaces, const void* oldBoundaries,
+        const vector<uint32_t>* halfedgeMap, const vector<uint32_t>* vertexMap, const vector<uint32_t>* edgeMap,
+        const vector<uint32_t>* faceMap, const vector<uint32_t>* boundaryMap)
+    {
+        for (HalfedgeIter h = halfedgesBegin(); h != halfedgesEnd(); h++)
+        {
+            rebindIter(h->next(), oldHalfedges, halfedges, halfedgeMap);
+            rebindIter(h->twin(), oldHalfedges, halfedges, halfedgeMap);
+            rebindIter(h->vertex(), oldVertices, vertices, vertexMap);
+            rebindIter(h->edge(), oldEdges, edges, edgeMap);
+            if (!rebindIter(h->face(), oldFaces, faces, faceMap))
+            {
+                rebindIter(h->face(), oldBoundaries, boundaries, boundaryMap);
+            }
+        }
+        for (VertexIter v = verticesBegin(); v != verticesEnd(); v++)
+        {
+            rebindIter(v->halfedge(), oldHalfedges, halfedges, halfedgeMap);
+            rebindIter(v->newVertex, oldVertices, vertices, vertexMap);
+        }
+        for (EdgeIter e = edgesBegin(); e != edgesEnd(); e++)
+        {
+            rebindIter(e->halfedge(), oldHalfedges, halfedges, halfedgeMap);
+            rebindIter(e->newVertex, oldVertices, vertices, vertexMap);
+        }
+        for (FaceIter f = facesBegin(); f != facesEnd(); f++)
+        {
+            rebindIter(f->halfedge(), oldHalfedges, halfedges, halfedgeMap);
+            rebindIter(f->newVertex, oldVertices, vertices, vertexMap);
+        }
+        for (FaceIter b = boundariesBegin(); b != boundariesEnd(); b++)
+        {
+            rebindIter(b->halfedge(), oldHalfedges, halfedges, halfedgeMap);
+            rebindIter(b->newVertex, oldVertices, vertices, vertexMap);
+        }
+    }
+
     HalfedgeMesh::HalfedgeMesh(const HalfedgeMesh& mesh)
     {
         *this = mesh;
@@ -737,6 +1007,109 @@ namespace CGL {
         return v0;
     }
 
+    int HalfedgeMesh::splitFacesIntoQuads(void)
+    {
+        if (nBoundaries() != 0 || nFaces() == 0)
+        {
+            return -1;
+        }
+
+        // Work on dense slots 0 .. n-1 so that every element is just an integer.
+        compact();
+
+        uint32_t nV = (uint32_t)nVertices();
+        uint32_t nE = (uint32_t)nEdges();
+        uint32_t nF = (uint32_t)nFaces();
+        uint32_t nH = (uint32_t)nHalfedges();
+
+        // Flatten the parent connectivity; prev is the inverse of next.
+        vector<uint32_t> next(nH), prev(nH), twin(nH), vert(nH), edge(nH), face(nH);
+        for (uint32_t k = 0; k < nH; k++)
+        {
+            HalfedgeCIter h = halfedgeAt(k);
+            next[k] = h->next().index();
+            twin[k] = h->twin().index();
+            vert[k] = h->vertex().index();
+            edge[k] = h->edge().index();
+            face[k] = h->face().index();
+            prev[next[k]] = k;
+        }
+
+        vector<uint32_t> edgeHalfedge(nE), faceHalfedge(nF);
+        vector<Vector3D> positions(nV + nE + nF);
+        for (uint32_t v = 0; v < nV; v++)
+        {
+            positions[v] = vertexAt(v)->newPosition;
+        }
+        for (uint32_t e = 0; e < nE; e++)
+        {
+            edgeHalfedge[e] = edgeAt(e)->halfedge().index();
+            positions[nV + e] = edgeAt(e)->newPosition;
+        }
+        for (uint32_t f = 0; f < nF; f++)
+        {
+            faceHalfedge[f] = faceAt(f)->halfedge().index();
+            positions[nV + nE + f] = faceAt(f)->newPosition;
+        }
+
+        // Every parent halfedge k (of face f, running along edge e into vertex v = vert[next[k]])
+        // owns one child quad, whose halfedges 4k+0 .. 4k+3 visit
+        //
+        //    face point of f -> edge point of e -> v -> edge point of edge[next[k]] -> back
+        //
+        // Child vertices are numbered [parent vertices | edge points | face points].  Each parent
+        // edge e is split into child edges 2e (the half touching the head of edgeHalfedge[e]) and
+        // 2e+1, and the child edge from a face point to the edge point of k is 2 nE + k.
+        uint32_t nChildVertices = nV + nE + nF;
+        uint32_t nChildEdges = 2 * nE + nH;
+        uint32_t nChildHalfedges = 4 * nH;
+
+        halfedges.clear();
+        vertices.clear();
+        edges.clear();
+        faces.clear();
+        halfedges.reserve(nChildHalfedges);
+        vertices.reserve(nChildVertices);
+        edges.reserve(nChildEdges);
+        faces.reserve(nH);
+
+        for (uint32_t i = 0; i < nChildHalfedges; i++) newHalfedge();
+        for (uint32_t i = 0; i < nChildVertices; i++) newVertex()->position = positions[i];
+        for (uint32_t i = 0; i < nChildEdges; i++) newEdge();
+        for (uint32_t i = 0; i < nH; i++) newFace();
+
+        for (uint32_t k = 0; k < nH; k++)
+        {
+            uint32_t nk = next[k];
+            uint32_t e0 = edge[k];
+            uint32_t e1 = edge[nk];
+
+            // which half of the split parent edges this quad touches
+            uint32_t side0 = 2 * e0 + (edgeHalfedge[e0] == k ? 0 : 1);
+            uint32_t side1 = 2 * e1 + (edgeHalfedge[e1] == twin[nk] ? 0 : 1);
+
+            HalfedgeIter a = halfedgeAt(4 * k + 0);
+            HalfedgeIter b = halfedgeAt(4 * k + 1);
+            HalfedgeIter c = halfedgeAt(4 * k + 2);
+            HalfedgeIter d = halfedgeAt(4 * k + 3);
+            FaceIter f = faceAt(k);
+
+            a->setNeighbors(b, halfedgeAt(4 * prev[k] + 3), vertexAt(nV + nE + face[k]), edgeAt(2 * nE + k), f); // next, twin, vertex, edge, face;
+            b->setNeighbors(c, halfedgeAt(4 * prev[twin[k]] + 2), vertexAt(nV + e0), edgeAt(side0), f);
+            c->setNeighbors(d, halfedgeAt(4 * twin[nk] + 1), vertexAt(vert[nk]), edgeAt(side1), f);
+            d->setNeighbors(a, halfedgeAt(4 * nk + 0), vertexAt(nV + e1), edgeAt(2 * nE + nk), f);
+
+            f->halfedge() = a;
+            edgeAt(2 * nE + k)->halfedge() = a;
+            edgeAt(side0)->halfedge() = b;
+            vertexAt(vert[nk])->halfedge() = c;
+            if (edgeHalfedge[e0] == k) vertexAt(nV + e0)->halfedge() = b;
+            if (faceHalfedge[face[k]] == k) vertexAt(nV + nE + face[k])->halfedge() = a;
+        }
+
+        return 0;
+    }
+
     VertexIter HalfedgeMesh::avgVertex(VertexIter v) {
         return VertexIter();
     }
@@ -71,25 +71,22 @@
   * data structure.  But it's worth making a few comments about how this
   * particular implementation works---especially how things like boundaries
   * are handled.  First and foremost, the "pointers" used in this
-  * implementation are actually STL iterators.  STL stands for the "standard
-  * template library," and is a basic part of C++ that provides some very
-  * convenient and powerful data structures and algorithms---if you've never
-  * looked at STL before, now would be a great time to get familiar!  At
-  * a high level, STL iterators behave a lot like pointers: they don't store
-  * data, but rather reference some data that is allocated elsewhere.  And
-  * the syntax is also very similar; for instance, if p is an iterator, then
-  * *p yields the value referred to by p.  (As for the rest, Google is a
-  * terrific resource! :-))
+  * implementation are actually iterators in the style of the STL ("standard
+  * template library").  At a high level, iterators behave a lot like pointers:
+  * they don't store data, but rather reference some data that is allocated
+  * elsewhere.  And the syntax is also very similar; for instance, if p is an
+  * iterator, then *p yields the value referred to by p.  Here each iterator is
+  * a 32-bit slot index into one of the contiguous element pools owned by the
+  * mesh (see elementPool.h), so that walking the mesh touches densely packed
+  * memory rather than chasing linked-list nodes all over the heap.
   *
   * Rather than accessing raw iterators, the HalfedgeMesh encapsulates these
   * pointers using methods like Halfedge::twin(), Halfedge::next(), etc.  The
   * reason for this encapsulation (as in most object-oriented programming)
   * is that it allows the user to make changes to the internal representation
-  * later down the line.  For instance, if you know that the connectivity of
-  * the mesh is never going to change, you might be able to improve performance
-  * by (internally) replacing the linked lists with fixed-length arrays,
-  * without breaking any code that might have been written using the abstract
-  * interface.  (There are deeper reasons for this kind of encapsulation
+  * later down the line.  For instance, the elements used to live in linked
+  * lists; replacing them with arrays did not break any code that had been
+  * written using the abstract interface.  (There are deeper reasons for this kind of encapsulation
   * when working with polygon meshes, but that's a story for another time!)
   *
   * Finally, some surfaces have "boundary loops," e.g., a pair of pants has
@@ -141,7 +138,6 @@
 
 #include <set>
 #include <map>
-#include <list>
 #include <vector>
 #include <utility>
 #include <iostream>
@@ -150,6 +146,7 @@
 #include "CGL/matrix4x4.h"
 
 #include "mesh.h"
+#include "elementPool.h"
 
 using namespace std;
 using namespace CGL;
@@ -173,13 +170,13 @@ namespace CGL
 
     /*
      * Rather than using raw pointers to mesh elements, we store references
-     * as STL::iterators---for convenience, we give shorter names to these
-     * iterators (e.g., EdgeIter instead of list<Edge>::iterator).
+     * as pool iterators---for convenience, we give shorter names to these
+     * iterators (e.g., EdgeIter instead of ElementPool<Edge>::iterator).
      */
-    typedef   list<Vertex>::iterator   VertexIter;
-    typedef     list<Edge>::iterator     EdgeIter;
-    typedef     list<Face>::iterator     FaceIter;
-    typedef list<Halfedge>::iterator HalfedgeIter;
+    typedef   ElementPool<Vertex>::iterator   VertexIter;
+    typedef     ElementPool<Edge>::iterator     EdgeIter;
+    typedef     ElementPool<Face>::iterator     FaceIter;
+    typedef ElementPool<Halfedge>::iterator HalfedgeIter;
 
     /*
      * We also need "const" iterator types, for situations where a method takes
@@ -187,33 +184,25 @@ namespace CGL
      * used so frequently, we will use "CIter" as a shorthand abbreviation for
      * "constant iterator."
      */
-    typedef   list<Vertex>::const_iterator   VertexCIter;
-    typedef     list<Edge>::const_iterator     EdgeCIter;
-    typedef     list<Face>::const_iterator     FaceCIter;
-    typedef list<Halfedge>::const_iterator HalfedgeCIter;
+    typedef   ElementPool<Vertex>::const_iterator   VertexCIter;
+    typedef     ElementPool<Edge>::const_iterator     EdgeCIter;
+    typedef     ElementPool<Face>::const_iterator     FaceCIter;
+    typedef ElementPool<Halfedge>::const_iterator HalfedgeCIter;
 
     /*
      * Some algorithms need to know how to compare two iterators (which comes first?)
-     * Here we just say that one iterator comes before another if the address of the
-     * object it points to is smaller.  (You should not have to worry about this!)
+     * This is provided by operator< in elementPool.h, which orders iterators by the
+     * slot they refer to.  (You should not have to worry about this!)
      */
-    inline bool operator<(const HalfedgeIter& i, const HalfedgeIter& j) { return &*i < &*j; }
-    inline bool operator<(const   VertexIter& i, const   VertexIter& j) { return &*i < &*j; }
-    inline bool operator<(const     EdgeIter& i, const     EdgeIter& j) { return &*i < &*j; }
-    inline bool operator<(const     FaceIter& i, const     FaceIter& j) { return &*i < &*j; }
-
-    // We also need to know how to compare const iterators.
-    inline bool operator<(const HalfedgeCIter& i, const HalfedgeCIter& j) { return &*i < &*j; }
-    inline bool operator<(const   VertexCIter& i, const   VertexCIter& j) { return &*i < &*j; }
-    inline bool operator<(const     EdgeCIter& i, const     EdgeCIter& j) { return &*i < &*j; }
-    inline bool operator<(const     FaceCIter& i, const     FaceCIter& j) { return &*i < &*j; }
 
     /**
      * The elementAddress() function is defined only for convenience (and
      * readability), and returns the actual memory address associated with
      * a mesh element referred to by the given iterator.  (This is especially
      * helpful for things like debugging, where we want to check that one
-     * element is properly pointing to another.)
+     * element is properly pointing to another.)  Note that the address is only
+     * meaningful until the next element of the same type is allocated, since
+     * the pool may have to grow.
      */
     inline Halfedge* elementAddress(HalfedgeIter h) { return &(*h); }
     inline   Vertex* elementAddress(VertexIter v) { return &(*v); }
@@ -371,7 +360,7 @@ namespace CGL
 
         Vector3D newPosition;
         VertexIter newVertex;
-        bool isNew;
+        bool isNew{false};
 
         /**
          * returns the number of edges (or equivalently, vertices) of this face
@@ -434,7 +423,7 @@ namespace CGL
 
         Vector3D newPosition; ///< For Loop subdivision, this will be the updated position of the vertex
         VertexIter newVertex;
-        bool isNew; ///< For Loop subdivision, this flag should be true if and only if this vertex is a new vertex created by subdivision (i.e., if it corresponds to a vertex of the original mesh)
+        bool isNew{false}; ///< For Loop subdivision, this flag should be true if and only if this vertex is a new vertex created by subdivision (i.e., if it corresponds to a vertex of the original mesh)
 
         /**
          * computes the average of the neighboring vertex positions and stores it in Vertex::centroid
@@ -525,7 +514,7 @@ namespace CGL
 
         Vector3D newPosition; ///< For Loop subdivision, this will be the position for the edge midpoint
         VertexIter newVertex;
-        bool isNew; ///< For Loop subdivision, this flag should be true if and only if this edge is a new edge created by subdivision (i.e., if it cuts across a triangle in the original mesh)
+        bool isNew{false}; ///< For Loop subdivision, this flag should be true if and only if this edge is a new edge created by subdivision (i.e., if it cuts across a triangle in the original mesh)
         bool isDeleted{false};
         EdgeRecord record;
 
@@ -565,6 +554,16 @@ namespace CGL
          */
         int build(const vector< vector<Index> >& polygons, const vector<Vector3D>& vertexPositions);
 
+        /**
+         * A faster version of build() for input that is known to be well-formed, such as the
+         * output of stitching or subdivision: the vertex indices must be exactly 0 .. n-1, where
+         * n = vertexPositions.size(), and vertex i of the input is stored in slot i of the mesh.
+         * Instead of ordered maps it uses flat arrays and a hashed edge table.  If the input turns
+         * out to be non-manifold (or otherwise not what this method expects), it falls back to
+         * build(), so the result is the same either way.
+         */
+        int buildFast(const vector< vector<Index> >& polygons, const vector<Vector3D>& vertexPositions);
+
         // These methods return the total number of elements of each type.
         Size nHalfedges(void) const { return  halfedges.size(); } ///< get the number of halfedges
         Size nVertices(void) const { return   vertices.size(); } ///< get the number of vertices
@@ -605,20 +604,21 @@ namespace CGL
          * These methods allocate new mesh elements, returning a pointer (i.e., iterator) to the new element.
          * (These methods cannot have const versions, because they modify the mesh!)
          */
-        HalfedgeIter newHalfedge(void) { return  halfedges.insert(halfedges.end(), Halfedge()); }
-        VertexIter   newVertex(void) { return   vertices.insert(vertices.end(), Vertex()); }
-        EdgeIter     newEdge(void) { return      edges.insert(edges.end(), Edge()); }
-        FaceIter     newFace(void) { return      faces.insert(faces.end(), Face(false)); }
-        FaceIter     newBoundary(void) { return boundaries.insert(boundaries.end(), Face(true)); }
+        HalfedgeIter newHalfedge(void) { return  halfedges.insert(Halfedge()); }
+        VertexIter   newVertex(void) { return   vertices.insert(Vertex()); }
+        EdgeIter     newEdge(void) { return      edges.insert(Edge()); }
+        FaceIter     newFace(void) { return      faces.insert(Face(false)); }
+        FaceIter     newBoundary(void) { return boundaries.insert(Face(true)); }
 
         /*
          * These methods delete a specified mesh element.  One should think very, very carefully about
          * exactly when and how to delete mesh elements, since other elements will often still point
          * to the element that is being deleted, and accessing a deleted element will cause your
          * program to crash (or worse!).  A good exercise to think about is: suppose you're iterating
-         * over a linked list, and want to delete some of the elements as you go.  How do you do this
+         * over a list, and want to delete some of the elements as you go.  How do you do this
          * without causing any problems?  For instance, if you delete the current element, will you be
-         * able to iterate to the next element?  Etc.
+         * able to iterate to the next element?  Etc.  (Deleted elements leave a hole in their pool,
+         * which is reused by the next allocation; see compact() to get rid of the holes.)
          */
         void deleteHalfedge(HalfedgeIter h) { halfedges.erase(h); }
         void deleteVertex(VertexIter v) { vertices.erase(v); }
@@ -628,6 +628,32 @@ namespace CGL
 
         EdgeIter ReturnDeleteEdge(EdgeIter e) { return edges.erase(e); }
 
+        /*
+         * Elements live in contiguous pools, so each one also has an integer index (its slot,
+         * HalfedgeIter::index()).  After a call to compact(), the slots of each element type are
+         * exactly 0 .. n-1, which lets algorithms loop over (or split between threads) a plain
+         * index range and keep per-element data in flat arrays.
+         */
+        HalfedgeIter halfedgeAt(Index i) { return halfedges.at((uint32_t)i); } HalfedgeCIter halfedgeAt(Index i) const { return halfedges.at((uint32_t)i); }
+        VertexIter   vertexAt(Index i) { return  vertices.at((uint32_t)i); } VertexCIter   vertexAt(Index i) const { return  vertices.at((uint32_t)i); }
+        EdgeIter     edgeAt(Index i) { return     edges.at((uint32_t)i); } EdgeCIter     edgeAt(Index i) const { return     edges.at((uint32_t)i); }
+        FaceIter     faceAt(Index i) { return     faces.at((uint32_t)i); } FaceCIter     faceAt(Index i) const { return     faces.at((uint32_t)i); }
+
+        /**
+         * Returns true if no pool has any holes left by deleted elements.
+         */
+        bool isCompact(void) const
+        {
+            return halfedges.isCompact() && vertices.isCompact() && edges.isCompact() && faces.isCompact() && boundaries.isCompact();
+        }
+
+        /**
+         * Removes the holes left behind by deleted elements, moving the remaining elements to the
+         * front of their pools (their relative order is preserved) and updating every reference
+         * between them.  Any iterator held outside of the mesh is invalidated.
+         */
+        void compact(void);
+
         /* For a triangle mesh, you will implement the following
          * basic edge operations.  (Can you generalize to other
          * polygonal meshes?)
@@ -637,6 +663,17 @@ namespace CGL
         VertexIter collapseEdge(EdgeIter e); // return a pointer to the collapsed vertex 
         VertexIter avgVertex(VertexIter v); // return a pointer to the averaged vertex
 
+        /**
+         * Topological half of a Catmull-Clark step: replaces every face of degree n with n quads,
+         * each joining the face's newPosition (face point), the newPosition of two consecutive
+         * edges (edge points) and the newPosition of the vertex in between (updated vertex).
+         * The refined connectivity is written directly from the element indices of the current
+         * mesh; no positions are compared and nothing is rebuilt from a polygon soup.  After the
+         * call the vertex slots are [vertices | edge points | face points] in parent slot order.
+         * Only closed meshes are handled; returns -1 (leaving the mesh untouched) otherwise.
+         */
+        int splitFacesIntoQuads(void);
+
         void check_for(HalfedgeIter h) {
             for (HalfedgeIter he = halfedgesBegin(); he != halfedgesEnd(); he++) {
                 if (he == h)
@@ -689,15 +726,30 @@ namespace CGL
         }
     protected:
 
+        /**
+         * Shared tail of build() and buildFast(): closes boundary loops with virtual faces and
+         * checks that every vertex is manifold.  Returns -1 (printing why, if verbose) on failure.
+         */
+        int linkBoundaries(const vector<Size>& vertexDegree, bool verbose);
+
+        /**
+         * Re-targets iterators copied from another mesh (or from before a compaction) at the
+         * pools of this mesh; see the assignment operator and compact().
+         */
+        void rebindElements(const void* oldHalfedges, const void* oldVertices, const void* oldEdges,
+            const void* oldFaces, const void* oldBoundaries,
+            const vector<uint32_t>* halfedgeMap, const vector<uint32_t>* vertexMap, const vector<uint32_t>* edgeMap,
+            const vector<uint32_t>* faceMap, const vector<uint32_t>* boundaryMap);
+
         /**
          * Here's where the mesh elements are actually stored---this is the one
          * and only place we have actual data (rather than pointers/iterators).
          */
-        list<Halfedge> halfedges;
-        list<Vertex> vertices;
-        list<Edge> edges;
-        list<Face> faces;
-        list<Face> boundaries;
+        ElementPool<Halfedge> halfedges;
+        ElementPool<Vertex> vertices;
+        ElementPool<Edge> edges;
+        ElementPool<Face> faces;
+        ElementPool<Face> boundaries;
 
     }; // class HalfedgeMesh
 
@@ -0,0 +1,215 @@
+#include "stencilTable.h"
+
+#include <algorithm>
+
+namespace CGL {
+
+    namespace
+    {
+        // Rows of an intermediate table (face points and edge points of the level being
+        // refined); kept in double precision so that rounding only happens once per level.
+        struct Rows
+        {
+            Rows(void) : offsets(1, 0) {}
+
+            vector<uint32_t> offsets;
+            vector<uint32_t> indices;
+            vector<double> weights;
+        };
+
+        // Accumulates a linear combination of existing rows into a new row, using a
+        // dense scratch array over the base vertices.
+        class RowBuilder
+        {
+        public:
+            RowBuilder(Size nControl) : dense(nControl, 0.), used(nControl, 0) {}
+
+            template <typename W>
+            void add(const vector<uint32_t>& offsets, const vector<uint32_t>& indices,
+                const vector<W>& weights, Size row, double w)
+            {
+                for (uint32_t k = offsets[row]; k < offsets[row + 1]; k++)
+                {
+                    uint32_t j = indices[k];
+                    if (!used[j])
+                    {
+                        used[j] = 1;
+                        touched.push_back(j);
+                    }
+                    dense[j] += w * weights[k];
+                }
+            }
+
+            void add(const Rows& rows, Size row, double w)
+            {
+                add(rows.offsets, rows.indices, rows.weights, row, w);
+            }
+
+            // Appends the accumulated row (sorted by base vertex) and resets the scratch space.
+            template <typename W>
+            void finish(vector<uint32_t>& offsets, vector<uint32_t>& indices, vector<W>& weights)
+            {
+                sort(touched.begin(), touched.end());
+                for (uint32_t j : touched)
+                {
+                    indices.push_back(j);
+                    weights.push_back((W)dense[j]);
+                    dense[j] = 0.;
+                    used[j] = 0;
+                }
+                touched.clear();
+                offsets.push_back((uint32_t)indices.size());
+            }
+
+            void finish(Rows& rows)
+            {
+                finish(rows.offsets, rows.indices, rows.weights);
+            }
+
+        private:
+            vector<double> dense;
+            vector<uint8_t> used;
+            vector<uint32_t> touched;
+        };
+    }
+
+    void StencilTable::clear(void)
+    {
+        offsets.clear();
+        indices.clear();
+        weights.clear();
+        nControl = 0;
+    }
+
+    void StencilTable::setIdentity(Size nControlVertices)
+    {
+        nControl = nControlVertices;
+        offsets.resize(nControl + 1);
+        indices.resize(nControl);
+        weights.assign(nControl, 1.f);
+        for (Size i = 0; i < nControl; i++)
+        {
+            offsets[i] = (uint32_t)i;
+            indices[i] = (uint32_t)i;
+        }
+        offsets[nControl] = (uint32_t)nControl;
+    }
+
+    bool StencilTable::refineCatmullClark(const HalfedgeMesh& mesh, Size maxEntries)
+        // The weights mirror the point rules used by BMesh::__catmull_clark:
+        //    face point   = average of the face's vertices
+        //    edge point   = (two adjacent face points + two endpoints) / 4
+        //    vertex point = (sum of face points + 2 * sum of edge points + n * vertex) / (4n)
+        // where each term is itself a row of this table (i.e., a combination of base vertices).
+    {
+        if (empty() || nVertices() != mesh.nVertices() || !mesh.isCompact() || mesh.nBoundaries() != 0)
+        {
+            clear();
+            return false;
+        }
+
+        Size nV = mesh.nVertices();
+        Size nE = mesh.nEdges();
+        Size nF = mesh.nFaces();
+        RowBuilder row(nControl);
+
+        Rows facePoints;
+        for (Index f = 0; f < nF; f++)
+        {
+            FaceCIter face = mesh.faceAt(f);
+            double w = 1. / face->degree();
+            HalfedgeCIter h = face->halfedge();
+            do
+            {
+                row.add(offsets, indices, weights, h->vertex().index(), w);
+                h = h->next();
+            } while (h != face->halfedge());
+            row.finish(facePoints);
+        }
+
+        Rows edgePoints;
+        for (Index e = 0; e < nE; e++)
+        {
+            HalfedgeCIter h0 = mesh.edgeAt(e)->halfedge();
+            HalfedgeCIter h1 = h0->twin();
+            row.add(facePoints, h0->face().index(), .25);
+            row.add(facePoints, h1->face().index(), .25);
+            row.add(offsets, indices, weights, h0->vertex().index(), .25);
+            row.add(offsets, indices, weights, h1->vertex().index(), .25);
+            row.finish(edgePoints);
+        }
+
+        if (facePoints.indices.size() + edgePoints.indices.size() > maxEntries)
+        {
+            clear();
+            return false;
+        }
+
+        // The refined rows, in the slot order of the refined mesh.
+        vector<uint32_t> newOffsets(1, 0);
+        vector<uint32_t> newIndices;
+        vector<float> newWeights;
+        newIndices.reserve(2 * indices.size() + facePoints.indices.size() + edgePoints.indices.size());
+        newWeights.reserve(newIndices.capacity());
+
+        for (Index v = 0; v < nV; v++)
+        {
+            VertexCIter vertex = mesh.vertexAt(v);
+            Size n = 0;
+            HalfedgeCIter h = vertex->halfedge();
+            do
+            {
+                n++;
+                h = h->twin()->next();
+            } while (h != vertex->halfedge());
+
+            double w = 1. / (4. * n);
+            h = vertex->halfedge();
+            do
+            {
+                row.add(facePoints, h->face().index(), w);
+                row.add(edgePoints, h->edge().index(), 2. * w);
+                h = h->twin()->next();
+            } while (h != vertex->halfedge());
+            row.add(offsets, indices, weights, v, .25);
+            row.finish(newOffsets, newIndices, newWeights);
+        }
+
+        if (newIndices.size() + facePoints.indices.size() + edgePoints.indices.size() > maxEntries)
+        {
+            clear();
+            return false;
+        }
+
+        const Rows* tail[2] = { &edgePoints, &facePoints };
+        for (const Rows* rows : tail)
+        {
+            uint32_t base = (uint32_t)newIndices.size();
+            newIndices.insert(newIndices.end(), rows->indices.begin(), rows->indices.end());
+            newWeights.insert(newWeights.end(), rows->weights.begin(), rows->weights.end());
+            for (Size i = 1; i < rows->offsets.size(); i++)
+            {
+                newOffsets.push_back(base + rows->offsets[i]);
+            }
+        }
+
+        offsets.swap(newOffsets);
+        indices.swap(newIndices);
+        weights.swap(newWeights);
+        return true;
+    }
+
+    void StencilTable::apply(const vector<Vector3D>& control, HalfedgeMesh& mesh, Size begin, Size end) const
+    {
+        for (Size i = begin; i < end; i++)
+        {
+            Vector3D p(0., 0., 0.);
+            for (uint32_t k = offsets[i]; k < offsets[i + 1]; k++)
+            {
+                p += (double)weights[k] * control[indices[k]];
+            }
+            mesh.vertexAt(i)->position = p;
+        }
+    }
+
+} // namespace CGL
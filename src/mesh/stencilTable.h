@@ -0,0 +1,82 @@
+/*
+ * stencilTable.h
+ *
+ * Sparse Catmull-Clark stencils from base vertices to refined vertices.
+ */
+
+ /**
+  * Every vertex produced by Catmull-Clark subdivision is a fixed linear
+  * combination of the vertices of the base mesh; the weights only depend on
+  * the connectivity.  A StencilTable stores these combinations as a sparse
+  * matrix (one row per refined vertex, in compressed row form), so that when
+  * only the base positions change the refined positions can be recomputed
+  * with one sparse matrix-vector product, instead of rebuilding and
+  * subdividing the whole mesh again.
+  *
+  * The table is built alongside the subdivision itself: start with
+  * setIdentity() on the freshly built base mesh, then call
+  * refineCatmullClark() on each level *before* it is split into quads.  The
+  * rows always follow the vertex slots of the current (compact) mesh, which
+  * is what HalfedgeMesh::buildFast() and HalfedgeMesh::splitFacesIntoQuads()
+  * guarantee.
+  */
+
+#ifndef CGL_STENCILTABLE_H
+#define CGL_STENCILTABLE_H
+
+#include <vector>
+#include <stdint.h>
+
+#include "halfEdgeMesh.h"
+
+namespace CGL
+{
+    class StencilTable
+    {
+    public:
+
+        StencilTable(void) : nControl(0) {}
+
+        /**
+         * Forgets all stencils.  An empty table cannot be applied.
+         */
+        void clear(void);
+
+        bool empty(void) const { return offsets.empty(); }
+
+        Size nControlVertices(void) const { return nControl; } ///< number of base vertices (columns)
+        Size nVertices(void) const { return offsets.empty() ? 0 : offsets.size() - 1; } ///< number of refined vertices (rows)
+        Size nEntries(void) const { return indices.size(); } ///< number of nonzero weights
+
+        /**
+         * Starts a new table where refined vertex i is base vertex i.
+         */
+        void setIdentity(Size nControlVertices);
+
+        /**
+         * Extends the table by one Catmull-Clark level.  The rows of the table must
+         * correspond to the vertex slots of mesh, which must be closed and compact.
+         * Afterwards the rows follow the vertex slots that
+         * HalfedgeMesh::splitFacesIntoQuads() produces: [vertices | edge points | face points].
+         * If the table would grow beyond maxEntries weights it is cleared instead,
+         * and false is returned.
+         */
+        bool refineCatmullClark(const HalfedgeMesh& mesh, Size maxEntries);
+
+        /**
+         * Evaluates rows [begin, end) for the given base positions and writes them
+         * to the positions of the corresponding vertices of mesh.
+         */
+        void apply(const vector<Vector3D>& control, HalfedgeMesh& mesh, Size begin, Size end) const;
+
+    private:
+
+        vector<uint32_t> offsets; ///< row i has entries offsets[i] .. offsets[i+1]-1
+        vector<uint32_t> indices; ///< base vertex of each entry
+        vector<float> weights;    ///< weight of each entry
+        Size nControl;
+    };
+
+} // namespace CGL
+
+#endif // CGL_STENCILTABLE_H
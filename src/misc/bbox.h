@@ -0,0 +1,97 @@
+#ifndef CGL_UTIL_BBOX_H
+#define CGL_UTIL_BBOX_H
+
+#include <algorithm>
+#include <limits>
+
+#include "CGL/vector3D.h"
+
+namespace CGL {
+namespace Misc {
+
+/**
+ * A ray o + t * d for t >= 0. d need not be unit length; distances along the
+ * ray are in multiples of d.
+ */
+struct Ray {
+  Ray(const Vector3D &o, const Vector3D &d) : o(o), d(d), inv_d(1. / d.x, 1. / d.y, 1. / d.z) {}
+
+  Vector3D at(double t) const { return o + t * d; }
+
+  Vector3D o, d;
+  Vector3D inv_d; ///< 1 / d per axis, inf for a zero component
+};
+
+/**
+ * Axis-aligned bounding box, empty (min > max) until something is added.
+ */
+struct BBox {
+  BBox()
+      : min(std::numeric_limits<double>::infinity()),
+        max(-std::numeric_limits<double>::infinity()) {}
+  BBox(const Vector3D &min, const Vector3D &max) : min(min), max(max) {}
+
+  bool empty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+
+  void expand(const Vector3D &p) {
+    min.x = std::min(min.x, p.x);
+    min.y = std::min(min.y, p.y);
+    min.z = std::min(min.z, p.z);
+    max.x = std::max(max.x, p.x);
+    max.y = std::max(max.y, p.y);
+    max.z = std::max(max.z, p.z);
+  }
+
+  void expand(const BBox &b) {
+    if (b.empty()) {
+      return;
+    }
+    expand(b.min);
+    expand(b.max);
+  }
+
+  Vector3D centroid() const { return (min + max) / 2.; }
+  Vector3D extent() const { return max - min; }
+
+  double surface_area() const {
+    if (empty()) {
+      return 0.;
+    }
+    Vector3D e = extent();
+    return 2. * (e.x * e.y + e.y * e.z + e.z * e.x);
+  }
+
+  // Axis along which the box is the longest
+  int longest_axis() const {
+    Vector3D e = extent();
+    return e.x >= e.y && e.x >= e.z ? 0 : (e.y >= e.z ? 1 : 2);
+  }
+
+  /**
+   * Clips [t0, t1] to the part of the ray inside the box (slab test).
+   * Returns false, leaving t0 and t1 unspecified, if nothing is left.
+   */
+  bool intersect(const Ray &ray, double &t0, double &t1) const {
+    for (int axis = 0; axis < 3; axis++) {
+      double t_near = (min[axis] - ray.o[axis]) * ray.inv_d[axis];
+      double t_far = (max[axis] - ray.o[axis]) * ray.inv_d[axis];
+      if (t_near > t_far) {
+        std::swap(t_near, t_far);
+      }
+      // NaN (a zero component on the slab border) leaves the range alone
+      t0 = t_near > t0 ? t_near : t0;
+      t1 = t_far < t1 ? t_far : t1;
+      if (t0 > t1) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  Vector3D min, max;
+};
+
+} // namespace Misc
+} // namespace CGL
+
+#endif // CGL_UTIL_BBOX_H
@@ -0,0 +1,166 @@
+#include "point_grid.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace CGL {
+namespace Misc {
+
+const size_t PointGrid::npos;
+
+// Upper bound on the number of cells along one axis.
+static const int max_dim = 1024;
+
+void PointGrid::build(const std::vector<Vector3D> &points) {
+  this->points = &points;
+  cell_start.clear();
+  cell_points.clear();
+  dims[0] = dims[1] = dims[2] = 0;
+  if (points.empty()) {
+    return;
+  }
+
+  Vector3D lo = points[0], hi = points[0];
+  for (const Vector3D &p : points) {
+    for (int k = 0; k < 3; k++) {
+      lo[k] = std::min(lo[k], p[k]);
+      hi[k] = std::max(hi[k], p[k]);
+    }
+  }
+  origin = lo;
+
+  // About one point per cell; flat axes count as 1/1000 of the largest one
+  Vector3D extent = hi - lo;
+  double longest = std::max(extent.x, std::max(extent.y, extent.z));
+  if (longest <= 0.) {
+    longest = 1.;
+  }
+  double volume = 1.;
+  for (int k = 0; k < 3; k++) {
+    volume *= std::max(extent[k], longest * 1e-3);
+  }
+  cell_size = std::cbrt(volume / points.size());
+  cell_size = std::max(cell_size, longest / max_dim);
+
+  for (int k = 0; k < 3; k++) {
+    dims[k] = std::min(max_dim, (int)(extent[k] / cell_size) + 1);
+  }
+
+  // Counting sort of the points by cell, which keeps indices increasing
+  // within each cell
+  size_t num_cells = (size_t)dims[0] * dims[1] * dims[2];
+  std::vector<size_t> point_cell(points.size());
+  cell_start.assign(num_cells + 1, 0);
+  for (size_t i = 0; i < points.size(); i++) {
+    int cell[3];
+    cell_of(points[i], cell);
+    point_cell[i] = cell_index(cell[0], cell[1], cell[2]);
+    cell_start[point_cell[i] + 1]++;
+  }
+  for (size_t c = 0; c < num_cells; c++) {
+    cell_start[c + 1] += cell_start[c];
+  }
+  cell_points.resize(points.size());
+  std::vector<size_t> fill(cell_start.begin(), cell_start.end() - 1);
+  for (size_t i = 0; i < points.size(); i++) {
+    cell_points[fill[point_cell[i]]++] = i;
+  }
+}
+
+void PointGrid::cell_of(const Vector3D &p, int cell[3]) const {
+  for (int k = 0; k < 3; k++) {
+    double t = std::floor((p[k] - origin[k]) / cell_size);
+    cell[k] = (int)std::max(0., std::min(t, dims[k] - 1.));
+  }
+}
+
+void PointGrid::scan_cell(size_t cell, const Vector3D &p, size_t &best,
+                          double &best_dist) const {
+  for (size_t j = cell_start[cell]; j < cell_start[cell + 1]; j++) {
+    size_t i = cell_points[j];
+    double d = ((*points)[i] - p).norm();
+    if (d < best_dist) {
+      best_dist = d;
+      best = i;
+    }
+  }
+}
+
+size_t PointGrid::nearest(const Vector3D &p, double &dist) const {
+  size_t best = npos;
+  dist = INFINITY;
+  if (cell_points.empty()) {
+    return best;
+  }
+
+  int c[3];
+  cell_of(p, c);
+  int max_ring = std::max(dims[0], std::max(dims[1], dims[2]));
+  for (int r = 0; r <= max_ring; r++) {
+    // Cells at Chebyshev distance exactly r from c
+    int lo[3], hi[3];
+    for (int k = 0; k < 3; k++) {
+      lo[k] = std::max(c[k] - r, 0);
+      hi[k] = std::min(c[k] + r, dims[k] - 1);
+    }
+    for (int z = lo[2]; z <= hi[2]; z++) {
+      for (int y = lo[1]; y <= hi[1]; y++) {
+        bool shell = std::abs(z - c[2]) == r || std::abs(y - c[1]) == r;
+        for (int x = lo[0]; x <= hi[0]; x++) {
+          if (!shell && std::abs(x - c[0]) != r) {
+            // Jump over the inside of the ring
+            x = std::max(x, c[0] + r - 1);
+            continue;
+          }
+          scan_cell(cell_index(x, y, z), p, best, dist);
+        }
+      }
+    }
+
+    // Every point outside cells c-r .. c+r is at least this far from p
+    double bound = INFINITY;
+    for (int k = 0; k < 3; k++) {
+      double below = p[k] - (origin[k] + (c[k] - r) * cell_size);
+      double above = origin[k] + (c[k] + r + 1) * cell_size - p[k];
+      if (c[k] - r > 0) {
+        bound = std::min(bound, below);
+      }
+      if (c[k] + r + 1 < dims[k]) {
+        bound = std::min(bound, above);
+      }
+    }
+    if (dist <= bound) {
+      break;
+    }
+  }
+  return best;
+}
+
+void PointGrid::within(const Vector3D &p, double radius,
+                       std::vector<size_t> &out) const {
+  out.clear();
+  if (cell_points.empty()) {
+    return;
+  }
+
+  int lo[3], hi[3];
+  cell_of(p - Vector3D(radius, radius, radius), lo);
+  cell_of(p + Vector3D(radius, radius, radius), hi);
+  for (int z = lo[2]; z <= hi[2]; z++) {
+    for (int y = lo[1]; y <= hi[1]; y++) {
+      for (int x = lo[0]; x <= hi[0]; x++) {
+        size_t cell = cell_index(x, y, z);
+        for (size_t j = cell_start[cell]; j < cell_start[cell + 1]; j++) {
+          size_t i = cell_points[j];
+          if (((*points)[i] - p).norm() < radius) {
+            out.push_back(i);
+          }
+        }
+      }
+    }
+  }
+  std::sort(out.begin(), out.end());
+}
+
+} // namespace Misc
+} // namespace CGL
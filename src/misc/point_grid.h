@@ -0,0 +1,58 @@
+#ifndef CGL_UTIL_POINTGRID_H
+#define CGL_UTIL_POINTGRID_H
+
+#include <vector>
+
+#include "CGL/vector3D.h"
+
+namespace CGL {
+namespace Misc {
+
+/**
+ * A uniform grid over a fixed set of points, for nearest point and radius
+ * queries. Cells hold the indices of their points in increasing order, and
+ * cells are sized so that each one holds about one point on average.
+ *
+ * The grid keeps a pointer to the points given to build(), which must stay
+ * alive and unchanged while the grid is queried.
+ */
+class PointGrid {
+public:
+  static const size_t npos = (size_t)-1;
+
+  void build(const std::vector<Vector3D> &points);
+
+  /**
+   * Index of a point closest to p (npos if there are no points), and its
+   * distance. The distance is exact; among equally close points any one
+   * may be returned.
+   */
+  size_t nearest(const Vector3D &p, double &dist) const;
+
+  /**
+   * Replaces out with the indices of all points closer than radius to p,
+   * in increasing order.
+   */
+  void within(const Vector3D &p, double radius, std::vector<size_t> &out) const;
+
+private:
+  void cell_of(const Vector3D &p, int cell[3]) const;
+  size_t cell_index(int x, int y, int z) const {
+    return ((size_t)z * dims[1] + y) * dims[0] + x;
+  }
+  // Scans one cell, keeping the closest point found so far.
+  void scan_cell(size_t cell, const Vector3D &p, size_t &best,
+                 double &best_dist) const;
+
+  const std::vector<Vector3D> *points = nullptr;
+  Vector3D origin;
+  double cell_size = 1.;
+  int dims[3] = {0, 0, 0};
+  std::vector<size_t> cell_start;  // points of cell c: cell_start[c] .. cell_start[c+1]-1
+  std::vector<size_t> cell_points; // point indices, grouped by cell
+};
+
+} // namespace Misc
+} // namespace CGL
+
+#endif // CGL_UTIL_POINTGRID_H
@@ -0,0 +1,87 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+namespace CGL {
+namespace Misc {
+
+Profiler &Profiler::global() {
+  static Profiler profiler;
+  return profiler;
+}
+
+void Profiler::record(const std::string &stage, double ms) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  auto it = histories.find(stage);
+  if (it == histories.end()) {
+    it = histories.emplace(stage, History()).first;
+    it->second.samples.reserve(history_size);
+    order.push_back(stage);
+  }
+
+  History &history = it->second;
+  if (history.samples.size() < history_size) {
+    history.samples.push_back(ms);
+  } else {
+    history.samples[history.next] = ms;
+  }
+  history.next = (history.next + 1) % history_size;
+  history.calls++;
+}
+
+std::vector<Profiler::Stats> Profiler::stats() const {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  std::vector<Stats> result;
+  std::vector<double> sorted;
+  for (const std::string &stage : order) {
+    const History &history = histories.at(stage);
+    sorted = history.samples;
+    std::sort(sorted.begin(), sorted.end());
+
+    double sum = 0;
+    for (double ms : sorted) {
+      sum += ms;
+    }
+
+    // Nearest-rank percentile
+    size_t rank = (size_t)std::ceil(0.99 * sorted.size());
+    size_t last = (history.next + history_size - 1) % history_size;
+
+    Stats s;
+    s.stage = stage;
+    s.calls = history.calls;
+    s.last = history.samples[last];
+    s.min = sorted.front();
+    s.avg = sum / sorted.size();
+    s.p99 = sorted[std::max<size_t>(rank, 1) - 1];
+    result.push_back(s);
+  }
+  return result;
+}
+
+void Profiler::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+  order.clear();
+  histories.clear();
+}
+
+bool Profiler::write_csv(const std::string &filename) const {
+  std::ofstream file(filename);
+  if (!file) {
+    return false;
+  }
+
+  file << "stage,calls,last_ms,min_ms,avg_ms,p99_ms\n";
+  for (const Stats &s : stats()) {
+    file << s.stage << "," << s.calls << "," << s.last << "," << s.min << ","
+         << s.avg << "," << s.p99 << "\n";
+  }
+  return (bool)file;
+}
+
+} // namespace Misc
+} // namespace CGL
@@ -0,0 +1,89 @@
+#ifndef CGL_UTIL_PROFILER_H
+#define CGL_UTIL_PROFILER_H
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "trace_recorder.h"
+
+namespace CGL {
+namespace Misc {
+
+/**
+ * Rolling timings of named stages. Every stage keeps its last history_size
+ * samples (in milliseconds), from which min/avg/p99 are computed on demand.
+ * Stages are listed in the order they were first recorded. Safe to record
+ * from several threads.
+ */
+class Profiler {
+public:
+  struct Stats {
+    std::string stage;
+    size_t calls;  // samples recorded in total, not just in the history
+    double last;
+    double min;
+    double avg;
+    double p99;
+  };
+
+  // The profiler the pipeline stages report to
+  static Profiler &global();
+
+  Profiler(size_t history_size = 240) : history_size(history_size) {}
+
+  void record(const std::string &stage, double ms);
+  std::vector<Stats> stats() const;
+  void clear();
+
+  // One line per stage: stage,calls,last_ms,min_ms,avg_ms,p99_ms
+  bool write_csv(const std::string &filename) const;
+
+  bool enabled = true;
+
+private:
+  struct History {
+    std::vector<double> samples; // ring buffer of the latest samples
+    size_t next = 0;
+    size_t calls = 0;
+  };
+
+  size_t history_size;
+  mutable std::mutex mutex;
+  std::vector<std::string> order;
+  std::unordered_map<std::string, History> histories;
+};
+
+/**
+ * Records the time between its construction and destruction as one sample
+ * of `stage`, and as a begin/end pair in the global trace. The name must
+ * outlive the trace, so pass a string literal.
+ */
+class ScopedTimer {
+public:
+  ScopedTimer(const char *stage, Profiler &profiler = Profiler::global())
+      : stage(stage), profiler(profiler),
+        start(std::chrono::steady_clock::now()) {
+    TraceRecorder::global().begin(stage);
+  }
+  ~ScopedTimer() {
+    TraceRecorder::global().end(stage);
+    if (profiler.enabled) {
+      std::chrono::duration<double, std::milli> elapsed =
+          std::chrono::steady_clock::now() - start;
+      profiler.record(stage, elapsed.count());
+    }
+  }
+
+private:
+  const char *stage;
+  Profiler &profiler;
+  std::chrono::steady_clock::time_point start;
+};
+
+} // namespace Misc
+} // namespace CGL
+
+#endif // CGL_UTIL_PROFILER_H
@@ -0,0 +1,158 @@
+#include "sphere_bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace CGL {
+namespace Misc {
+
+const size_t SphereBVH::npos;
+
+// Spheres per leaf at most.
+static const uint32_t leaf_size = 4;
+
+void SphereBVH::build(const std::vector<Vector3D> &centers, const std::vector<double> &radii) {
+  this->centers = centers;
+  this->radii = radii;
+  nodes.clear();
+  order.resize(centers.size());
+  for (uint32_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  if (!order.empty()) {
+    nodes.reserve(2 * order.size() / leaf_size + 1);
+    build_node(0, (uint32_t)order.size());
+  }
+}
+
+BBox SphereBVH::sphere_bounds(uint32_t sphere) const {
+  Vector3D r(radii[sphere]);
+  return BBox(centers[sphere] - r, centers[sphere] + r);
+}
+
+uint32_t SphereBVH::build_node(uint32_t start, uint32_t end) {
+  uint32_t index = (uint32_t)nodes.size();
+  nodes.push_back(Node());
+
+  BBox bounds, centroid_bounds;
+  for (uint32_t i = start; i < end; i++) {
+    bounds.expand(sphere_bounds(order[i]));
+    centroid_bounds.expand(centers[order[i]]);
+  }
+  nodes[index].bounds = bounds;
+
+  if (end - start <= leaf_size) {
+    nodes[index].start = start;
+    nodes[index].count = end - start;
+    return index;
+  }
+
+  int axis = centroid_bounds.longest_axis();
+  uint32_t mid = start + (end - start) / 2;
+  std::nth_element(order.begin() + start, order.begin() + mid, order.begin() + end,
+                   [&](uint32_t a, uint32_t b) { return centers[a][axis] < centers[b][axis]; });
+
+  // The depth is logarithmic, recursing is fine here
+  build_node(start, mid);
+  uint32_t second = build_node(mid, end);
+  nodes[index].start = 0;
+  nodes[index].count = 0;
+  nodes[index].second = second;
+  return index;
+}
+
+void SphereBVH::refit(const std::vector<Vector3D> &centers, const std::vector<double> &radii) {
+  this->centers = centers;
+  this->radii = radii;
+
+  // Children always come after their parent
+  for (size_t i = nodes.size(); i-- > 0;) {
+    Node &node = nodes[i];
+    BBox bounds;
+    if (node.count > 0) {
+      for (uint32_t j = node.start; j < node.start + node.count; j++) {
+        bounds.expand(sphere_bounds(order[j]));
+      }
+    } else {
+      bounds.expand(nodes[i + 1].bounds);
+      bounds.expand(nodes[node.second].bounds);
+    }
+    node.bounds = bounds;
+  }
+}
+
+bool SphereBVH::hit_sphere(const Ray &ray, uint32_t sphere, double &t) const {
+  // |o + t d - c|^2 = r^2
+  Vector3D oc = ray.o - centers[sphere];
+  double a = dot(ray.d, ray.d);
+  double b = dot(oc, ray.d);
+  double c = dot(oc, oc) - radii[sphere] * radii[sphere];
+  double discriminant = b * b - a * c;
+  if (discriminant < 0.) {
+    return false;
+  }
+  double root = std::sqrt(discriminant);
+  double t_near = (-b - root) / a;
+  double t_far = (-b + root) / a;
+  if (t_far < 0.) {
+    return false;
+  }
+  t = t_near >= 0. ? t_near : t_far;
+  return true;
+}
+
+size_t SphereBVH::intersect(const Ray &ray, double &t) const {
+  size_t best = npos;
+  double best_t = std::numeric_limits<double>::infinity();
+  if (nodes.empty()) {
+    return npos;
+  }
+
+  // Nearer child first, so that most far subtrees are pruned by best_t
+  uint32_t stack[64];
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const Node &node = nodes[stack[--top]];
+    double t0 = 0., t1 = best_t;
+    if (!node.bounds.intersect(ray, t0, t1)) {
+      continue;
+    }
+
+    if (node.count > 0) {
+      for (uint32_t j = node.start; j < node.start + node.count; j++) {
+        double hit;
+        if (hit_sphere(ray, order[j], hit) && hit < best_t) {
+          best_t = hit;
+          best = order[j];
+        }
+      }
+      continue;
+    }
+
+    uint32_t first = (uint32_t)(&node - nodes.data()) + 1;
+    uint32_t second = node.second;
+    double first_t0 = 0., first_t1 = best_t, second_t0 = 0., second_t1 = best_t;
+    bool first_hit = nodes[first].bounds.intersect(ray, first_t0, first_t1);
+    bool second_hit = nodes[second].bounds.intersect(ray, second_t0, second_t1);
+    if (first_hit && second_hit && second_t0 < first_t0) {
+      std::swap(first, second);
+    }
+    // Pushed far to near
+    if (first_hit && second_hit) {
+      stack[top++] = second;
+      stack[top++] = first;
+    } else if (first_hit) {
+      stack[top++] = first;
+    } else if (second_hit) {
+      stack[top++] = second;
+    }
+  }
+
+  t = best_t;
+  return best;
+}
+
+} // namespace Misc
+} // namespace CGL
@@ -0,0 +1,62 @@
+#ifndef CGL_UTIL_SPHEREBVH_H
+#define CGL_UTIL_SPHEREBVH_H
+
+#include <vector>
+#include <stdint.h>
+
+#include "CGL/vector3D.h"
+#include "bbox.h"
+
+namespace CGL {
+namespace Misc {
+
+/**
+ * Bounding volume hierarchy over a set of spheres, for ray picking.
+ *
+ * Built top down by splitting the sphere centers at the median of the
+ * longest axis, so the depth stays logarithmic. Nodes are stored in
+ * depth-first order, the first child right after its parent; refit() walks
+ * them backwards to update the bounds after the spheres moved without
+ * rebuilding the tree.
+ */
+class SphereBVH {
+public:
+  static const size_t npos = (size_t)-1;
+
+  void build(const std::vector<Vector3D> &centers, const std::vector<double> &radii);
+
+  /**
+   * Same spheres in the same order, with new centers and radii.
+   */
+  void refit(const std::vector<Vector3D> &centers, const std::vector<double> &radii);
+
+  /**
+   * Index of the sphere the ray enters first (npos if it hits none) and the
+   * distance t to it. A ray starting inside a sphere hits it at its exit.
+   */
+  size_t intersect(const Ray &ray, double &t) const;
+
+  size_t size() const { return centers.size(); }
+
+private:
+  struct Node {
+    BBox bounds;
+    uint32_t start;  ///< first entry of order for a leaf
+    uint32_t count;  ///< spheres in a leaf, 0 for an inner node
+    uint32_t second; ///< second child of an inner node, the first is next
+  };
+
+  uint32_t build_node(uint32_t start, uint32_t end);
+  BBox sphere_bounds(uint32_t sphere) const;
+  bool hit_sphere(const Ray &ray, uint32_t sphere, double &t) const;
+
+  std::vector<Node> nodes;
+  std::vector<uint32_t> order; ///< sphere indices, grouped by leaf
+  std::vector<Vector3D> centers;
+  std::vector<double> radii;
+};
+
+} // namespace Misc
+} // namespace CGL
+
+#endif // CGL_UTIL_SPHEREBVH_H
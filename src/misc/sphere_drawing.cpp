@@ -1,4 +1,5 @@
 #include <cmath>
+#include <algorithm>
 #include <nanogui/nanogui.h>
 
 #include "sphere_drawing.h"
@@ -167,5 +168,43 @@ void SphereMesh::draw_sphere(GLShader &shader, const Vector3D &p, double r, nano
   shader.drawArray(GL_TRIANGLES, 0, sphere_num_indices);
 }
 
+SphereInstances::SphereInstances(int num_lat, int num_lon)
+: sphere(num_lat, num_lon) {
+}
+
+void SphereInstances::add(const Vector3D &p, double r, nanogui::Color color) {
+  if (count == (size_t) centers.cols()) {
+    size_t capacity = std::max<size_t>(64, 2 * count);
+    centers.conservativeResize(4, capacity);
+    colors.conservativeResize(4, capacity);
+  }
+
+  centers.col(count) << p.x, p.y, p.z, r;
+  colors.col(count) << color.r(), color.g(), color.b(), color.w();
+  count++;
+}
+
+void SphereInstances::draw(GLShader &shader) {
+  if (count == 0) {
+    return;
+  }
+
+  // The unit sphere never changes, upload it the first time only
+  if (shader.attribVersion("in_position") != 1) {
+    shader.uploadAttrib("in_position", sphere.get_positions(), 1);
+    shader.uploadAttrib("in_normal", sphere.get_normals(), 1);
+  }
+
+  shader.uploadAttrib("in_center", MatrixXf(centers.leftCols(count)));
+  shader.uploadAttrib("in_color", MatrixXf(colors.leftCols(count)));
+
+  // One step through the instance attributes per sphere, not per vertex
+  glVertexAttribDivisor(shader.attrib("in_center"), 1);
+  glVertexAttribDivisor(shader.attrib("in_color"), 1);
+
+  glDrawArraysInstanced(GL_TRIANGLES, 0, sphere.num_vertices(), (GLsizei) count);
+  count = 0;
+}
+
 } // namespace Misc
 } // namespace CGL
@@ -23,6 +23,11 @@ public:
    * current modelview/projection matrices and color/material settings.
    */
   void draw_sphere(GLShader &shader, const Vector3D &p, double r, nanogui::Color color);
+
+  // Unrolled triangle list of the unit sphere
+  const MatrixXf &get_positions() const { return positions; }
+  const MatrixXf &get_normals() const { return normals; }
+  int num_vertices() const { return sphere_num_indices; }
 private:
   std::vector<unsigned int> Indices;
   std::vector<double> Vertices;
@@ -44,6 +49,29 @@ private:
 };
 
 
+/**
+ * Draws many spheres with a single instanced call. The unit sphere is uploaded
+ * once; every sphere only adds a center, radius and color to the instance
+ * buffer. Needs a shader with per-instance in_center (xyz + radius) and
+ * in_color attributes, see shaders/instanced/Sphere.vert.
+ */
+class SphereInstances {
+public:
+  SphereInstances(int num_lat = 15, int num_lon = 15);
+
+  void clear() { count = 0; }
+  void add(const Vector3D &p, double r, nanogui::Color color);
+  size_t size() const { return count; }
+
+  // Draws (and then clears) the queued spheres with `shader`, which must be bound
+  void draw(GLShader &shader);
+private:
+  SphereMesh sphere;
+  MatrixXf centers;
+  MatrixXf colors;
+  size_t count = 0;
+};
+
 } // namespace Misc
 } // namespace CGL
 
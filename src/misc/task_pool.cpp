@@ -0,0 +1,124 @@
+#include "task_pool.h"
+
+#include <algorithm>
+
+namespace CGL {
+namespace Misc {
+
+// Which pool (if any) the current thread works for, and its queue there.
+static thread_local const TaskPool *current_pool = nullptr;
+static thread_local size_t current_index = 0;
+
+TaskPool::TaskPool(size_t num_threads) {
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  for (size_t i = 0; i < num_threads; i++) {
+    queues.push_back(std::unique_ptr<Queue>(new Queue()));
+  }
+  for (size_t i = 0; i < num_threads; i++) {
+    workers.push_back(std::thread(&TaskPool::worker_loop, this, i));
+  }
+}
+
+TaskPool::~TaskPool() {
+  wait();
+  {
+    std::lock_guard<std::mutex> lock(state_mutex);
+    quitting = true;
+  }
+  work_ready.notify_all();
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+}
+
+void TaskPool::submit(std::function<void()> task) {
+  {
+    // Counted under the same lock as the push, so a worker can never take
+    // the task before it is counted
+    std::lock_guard<std::mutex> lock(state_mutex);
+    size_t index;
+    if (current_pool == this) {
+      index = current_index;
+    } else {
+      index = next_queue;
+      next_queue = (next_queue + 1) % queues.size();
+    }
+    {
+      std::lock_guard<std::mutex> queue_lock(queues[index]->mutex);
+      queues[index]->tasks.push_back(std::move(task));
+    }
+    queued++;
+    unfinished++;
+  }
+  work_ready.notify_one();
+}
+
+void TaskPool::wait() {
+  std::unique_lock<std::mutex> lock(state_mutex);
+  all_done.wait(lock, [this] { return unfinished == 0; });
+}
+
+size_t TaskPool::steals() const {
+  std::lock_guard<std::mutex> lock(state_mutex);
+  return steal_count;
+}
+
+bool TaskPool::pop(size_t worker_index, std::function<void()> &task) {
+  bool stolen = false;
+  bool found = false;
+
+  // Own deque from the back (newest first, still warm in cache), then the
+  // other deques from the front
+  for (size_t i = 0; i < queues.size() && !found; i++) {
+    Queue &queue = *queues[(worker_index + i) % queues.size()];
+    std::lock_guard<std::mutex> queue_lock(queue.mutex);
+    if (queue.tasks.empty()) continue;
+
+    if (i == 0) {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    } else {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+      stolen = true;
+    }
+    found = true;
+  }
+
+  if (found) {
+    std::lock_guard<std::mutex> lock(state_mutex);
+    queued--;
+    if (stolen) steal_count++;
+  }
+  return found;
+}
+
+void TaskPool::worker_loop(size_t worker_index) {
+  current_pool = this;
+  current_index = worker_index;
+
+  while (true) {
+    std::function<void()> task;
+    if (pop(worker_index, task)) {
+      task();
+
+      bool last;
+      {
+        std::lock_guard<std::mutex> lock(state_mutex);
+        last = (--unfinished == 0);
+      }
+      if (last) all_done.notify_all();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(state_mutex);
+    work_ready.wait(lock, [this] { return quitting || queued > 0; });
+    if (quitting && queued == 0) return;
+  }
+}
+
+} // namespace Misc
+} // namespace CGL
@@ -0,0 +1,66 @@
+#ifndef CGL_UTIL_TASKPOOL_H
+#define CGL_UTIL_TASKPOOL_H
+
+#include <deque>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace CGL {
+namespace Misc {
+
+/**
+ * Persistent worker threads for independent tasks of uneven length.
+ *
+ * Every worker owns a deque. It runs its own newest task first and, once the
+ * deque is empty, steals the oldest task of another worker, so a few long
+ * tasks do not leave the other threads idle. Tasks submitted from outside are
+ * dealt round-robin; tasks submitted from inside a task go to the submitting
+ * worker's own deque. Tasks must not throw.
+ */
+class TaskPool {
+public:
+  // 0 picks the hardware concurrency. The caller does not run tasks.
+  TaskPool(size_t num_threads = 0);
+  ~TaskPool();
+
+  size_t num_threads() const { return workers.size(); }
+
+  void submit(std::function<void()> task);
+
+  // Blocks until every task submitted so far (and everything they submit)
+  // has finished.
+  void wait();
+
+  // Tasks taken from another worker's deque so far
+  size_t steals() const;
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  bool pop(size_t worker_index, std::function<void()> &task);
+  void worker_loop(size_t worker_index);
+
+  std::vector<std::unique_ptr<Queue>> queues; // one per worker
+  std::vector<std::thread> workers;
+
+  mutable std::mutex state_mutex; // guards everything below
+  std::condition_variable work_ready;
+  std::condition_variable all_done;
+  size_t queued = 0;     // tasks sitting in some deque
+  size_t unfinished = 0; // tasks queued or running
+  size_t next_queue = 0;
+  size_t steal_count = 0;
+  bool quitting = false;
+};
+
+} // namespace Misc
+} // namespace CGL
+
+#endif // CGL_UTIL_TASKPOOL_H
@@ -0,0 +1,132 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace CGL {
+namespace Misc {
+
+// Set on pool workers, so that nested parallel_for calls run inline instead
+// of waiting on the (busy) pool.
+static thread_local bool inside_worker = false;
+
+// Bounds of chunk i when [begin, end) is cut into n nearly equal pieces.
+static void chunk_bounds(size_t begin, size_t end, size_t n, size_t i,
+                         size_t &chunk_begin, size_t &chunk_end) {
+  size_t count = end - begin;
+  chunk_begin = begin + count * i / n;
+  chunk_end = begin + count * (i + 1) / n;
+}
+
+ThreadPool::ThreadPool(size_t num_threads) {
+  start(num_threads);
+}
+
+ThreadPool::~ThreadPool() {
+  stop();
+}
+
+void ThreadPool::set_num_threads(size_t num_threads) {
+  std::lock_guard<std::mutex> job_lock(job_mutex);
+  stop();
+  start(num_threads);
+}
+
+void ThreadPool::start(size_t num_threads) {
+  if (num_threads == 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  // Workers started by set_num_threads() must not pick up the last job again
+  unsigned long long generation;
+  {
+    std::lock_guard<std::mutex> lock(state_mutex);
+    quitting = false;
+    generation = job_generation;
+  }
+  for (size_t i = 1; i < num_threads; i++) {
+    workers.push_back(std::thread(&ThreadPool::worker_loop, this, i, generation));
+  }
+}
+
+void ThreadPool::stop() {
+  {
+    std::lock_guard<std::mutex> lock(state_mutex);
+    quitting = true;
+  }
+  job_ready.notify_all();
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+  workers.clear();
+}
+
+void ThreadPool::parallel_for(size_t begin, size_t end,
+                              const std::function<void(size_t, size_t, size_t)> &fn,
+                              size_t min_chunk) {
+  if (end <= begin) return;
+
+  size_t chunks = std::min(num_threads(), (end - begin + min_chunk - 1) / std::max<size_t>(min_chunk, 1));
+  if (chunks <= 1 || inside_worker) {
+    fn(begin, end, 0);
+    return;
+  }
+
+  std::lock_guard<std::mutex> job_lock(job_mutex);
+  {
+    std::lock_guard<std::mutex> lock(state_mutex);
+    job_fn = &fn;
+    job_begin = begin;
+    job_end = end;
+    job_chunks = chunks;
+    pending = chunks - 1;
+    job_generation++;
+  }
+  job_ready.notify_all();
+
+  // The calling thread takes the first chunk, and is as busy as the workers
+  // while it runs it
+  size_t chunk_begin, chunk_end;
+  chunk_bounds(begin, end, chunks, 0, chunk_begin, chunk_end);
+  inside_worker = true;
+  fn(chunk_begin, chunk_end, 0);
+  inside_worker = false;
+
+  std::unique_lock<std::mutex> lock(state_mutex);
+  job_done.wait(lock, [this] { return pending == 0; });
+  job_fn = nullptr;
+}
+
+void ThreadPool::worker_loop(size_t thread_index, unsigned long long seen_generation) {
+  inside_worker = true;
+
+  while (true) {
+    const std::function<void(size_t, size_t, size_t)> *fn;
+    size_t chunk_begin, chunk_end;
+    {
+      std::unique_lock<std::mutex> lock(state_mutex);
+      job_ready.wait(lock, [this, seen_generation] {
+        return quitting || job_generation != seen_generation;
+      });
+      if (quitting) return;
+      seen_generation = job_generation;
+
+      // Not every worker is needed for short ranges
+      if (thread_index >= job_chunks) continue;
+
+      fn = job_fn;
+      chunk_bounds(job_begin, job_end, job_chunks, thread_index, chunk_begin, chunk_end);
+    }
+
+    (*fn)(chunk_begin, chunk_end, thread_index);
+
+    bool last;
+    {
+      std::lock_guard<std::mutex> lock(state_mutex);
+      last = (--pending == 0);
+    }
+    if (last) job_done.notify_one();
+  }
+}
+
+} // namespace Misc
+} // namespace CGL
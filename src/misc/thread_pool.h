@@ -0,0 +1,64 @@
+#ifndef CGL_UTIL_THREADPOOL_H
+#define CGL_UTIL_THREADPOOL_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace CGL {
+namespace Misc {
+
+/**
+ * A small pool of persistent worker threads for data-parallel loops.
+ *
+ * parallel_for() cuts an index range into one contiguous chunk per thread
+ * (the calling thread works on the first chunk) and returns once every chunk
+ * is done. The chunking only depends on the range and the thread count, so
+ * a loop whose iterations write disjoint outputs gives the same result no
+ * matter how many threads run it.
+ */
+class ThreadPool {
+public:
+  // num_threads counts the calling thread; 0 picks the hardware concurrency.
+  ThreadPool(size_t num_threads = 0);
+  ~ThreadPool();
+
+  void set_num_threads(size_t num_threads);
+  size_t num_threads() const { return workers.size() + 1; }
+
+  /**
+   * Runs fn(chunk_begin, chunk_end, thread_index) over [begin, end). Ranges
+   * shorter than min_chunk per thread use fewer threads, and calls made from
+   * inside a worker simply run serially.
+   */
+  void parallel_for(size_t begin, size_t end,
+                    const std::function<void(size_t, size_t, size_t)> &fn,
+                    size_t min_chunk = 1024);
+
+private:
+  void start(size_t num_threads);
+  void stop();
+  void worker_loop(size_t thread_index, unsigned long long seen_generation);
+
+  std::vector<std::thread> workers;
+
+  std::mutex job_mutex;      // serializes parallel_for calls
+  std::mutex state_mutex;    // guards everything below
+  std::condition_variable job_ready;
+  std::condition_variable job_done;
+
+  const std::function<void(size_t, size_t, size_t)> *job_fn = nullptr;
+  size_t job_begin = 0;
+  size_t job_end = 0;
+  size_t job_chunks = 0;
+  unsigned long long job_generation = 0;
+  size_t pending = 0;
+  bool quitting = false;
+};
+
+} // namespace Misc
+} // namespace CGL
+
+#endif // CGL_UTIL_THREADPOOL_H
@@ -0,0 +1,176 @@
+#include "trace_recorder.h"
+
+#include <cstdio>
+#include <fstream>
+
+namespace CGL {
+namespace Misc {
+
+TraceRecorder &TraceRecorder::global() {
+  static TraceRecorder recorder;
+  return recorder;
+}
+
+TraceRecorder::TraceRecorder(size_t events_per_thread)
+    : enabled(true), events_per_thread(events_per_thread),
+      epoch(std::chrono::steady_clock::now()), buffers(new Buffers()) {}
+
+struct TraceRecorder::ThreadBuffers {
+  struct Entry {
+    const Buffers *owner;        // only compared, may be dangling
+    std::weak_ptr<Buffers> alive;
+    ThreadBuffer *buffer;
+  };
+  std::vector<Entry> entries;
+
+  ~ThreadBuffers() {
+    for (const Entry &entry : entries) {
+      std::shared_ptr<Buffers> owner = entry.alive.lock();
+      if (owner) {
+        std::lock_guard<std::mutex> lock(owner->mutex);
+        owner->free.push_back(entry.buffer);
+      }
+    }
+  }
+};
+
+TraceRecorder::ThreadBuffer *TraceRecorder::thread_buffer() {
+  // One buffer per thread and recorder; threads rarely use more than the
+  // global one, so a short list is enough. A destroyed recorder's entry is
+  // dropped, as another one may since have been created at its address
+  static thread_local ThreadBuffers cache;
+  for (size_t i = 0; i < cache.entries.size(); i++) {
+    if (cache.entries[i].owner != buffers.get()) {
+      continue;
+    }
+    if (!cache.entries[i].alive.expired()) {
+      return cache.entries[i].buffer;
+    }
+    cache.entries.erase(cache.entries.begin() + i);
+    break;
+  }
+
+  // A returned ring keeps its events and thread id, so the new thread's
+  // events follow those of the one that exited
+  std::lock_guard<std::mutex> lock(buffers->mutex);
+  ThreadBuffer *buffer;
+  if (!buffers->free.empty()) {
+    buffer = buffers->free.back();
+    buffers->free.pop_back();
+  } else {
+    buffers->all.emplace_back(new ThreadBuffer());
+    buffer = buffers->all.back().get();
+    buffer->slots.reset(new Slot[events_per_thread]);
+    for (size_t i = 0; i < events_per_thread; i++) {
+      buffer->slots[i].sequence = 0;
+    }
+    buffer->head = 0;
+    buffer->thread_id = buffers->all.size();
+  }
+  ThreadBuffers::Entry entry = {buffers.get(), buffers, buffer};
+  cache.entries.push_back(entry);
+  return buffer;
+}
+
+void TraceRecorder::record(const char *name, char phase) {
+  if (!enabled.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  std::chrono::duration<double, std::micro> elapsed =
+      std::chrono::steady_clock::now() - epoch;
+
+  // Only this thread writes to its buffer. The slot reads as being written
+  // until its new sequence is stored, and publishing the new head makes the
+  // event visible to write_json()
+  ThreadBuffer *buffer = thread_buffer();
+  unsigned long long head = buffer->head.load(std::memory_order_relaxed);
+  Slot &slot = buffer->slots[head % events_per_thread];
+  slot.sequence.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.name.store(name, std::memory_order_relaxed);
+  slot.phase.store(phase, std::memory_order_relaxed);
+  slot.timestamp.store(elapsed.count(), std::memory_order_relaxed);
+  slot.sequence.store(head + 1, std::memory_order_release);
+  buffer->head.store(head + 1, std::memory_order_release);
+}
+
+// Event names are identifiers, but keep the output valid JSON regardless
+static void write_escaped(std::ofstream &file, const char *s) {
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\') {
+      file << '\\' << *s;
+    } else if ((unsigned char)*s < 0x20) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", *s);
+      file << buf;
+    } else {
+      file << *s;
+    }
+  }
+}
+
+bool TraceRecorder::write_json(const std::string &filename) const {
+  std::ofstream file(filename);
+  if (!file) {
+    return false;
+  }
+
+  std::vector<ThreadBuffer *> snapshot;
+  {
+    std::lock_guard<std::mutex> lock(buffers->mutex);
+    for (const auto &buffer : buffers->all) {
+      snapshot.push_back(buffer.get());
+    }
+  }
+
+  file << "{\"traceEvents\":[\n";
+  bool first = true;
+  std::vector<Event> events;
+  for (ThreadBuffer *buffer : snapshot) {
+    unsigned long long head = buffer->head.load(std::memory_order_acquire);
+    unsigned long long begin = head > events_per_thread ? head - events_per_thread : 0;
+
+    // The thread may overwrite the oldest events while we copy them: a slot
+    // is kept only if it held event i before and after the copy
+    events.clear();
+    for (unsigned long long i = begin; i < head; i++) {
+      const Slot &slot = buffer->slots[i % events_per_thread];
+      if (slot.sequence.load(std::memory_order_acquire) != i + 1) {
+        continue;
+      }
+      Event event;
+      event.name = slot.name.load(std::memory_order_relaxed);
+      event.phase = slot.phase.load(std::memory_order_relaxed);
+      event.timestamp = slot.timestamp.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.sequence.load(std::memory_order_relaxed) != i + 1) {
+        continue;
+      }
+      events.push_back(event);
+    }
+
+    for (size_t i = 0; i < events.size(); i++) {
+      char timestamp[32];
+      snprintf(timestamp, sizeof(timestamp), "%.3f", events[i].timestamp);
+
+      file << (first ? "" : ",\n") << "{\"name\":\"";
+      write_escaped(file, events[i].name);
+      file << "\",\"ph\":\"" << events[i].phase << "\",\"ts\":" << timestamp
+           << ",\"pid\":1,\"tid\":" << buffer->thread_id << "}";
+      first = false;
+    }
+  }
+  file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+  return (bool)file;
+}
+
+void TraceRecorder::clear() {
+  std::lock_guard<std::mutex> lock(buffers->mutex);
+  for (const auto &buffer : buffers->all) {
+    buffer->head = 0;
+  }
+}
+
+} // namespace Misc
+} // namespace CGL
@@ -0,0 +1,93 @@
+#ifndef CGL_UTIL_TRACERECORDER_H
+#define CGL_UTIL_TRACERECORDER_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace CGL {
+namespace Misc {
+
+/**
+ * Collects begin/end events in the Chrome trace_event format, for loading
+ * into chrome://tracing or Perfetto.
+ *
+ * Every thread writes into its own fixed size ring buffer, so recording is
+ * lock-free once a thread has registered its buffer (on its first event).
+ * When a ring is full the oldest events are overwritten. A thread hands its
+ * ring back when it exits and the next new thread records into it, so the
+ * memory held grows with the number of threads recording at once rather
+ * than with every thread ever started.
+ *
+ * write_json() may run while other threads keep recording; events
+ * overwritten during the flush are left out, as every slot carries the
+ * index of the event it holds and is only kept if that did not change while
+ * it was copied.
+ */
+class TraceRecorder {
+public:
+  // The recorder the pipeline stages report to
+  static TraceRecorder &global();
+
+  TraceRecorder(size_t events_per_thread = 1 << 15);
+
+  // Event names are not copied and must outlive the recorder
+  void begin(const char *name) { record(name, 'B'); }
+  void end(const char *name) { record(name, 'E'); }
+
+  // Writes every buffered event as {"traceEvents": [...]}
+  bool write_json(const std::string &filename) const;
+
+  // Forgets the buffered events (not thread-safe against recording threads)
+  void clear();
+
+  std::atomic<bool> enabled;
+
+private:
+  struct Event {
+    const char *name;
+    char phase;
+    double timestamp; // microseconds since the recorder was created
+  };
+
+  // An Event as stored in a ring, readable while its thread overwrites it
+  struct Slot {
+    std::atomic<unsigned long long> sequence; // event index + 1, 0 while written
+    std::atomic<const char *> name;
+    std::atomic<char> phase;
+    std::atomic<double> timestamp;
+  };
+
+  struct ThreadBuffer {
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<unsigned long long> head; // events ever written
+    size_t thread_id;
+  };
+
+  // The rings of one recorder, shared with the exiting threads that return
+  // theirs so the recorder may be destroyed first
+  struct Buffers {
+    std::mutex mutex; // guards registration only
+    std::vector<std::unique_ptr<ThreadBuffer>> all;
+    std::vector<ThreadBuffer *> free; // rings of threads that have exited
+  };
+
+  // The rings a thread records into, returned to their recorders on exit
+  struct ThreadBuffers;
+
+  void record(const char *name, char phase);
+  ThreadBuffer *thread_buffer();
+
+  size_t events_per_thread;
+  std::chrono::steady_clock::time_point epoch;
+
+  std::shared_ptr<Buffers> buffers;
+};
+
+} // namespace Misc
+} // namespace CGL
+
+#endif // CGL_UTIL_TRACERECORDER_H
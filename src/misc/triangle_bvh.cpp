@@ -0,0 +1,429 @@
+#include "triangle_bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace CGL {
+namespace Misc {
+
+const size_t TriangleBVH::npos;
+
+// Centroid bins tried per axis by the surface area heuristic.
+static const int bin_count = 16;
+
+// Always split above this many triangles, never below two.
+static const uint32_t max_leaf_size = 8;
+
+// Past this depth the splits are median splits, which bound the depth (and
+// so the traversal stacks) whatever the input looks like.
+static const int sah_depth = 48;
+static const int stack_size = 128;
+
+// Slack on the far end of the slab test, against rounding in the test itself
+static const double slab_slack = 1. + 4. * std::numeric_limits<double>::epsilon();
+
+void TriangleBVH::build(const std::vector<Vector3D> &positions, const std::vector<uint32_t> &indices) {
+  this->positions = positions;
+  nodes.clear();
+
+  uint32_t count = (uint32_t)(indices.size() / 3);
+  std::vector<Triangle> input(count);
+  std::vector<BuildTriangle> build(count);
+  for (uint32_t i = 0; i < count; i++) {
+    Triangle &tri = input[i];
+    tri.v[0] = indices[3 * i];
+    tri.v[1] = indices[3 * i + 1];
+    tri.v[2] = indices[3 * i + 2];
+    tri.index = i;
+    build[i].bounds = triangle_bounds(tri);
+    build[i].centroid = build[i].bounds.centroid();
+    build[i].index = i;
+  }
+
+  if (count > 0) {
+    nodes.reserve(count);
+    build_node(build, 0, count, 0);
+  }
+
+  triangles.resize(count);
+  for (uint32_t i = 0; i < count; i++) {
+    triangles[i] = input[build[i].index];
+  }
+}
+
+void TriangleBVH::refit(const std::vector<Vector3D> &positions) {
+  this->positions = positions;
+
+  // Children always come after their parent
+  for (size_t i = nodes.size(); i-- > 0;) {
+    Node &node = nodes[i];
+    BBox bounds;
+    if (node.count > 0) {
+      for (uint32_t j = node.offset; j < node.offset + node.count; j++) {
+        bounds.expand(triangle_bounds(triangles[j]));
+      }
+    } else {
+      bounds.expand(node_bounds(nodes[i + 1]));
+      bounds.expand(node_bounds(nodes[node.offset]));
+    }
+    set_bounds(node, bounds);
+  }
+}
+
+uint32_t TriangleBVH::build_node(std::vector<BuildTriangle> &build, uint32_t start, uint32_t end, int depth) {
+  uint32_t index = (uint32_t)nodes.size();
+  nodes.push_back(Node());
+
+  BBox box, centroid_box;
+  for (uint32_t i = start; i < end; i++) {
+    box.expand(build[i].bounds);
+    centroid_box.expand(build[i].centroid);
+  }
+  set_bounds(nodes[index], box);
+
+  uint32_t count = end - start;
+  if (count <= 2) {
+    nodes[index].offset = start;
+    nodes[index].count = count;
+    return index;
+  }
+
+  Vector3D centroid_min = centroid_box.min;
+  Vector3D extent = centroid_box.extent();
+  uint32_t mid = start + count / 2;
+
+  if (depth >= sah_depth) {
+    int axis = centroid_box.longest_axis();
+    std::nth_element(build.begin() + start, build.begin() + mid, build.begin() + end,
+                     [axis](const BuildTriangle &a, const BuildTriangle &b) { return a.centroid[axis] < b.centroid[axis]; });
+  } else {
+    // Bin the centroids along all three axes in one pass
+    Vector3D scale;
+    for (int axis = 0; axis < 3; axis++) {
+      scale[axis] = extent[axis] > 0. ? bin_count / extent[axis] : 0.;
+    }
+    BBox bin_bounds[3][bin_count];
+    uint32_t bin_triangles[3][bin_count] = {{0}};
+    for (uint32_t i = start; i < end; i++) {
+      for (int axis = 0; axis < 3; axis++) {
+        int bin = std::min(bin_count - 1, (int)((build[i].centroid[axis] - centroid_min[axis]) * scale[axis]));
+        bin_bounds[axis][bin].expand(build[i].bounds);
+        bin_triangles[axis][bin]++;
+      }
+    }
+
+    // Cost of a split in units of one triangle test, the area of the parent
+    // factored out: one traversal step, then each side's triangles weighted
+    // by how likely a ray through the parent is to hit that side
+    int best_axis = -1;
+    int best_bin = 0;
+    double best_cost = std::numeric_limits<double>::infinity();
+    for (int axis = 0; axis < 3; axis++) {
+      if (!(extent[axis] > 0.)) {
+        continue;
+      }
+
+      // Bins [bin, bin_count) to the right of a split before `bin`
+      double right_area[bin_count];
+      uint32_t right_triangles[bin_count];
+      BBox right;
+      uint32_t right_count = 0;
+      for (int bin = bin_count - 1; bin > 0; bin--) {
+        right.expand(bin_bounds[axis][bin]);
+        right_count += bin_triangles[axis][bin];
+        right_area[bin] = right.surface_area();
+        right_triangles[bin] = right_count;
+      }
+
+      BBox left;
+      uint32_t left_count = 0;
+      for (int bin = 1; bin < bin_count; bin++) {
+        left.expand(bin_bounds[axis][bin - 1]);
+        left_count += bin_triangles[axis][bin - 1];
+        if (left_count == 0 || right_triangles[bin] == 0) {
+          continue;
+        }
+        double cost = left_count * left.surface_area() + right_triangles[bin] * right_area[bin];
+        if (cost < best_cost) {
+          best_cost = cost;
+          best_axis = axis;
+          best_bin = bin;
+        }
+      }
+    }
+
+    double area = box.surface_area();
+    bool split_pays = best_axis >= 0 && area + best_cost < count * area;
+    if (count <= max_leaf_size && !split_pays) {
+      nodes[index].offset = start;
+      nodes[index].count = count;
+      return index;
+    }
+
+    if (best_axis >= 0) {
+      double axis_min = centroid_min[best_axis], axis_scale = scale[best_axis];
+      mid = (uint32_t)(std::partition(build.begin() + start, build.begin() + end,
+                                      [&](const BuildTriangle &tri) {
+                                        int bin = std::min(bin_count - 1, (int)((tri.centroid[best_axis] - axis_min) * axis_scale));
+                                        return bin < best_bin;
+                                      }) -
+                       build.begin());
+    }
+    // else all the centroids coincide, any halving does
+  }
+
+  build_node(build, start, mid, depth + 1);
+  uint32_t second = build_node(build, mid, end, depth + 1);
+  nodes[index].offset = second;
+  nodes[index].count = 0;
+  return index;
+}
+
+void TriangleBVH::set_bounds(Node &node, const BBox &bounds) {
+  // Rounded outwards, so the node still contains everything in it
+  for (int axis = 0; axis < 3; axis++) {
+    float lo = (float)bounds.min[axis];
+    float hi = (float)bounds.max[axis];
+    node.min[axis] = lo > bounds.min[axis] ? std::nextafter(lo, -std::numeric_limits<float>::infinity()) : lo;
+    node.max[axis] = hi < bounds.max[axis] ? std::nextafter(hi, std::numeric_limits<float>::infinity()) : hi;
+  }
+}
+
+BBox TriangleBVH::node_bounds(const Node &node) {
+  return BBox(Vector3D(node.min[0], node.min[1], node.min[2]), Vector3D(node.max[0], node.max[1], node.max[2]));
+}
+
+BBox TriangleBVH::triangle_bounds(const Triangle &tri) const {
+  BBox bounds;
+  bounds.expand(positions[tri.v[0]]);
+  bounds.expand(positions[tri.v[1]]);
+  bounds.expand(positions[tri.v[2]]);
+  return bounds;
+}
+
+bool TriangleBVH::hit_node(const Node &node, const Ray &ray, double max_t, double &t) const {
+  double t0 = 0., t1 = max_t;
+  for (int axis = 0; axis < 3; axis++) {
+    double t_near = (node.min[axis] - ray.o[axis]) * ray.inv_d[axis];
+    double t_far = (node.max[axis] - ray.o[axis]) * ray.inv_d[axis];
+    if (t_near > t_far) {
+      std::swap(t_near, t_far);
+    }
+    t_far *= slab_slack;
+    t0 = t_near > t0 ? t_near : t0;
+    t1 = t_far < t1 ? t_far : t1;
+    if (t0 > t1) {
+      return false;
+    }
+  }
+  t = t0;
+  return true;
+}
+
+double TriangleBVH::node_distance2(const Node &node, const Vector3D &p) const {
+  double d2 = 0.;
+  for (int axis = 0; axis < 3; axis++) {
+    double d = 0.;
+    if (p[axis] < node.min[axis]) {
+      d = node.min[axis] - p[axis];
+    } else if (p[axis] > node.max[axis]) {
+      d = p[axis] - node.max[axis];
+    }
+    d2 += d * d;
+  }
+  return d2;
+}
+
+bool TriangleBVH::hit_triangle(const Ray &ray, const Triangle &tri, double &t) const {
+  // Moller-Trumbore, both sides
+  const Vector3D &p0 = positions[tri.v[0]];
+  Vector3D e1 = positions[tri.v[1]] - p0;
+  Vector3D e2 = positions[tri.v[2]] - p0;
+  Vector3D pvec = cross(ray.d, e2);
+  double det = dot(e1, pvec);
+  if (det == 0.) {
+    return false;
+  }
+  double inv_det = 1. / det;
+
+  Vector3D tvec = ray.o - p0;
+  double u = dot(tvec, pvec) * inv_det;
+  if (u < 0. || u > 1.) {
+    return false;
+  }
+  Vector3D qvec = cross(tvec, e1);
+  double v = dot(ray.d, qvec) * inv_det;
+  if (v < 0. || u + v > 1.) {
+    return false;
+  }
+  t = dot(e2, qvec) * inv_det;
+  return t >= 0.;
+}
+
+Vector3D TriangleBVH::closest_on_triangle(const Vector3D &p, const Triangle &tri) const {
+  // Ericson, Real-Time Collision Detection 5.1.5: find the Voronoi region
+  // of the triangle p lies in
+  const Vector3D &a = positions[tri.v[0]];
+  const Vector3D &b = positions[tri.v[1]];
+  const Vector3D &c = positions[tri.v[2]];
+  Vector3D ab = b - a, ac = c - a, ap = p - a;
+
+  double d1 = dot(ab, ap), d2 = dot(ac, ap);
+  if (d1 <= 0. && d2 <= 0.) {
+    return a;
+  }
+
+  Vector3D bp = p - b;
+  double d3 = dot(ab, bp), d4 = dot(ac, bp);
+  if (d3 >= 0. && d4 <= d3) {
+    return b;
+  }
+
+  double vc = d1 * d4 - d3 * d2;
+  if (vc <= 0. && d1 >= 0. && d3 <= 0.) {
+    return a + ab * (d1 / (d1 - d3));
+  }
+
+  Vector3D cp = p - c;
+  double d5 = dot(ab, cp), d6 = dot(ac, cp);
+  if (d6 >= 0. && d5 <= d6) {
+    return c;
+  }
+
+  double vb = d5 * d2 - d1 * d6;
+  if (vb <= 0. && d2 >= 0. && d6 <= 0.) {
+    return a + ac * (d2 / (d2 - d6));
+  }
+
+  double va = d3 * d6 - d5 * d4;
+  if (va <= 0. && d4 - d3 >= 0. && d5 - d6 >= 0.) {
+    return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+  }
+
+  double denom = va + vb + vc;
+  if (denom == 0.) {
+    // Degenerate triangle that slipped through: settle for a corner
+    return a;
+  }
+  return a + ab * (vb / denom) + ac * (vc / denom);
+}
+
+size_t TriangleBVH::intersect(const Ray &ray, double &t) const {
+  size_t best = npos;
+  double best_t = std::numeric_limits<double>::infinity();
+  double entry;
+  if (nodes.empty() || !hit_node(nodes[0], ray, best_t, entry)) {
+    t = best_t;
+    return npos;
+  }
+
+  // Nodes wait on the stack with the distance at which the ray enters them,
+  // and are dropped once something nearer was hit
+  uint32_t stack[stack_size];
+  double stack_t[stack_size];
+  int top = 0;
+  stack[top] = 0;
+  stack_t[top++] = entry;
+  while (top > 0) {
+    top--;
+    if (stack_t[top] > best_t) {
+      continue;
+    }
+    uint32_t index = stack[top];
+    const Node &node = nodes[index];
+
+    if (node.count > 0) {
+      for (uint32_t j = node.offset; j < node.offset + node.count; j++) {
+        double hit;
+        if (hit_triangle(ray, triangles[j], hit) && hit < best_t) {
+          best_t = hit;
+          best = triangles[j].index;
+        }
+      }
+      continue;
+    }
+
+    uint32_t first = index + 1, second = node.offset;
+    double first_t, second_t;
+    bool first_hit = hit_node(nodes[first], ray, best_t, first_t);
+    bool second_hit = hit_node(nodes[second], ray, best_t, second_t);
+    if (first_hit && second_hit && second_t < first_t) {
+      std::swap(first, second);
+      std::swap(first_t, second_t);
+    }
+    // Pushed far to near
+    if (first_hit && second_hit) {
+      stack[top] = second;
+      stack_t[top++] = second_t;
+      stack[top] = first;
+      stack_t[top++] = first_t;
+    } else if (first_hit) {
+      stack[top] = first;
+      stack_t[top++] = first_t;
+    } else if (second_hit) {
+      stack[top] = second;
+      stack_t[top++] = second_t;
+    }
+  }
+
+  t = best_t;
+  return best;
+}
+
+size_t TriangleBVH::closest_point(const Vector3D &p, Vector3D &closest) const {
+  size_t best = npos;
+  double best_d2 = std::numeric_limits<double>::infinity();
+  if (nodes.empty()) {
+    return npos;
+  }
+
+  // Same as intersect(), ordered by the distance to the node's bounds
+  uint32_t stack[stack_size];
+  double stack_d2[stack_size];
+  int top = 0;
+  stack[top] = 0;
+  stack_d2[top++] = node_distance2(nodes[0], p);
+  while (top > 0) {
+    top--;
+    if (stack_d2[top] >= best_d2) {
+      continue;
+    }
+    uint32_t index = stack[top];
+    const Node &node = nodes[index];
+
+    if (node.count > 0) {
+      for (uint32_t j = node.offset; j < node.offset + node.count; j++) {
+        Vector3D q = closest_on_triangle(p, triangles[j]);
+        double d2 = (q - p).norm2();
+        if (d2 < best_d2) {
+          best_d2 = d2;
+          best = triangles[j].index;
+          closest = q;
+        }
+      }
+      continue;
+    }
+
+    uint32_t first = index + 1, second = node.offset;
+    double first_d2 = node_distance2(nodes[first], p);
+    double second_d2 = node_distance2(nodes[second], p);
+    if (second_d2 < first_d2) {
+      std::swap(first, second);
+      std::swap(first_d2, second_d2);
+    }
+    if (second_d2 < best_d2) {
+      stack[top] = second;
+      stack_d2[top++] = second_d2;
+    }
+    if (first_d2 < best_d2) {
+      stack[top] = first;
+      stack_d2[top++] = first_d2;
+    }
+  }
+
+  return best;
+}
+
+} // namespace Misc
+} // namespace CGL
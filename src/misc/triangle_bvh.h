@@ -0,0 +1,95 @@
+#ifndef CGL_UTIL_TRIANGLEBVH_H
+#define CGL_UTIL_TRIANGLEBVH_H
+
+#include <vector>
+#include <stdint.h>
+
+#include "CGL/vector3D.h"
+#include "bbox.h"
+
+namespace CGL {
+namespace Misc {
+
+/**
+ * Bounding volume hierarchy over an indexed triangle mesh, for ray casts and
+ * closest point queries.
+ *
+ * Splits are chosen with the surface area heuristic over binned centroids.
+ * The tree is flattened depth first into 32 byte nodes, two per cache line:
+ * single precision bounds rounded outwards, the first child right after its
+ * parent and the second one (or the triangles of a leaf) found through an
+ * offset. Triangles are stored in leaf order, so a leaf is a contiguous run.
+ *
+ * refit() takes new vertex positions for the same triangles and updates the
+ * bounds bottom up; the splits may get worse as the vertices move, but the
+ * answers stay exact.
+ */
+class TriangleBVH {
+public:
+  static const size_t npos = (size_t)-1;
+
+  /**
+   * `indices` holds three vertex indices per triangle. Triangles are
+   * reported by their position in it.
+   */
+  void build(const std::vector<Vector3D> &positions, const std::vector<uint32_t> &indices);
+
+  /**
+   * Same triangles over the same vertices, which moved.
+   */
+  void refit(const std::vector<Vector3D> &positions);
+
+  /**
+   * First triangle hit by the ray (npos if none) and the distance t to it.
+   */
+  size_t intersect(const Ray &ray, double &t) const;
+
+  /**
+   * Triangle holding the surface point nearest to p (npos if there are no
+   * triangles), and that point.
+   */
+  size_t closest_point(const Vector3D &p, Vector3D &closest) const;
+
+  size_t size() const { return triangles.size(); }
+
+private:
+  struct Node {
+    float min[3];
+    uint32_t offset; ///< first triangle of a leaf, second child of an inner node
+    float max[3];
+    uint32_t count;  ///< triangles in a leaf, 0 for an inner node
+  };
+
+  struct Triangle {
+    uint32_t v[3];
+    uint32_t index; ///< position in the indices given to build()
+  };
+
+  /**
+   * What the build sorts: kept together and moved around whole, so each
+   * pass over a node's triangles reads memory in order.
+   */
+  struct BuildTriangle {
+    BBox bounds;
+    Vector3D centroid;
+    uint32_t index;
+  };
+
+  uint32_t build_node(std::vector<BuildTriangle> &build, uint32_t start, uint32_t end, int depth);
+  static void set_bounds(Node &node, const BBox &bounds);
+  static BBox node_bounds(const Node &node);
+  BBox triangle_bounds(const Triangle &tri) const;
+  bool hit_node(const Node &node, const Ray &ray, double max_t, double &t) const;
+  double node_distance2(const Node &node, const Vector3D &p) const;
+  bool hit_triangle(const Ray &ray, const Triangle &tri, double &t) const;
+  Vector3D closest_on_triangle(const Vector3D &p, const Triangle &tri) const;
+
+  std::vector<Node> nodes;
+  std::vector<Triangle> triangles; ///< grouped by leaf
+  std::vector<Vector3D> positions;
+};
+
+} // namespace Misc
+} // namespace CGL
+
+#endif // CGL_UTIL_TRIANGLEBVH_H
@@ -0,0 +1,158 @@
+#include "vertex_welder.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace CGL {
+namespace Misc {
+
+const size_t VertexWelder::npos;
+
+// Finalizer of MurmurHash3: every input bit affects every output bit.
+static inline uint64_t mix(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+static inline uint64_t hash_key(int64_t x, int64_t y, int64_t z) {
+  uint64_t h = mix((uint64_t)x);
+  h = mix(h ^ ((uint64_t)y + 0x9e3779b97f4a7c15ULL));
+  return mix(h ^ ((uint64_t)z + 0x6a09e667f3bcc909ULL));
+}
+
+// Bit pattern of d, with -0 folded into +0 so that equal values match.
+static inline int64_t bits_of(double d) {
+  if (d == 0.) {
+    d = 0.;
+  }
+  int64_t bits;
+  std::memcpy(&bits, &d, sizeof(bits));
+  return bits;
+}
+
+VertexWelder::VertexWelder(double epsilon) : eps(epsilon > 0. ? epsilon : 0.) {
+  slots.resize(16);
+  for (Slot &slot : slots) {
+    slot.id = npos;
+  }
+}
+
+void VertexWelder::clear() {
+  for (Slot &slot : slots) {
+    slot.id = npos;
+  }
+  used = 0;
+  positions.clear();
+}
+
+void VertexWelder::reserve(size_t n) {
+  positions.reserve(n);
+  while (slots.size() < 2 * n) {
+    grow();
+  }
+}
+
+VertexWelder::Key VertexWelder::key_of(const Vector3D &p) const {
+  Key key;
+  if (eps == 0.) {
+    key.x = bits_of(p.x);
+    key.y = bits_of(p.y);
+    key.z = bits_of(p.z);
+  } else {
+    key.x = (int64_t)std::floor(p.x / eps);
+    key.y = (int64_t)std::floor(p.y / eps);
+    key.z = (int64_t)std::floor(p.z / eps);
+  }
+  return key;
+}
+
+size_t VertexWelder::find_cell(const Key &key) const {
+  size_t mask = slots.size() - 1;
+  for (size_t i = hash_key(key.x, key.y, key.z) & mask;; i = (i + 1) & mask) {
+    const Slot &slot = slots[i];
+    if (slot.id == npos || slot.key == key) {
+      return slot.id;
+    }
+  }
+}
+
+void VertexWelder::insert_cell(const Key &key, size_t id) {
+  if (2 * (used + 1) > slots.size()) {
+    grow();
+  }
+  size_t mask = slots.size() - 1;
+  size_t i = hash_key(key.x, key.y, key.z) & mask;
+  while (slots[i].id != npos) {
+    i = (i + 1) & mask;
+  }
+  slots[i].key = key;
+  slots[i].id = id;
+  used++;
+}
+
+void VertexWelder::grow() {
+  std::vector<Slot> old;
+  old.swap(slots);
+  slots.resize(2 * old.size());
+  for (Slot &slot : slots) {
+    slot.id = npos;
+  }
+  size_t mask = slots.size() - 1;
+  for (const Slot &slot : old) {
+    if (slot.id == npos) {
+      continue;
+    }
+    size_t i = hash_key(slot.key.x, slot.key.y, slot.key.z) & mask;
+    while (slots[i].id != npos) {
+      i = (i + 1) & mask;
+    }
+    slots[i] = slot;
+  }
+}
+
+size_t VertexWelder::find(const Vector3D &p) const {
+  Key key = key_of(p);
+  if (eps == 0.) {
+    return find_cell(key);
+  }
+
+  // Positions within epsilon lie in this cell or one of its neighbours;
+  // the oldest one wins
+  size_t best = npos;
+  for (int dz = -1; dz <= 1; dz++) {
+    for (int dy = -1; dy <= 1; dy++) {
+      for (int dx = -1; dx <= 1; dx++) {
+        Key neighbour = {key.x + dx, key.y + dy, key.z + dz};
+        size_t id = find_cell(neighbour);
+        if (id == npos || (best != npos && id > best)) {
+          continue;
+        }
+        Vector3D d = positions[id] - p;
+        if (std::abs(d.x) <= eps && std::abs(d.y) <= eps && std::abs(d.z) <= eps) {
+          best = id;
+        }
+      }
+    }
+  }
+  return best;
+}
+
+size_t VertexWelder::insert(const Vector3D &p) {
+  size_t id = find(p);
+  if (id != npos) {
+    return id;
+  }
+
+  // No representative within epsilon, so none in p's own cell either
+  id = positions.size();
+  positions.push_back(p);
+  insert_cell(key_of(p), id);
+  return id;
+}
+
+} // namespace Misc
+} // namespace CGL
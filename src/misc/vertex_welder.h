@@ -0,0 +1,72 @@
+#ifndef CGL_UTIL_VERTEXWELDER_H
+#define CGL_UTIL_VERTEXWELDER_H
+
+#include <vector>
+#include <stdint.h>
+
+#include "CGL/vector3D.h"
+
+namespace CGL {
+namespace Misc {
+
+/**
+ * Assigns consecutive ids (0, 1, 2, ...) to distinct positions, welding
+ * positions that are within epsilon of each other on every axis.
+ *
+ * Positions are quantized to a grid of cell size epsilon and the cells are
+ * kept in an open-addressing hash table. Each cell remembers the first
+ * position that fell into it; a new position is welded to the first of the
+ * (up to 27) neighbouring representatives within epsilon, so welding only
+ * depends on the insertion order. With epsilon == 0 positions are welded
+ * only if they compare equal, like a map keyed by Vector3D.
+ */
+class VertexWelder {
+public:
+  static const size_t npos = (size_t)-1;
+
+  VertexWelder(double epsilon = 0.);
+
+  void clear();
+  void reserve(size_t n);
+
+  double epsilon() const { return eps; }
+  size_t size() const { return positions.size(); }
+  const std::vector<Vector3D> &points() const { return positions; } ///< representative of each id
+
+  /**
+   * Id of p, which becomes a new id if no position within epsilon was
+   * inserted before.
+   */
+  size_t insert(const Vector3D &p);
+
+  /**
+   * Id of p, or npos if no position within epsilon was inserted.
+   */
+  size_t find(const Vector3D &p) const;
+
+private:
+  struct Key {
+    int64_t x, y, z;
+    bool operator==(const Key &k) const { return x == k.x && y == k.y && z == k.z; }
+  };
+
+  struct Slot {
+    Key key;
+    size_t id;
+  };
+
+  Key key_of(const Vector3D &p) const;
+  size_t find_cell(const Key &key) const; // id stored for the cell, or npos
+  void insert_cell(const Key &key, size_t id);
+  void grow();
+
+  double eps;
+  std::vector<Slot> slots; // power-of-two capacity, id == npos marks empty
+  size_t used = 0;
+  std::vector<Vector3D> positions;
+};
+
+} // namespace Misc
+} // namespace CGL
+
+#endif // CGL_UTIL_VERTEXWELDER_H
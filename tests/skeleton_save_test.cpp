@@ -0,0 +1,114 @@
+// Saving a skeleton must leave the loaded one as it was: the mesh built
+// before the save is rebuilt, unchanged, by the next update_bmesh(), and the
+// saved file generates the same mesh again.
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "bmesh/bmesh.h"
+#include "logger.h"
+
+using namespace std;
+using namespace Balle;
+
+static vector<Vector3D> positions(const HalfedgeMesh* mesh)
+{
+	vector<Vector3D> result;
+	for (VertexCIter v = mesh->verticesBegin(); v != mesh->verticesEnd(); v++)
+	{
+		result.push_back(v->position);
+	}
+	return result;
+}
+
+// Regenerating re-evaluates the subdivision through its stencils, which only
+// rounds differently
+static bool same_positions(const vector<Vector3D>& a, const vector<Vector3D>& b)
+{
+	if (a.size() != b.size())
+	{
+		return false;
+	}
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		if ((a[i] - b[i]).norm() > 1e-6)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static int check(const string& input, const string& output, Logger* logger)
+{
+	BMesh bmesh(logger);
+	if (!bmesh.load_from_file(input))
+	{
+		printf("%s: could not load\n", input.c_str());
+		return 1;
+	}
+	bmesh.generate_bmesh();
+	if (bmesh.get_mesh() == nullptr)
+	{
+		printf("%s: did not stitch\n", input.c_str());
+		return 1;
+	}
+	vector<Vector3D> generated = positions(bmesh.get_mesh());
+	size_t nodes = bmesh.get_all_node().size();
+
+	bmesh.save_to_file(output);
+	int failures = 0;
+	if (bmesh.get_all_node().size() != nodes)
+	{
+		printf("%s: saving changed the skeleton\n", output.c_str());
+		failures++;
+	}
+
+	bmesh.interpolate_spheres();
+	bmesh.update_bmesh();
+	if (bmesh.get_mesh() == nullptr || !same_positions(positions(bmesh.get_mesh()), generated))
+	{
+		printf("%s: regenerating after the save changed the mesh\n", output.c_str());
+		failures++;
+	}
+
+	BMesh saved(logger);
+	if (!saved.load_from_file(output))
+	{
+		printf("%s: could not load the saved skeleton\n", output.c_str());
+		return failures + 1;
+	}
+	saved.generate_bmesh();
+	if (saved.get_mesh() == nullptr || !same_positions(positions(saved.get_mesh()), generated))
+	{
+		printf("%s: the saved skeleton generates another mesh\n", output.c_str());
+		failures++;
+	}
+	return failures;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		printf("Usage: %s <samples directory>\n", argv[0]);
+		return 1;
+	}
+
+	Logger logger;
+	logger.verbose = false;
+
+	int failures = 0;
+	for (const char* name : {"trex", "seastar", "stick_fig"})
+	{
+		string input = string(argv[1]) + "/" + name + ".balle";
+		for (const char* extension : {".balle", ".balleb"})
+		{
+			failures += check(input, string("saved_") + name + extension, &logger);
+		}
+	}
+
+	printf("%s\n", failures == 0 ? "skeleton_save: ok" : "skeleton_save: FAILED");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,56 @@
+#include "misc/thread_pool.h"
+
+#include <cstdio>
+#include <vector>
+#include <atomic>
+
+using namespace CGL::Misc;
+
+// Every index must be visited exactly once, whatever the thread count
+static bool covers(ThreadPool &pool, size_t count, size_t min_chunk) {
+  std::vector<std::atomic<int>> visits(count);
+  for (std::atomic<int> &v : visits) v = 0;
+  pool.parallel_for(0, count, [&](size_t chunk_begin, size_t chunk_end, size_t) {
+    for (size_t i = chunk_begin; i < chunk_end; i++) visits[i]++;
+  }, min_chunk);
+  for (std::atomic<int> &v : visits) {
+    if (v != 1) return false;
+  }
+  return true;
+}
+
+int main() {
+  int failures = 0;
+  ThreadPool pool(4);
+
+  // Workers restarted by set_num_threads() must neither run the previous job
+  // again nor miss the next one, even when it is queued before they get to
+  // run for the first time
+  for (int round = 0; round < 2000; round++) {
+    pool.set_num_threads(1 + round % 6);
+    if (!covers(pool, 4096, 16)) {
+      printf("round %d: wrong coverage with %zu threads\n", round, pool.num_threads());
+      failures++;
+    }
+    if (round % 3 == 0 && !covers(pool, 100, 1)) {
+      printf("round %d: wrong coverage of a short range\n", round);
+      failures++;
+    }
+  }
+
+  // Nested loops run inline on the workers
+  std::atomic<size_t> nested(0);
+  pool.set_num_threads(4);
+  pool.parallel_for(0, 64, [&](size_t chunk_begin, size_t chunk_end, size_t) {
+    for (size_t i = chunk_begin; i < chunk_end; i++) {
+      pool.parallel_for(0, 10, [&](size_t b, size_t e, size_t) { nested += e - b; }, 1);
+    }
+  }, 1);
+  if (nested != 640) {
+    printf("nested loops visited %zu of 640 indices\n", (size_t)nested);
+    failures++;
+  }
+
+  printf("%s\n", failures == 0 ? "thread_pool: ok" : "thread_pool: FAILED");
+  return failures == 0 ? 0 : 1;
+}
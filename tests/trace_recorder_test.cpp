@@ -0,0 +1,93 @@
+#include "misc/trace_recorder.h"
+#include "json.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <vector>
+#include <atomic>
+
+using namespace CGL::Misc;
+using json = nlohmann::json;
+
+static const char *names[] = {"sweep", "stitch", "subdivide"};
+
+static bool known_name(const std::string &name) {
+  for (const char *known : names) {
+    if (name == known) return true;
+  }
+  return false;
+}
+
+int main() {
+  int failures = 0;
+  TraceRecorder recorder(64);
+
+  // Flushing while the rings wrap around must only ever write whole events
+  std::atomic<bool> stop(false);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 3; t++) {
+    threads.push_back(std::thread([&recorder, &stop, t] {
+      for (size_t i = 0; !stop; i++) {
+        recorder.begin(names[(i + t) % 3]);
+        recorder.end(names[(i + t) % 3]);
+      }
+    }));
+  }
+  for (int flush = 0; flush < 200; flush++) {
+    if (!recorder.write_json("trace_recorder_test.json")) {
+      printf("could not write the trace\n");
+      failures++;
+      break;
+    }
+    std::ifstream file("trace_recorder_test.json");
+    json trace;
+    file >> trace;
+    for (const json &event : trace["traceEvents"]) {
+      std::string phase = event["ph"];
+      if (!known_name(event["name"]) || (phase != "B" && phase != "E")) {
+        printf("flush %d: torn event %s\n", flush, event.dump().c_str());
+        failures++;
+        break;
+      }
+    }
+  }
+  stop = true;
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  // Threads that come and go one after another record into the same ring
+  TraceRecorder sequential(64);
+  for (int t = 0; t < 8; t++) {
+    std::thread thread([&sequential] {
+      sequential.begin(names[0]);
+      sequential.end(names[0]);
+    });
+    thread.join();
+  }
+  if (!sequential.write_json("trace_recorder_test.json")) {
+    printf("could not write the trace\n");
+    failures++;
+  } else {
+    std::ifstream file("trace_recorder_test.json");
+    json trace;
+    file >> trace;
+    size_t events = trace["traceEvents"].size();
+    for (const json &event : trace["traceEvents"]) {
+      if (event["tid"] != 1) {
+        printf("sequential threads got their own rings: %s\n", event.dump().c_str());
+        failures++;
+        break;
+      }
+    }
+    if (events != 16) {
+      printf("sequential threads recorded %zu events, expected 16\n", events);
+      failures++;
+    }
+  }
+
+  printf("%s\n", failures == 0 ? "trace_recorder: ok" : "trace_recorder: FAILED");
+  return failures == 0 ? 0 : 1;
+}